@@ -388,6 +388,21 @@ SENTRY_API char *sentry_envelope_serialize(const sentry_envelope_t *envelope,
 SENTRY_API int sentry_envelope_write_to_file(const sentry_envelope_t *envelope,
                                              const char *path);
 
+/*
+ * parses a serialized envelope.
+ *
+ * The contents of the buffer are copied, so it can be freed right after this
+ * returns.  Returns NULL if the envelope is malformed.  The envelope must be
+ * freed with `sentry_envelope_free`.
+ */
+SENTRY_EXPERIMENTAL_API sentry_envelope_t *sentry_envelope_deserialize(
+    const char *buf, size_t len);
+
+/*
+ * frees an envelope returned by `sentry_envelope_deserialize`.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_envelope_free(sentry_envelope_t *envelope);
+
 /* type of the callback for transports */
 typedef void (*sentry_transport_function_t)(const sentry_envelope_t *envelope,
                                             void *data);
@@ -397,6 +412,25 @@ typedef sentry_value_t (*sentry_event_function_t)(sentry_value_t event,
                                                   void *hint,
                                                   void *closure);
 
+/* type of the callback for modifying breadcrumbs */
+typedef sentry_value_t (*sentry_breadcrumb_function_t)(
+    sentry_value_t breadcrumb, void *hint, void *closure);
+
+/*
+ * the points of capturing an event at which event processors run.
+ */
+typedef enum sentry_event_phase_e {
+    /* before the scope is applied, on the capturing thread.  Dropping events
+       here skips all of the expensive work. */
+    SENTRY_EVENT_PHASE_PRE_ENRICHMENT = 0,
+    /* after the scope, the module list and symbolicated stacktraces were
+       added, right before the before send callback. */
+    SENTRY_EVENT_PHASE_POST_ENRICHMENT = 1,
+    /* after the before send callback, right before the event is
+       serialized. */
+    SENTRY_EVENT_PHASE_PRE_SERIALIZATION = 2,
+} sentry_event_phase_t;
+
 /*
  * creates a new options struct.  Can be freed with `sentry_options_free`
  */
@@ -409,6 +443,56 @@ SENTRY_API void sentry_options_set_transport(sentry_options_t *opts,
                                              sentry_transport_function_t func,
                                              void *data);
 
+/*
+ * sends envelopes to a local relay listening on a unix domain socket.
+ *
+ * Envelopes are written in their serialized form, each prefixed with its
+ * length as a 32 bit big endian integer.  While the relay is unreachable
+ * envelopes are spilled to the database path and sent once it is back.
+ * This replaces the default HTTP transport.  Not available on Windows.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_relay_socket(
+    sentry_options_t *opts, const char *path);
+
+/*
+ * writes envelopes into the shared memory ring `name` instead of sending
+ * them.
+ *
+ * This is meant for hosts with many processes: every process pushes its
+ * envelopes into the same ring without blocking and a single uploader
+ * process sends them with `sentry_drain_shared_ring`.  If the ring is full
+ * envelopes are dropped.  `capacity` is the size of the ring in bytes if it
+ * does not exist yet, 0 picks a default of 4MB.  Not available on Windows
+ * and Android.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_shared_ring(
+    sentry_options_t *opts, const char *name, size_t capacity);
+
+/*
+ * controls when the file sink waits for written envelopes to reach the disk.
+ */
+typedef enum {
+    SENTRY_FILE_SINK_SYNC_NONE,
+    SENTRY_FILE_SINK_SYNC_BATCH,
+    SENTRY_FILE_SINK_SYNC_ENVELOPE,
+} sentry_file_sink_sync_t;
+
+/*
+ * writes envelopes to rotating files in `directory` instead of sending them.
+ *
+ * Files are rotated once they reach `max_file_size` bytes or are older than
+ * `max_file_age_ms` milliseconds, 0 picks defaults of 64MB and one hour.
+ * Files that are still being written end in `.part`.  Next to every
+ * `.envelopes` file an `.index` file lists the offset, length and event id
+ * of each envelope, one per line.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_file_sink(
+    sentry_options_t *opts,
+    const char *directory,
+    size_t max_file_size,
+    uint64_t max_file_age_ms,
+    sentry_file_sink_sync_t sync);
+
 /*
  * sets the before send callback
  */
@@ -416,6 +500,27 @@ SENTRY_API void sentry_options_set_before_send(sentry_options_t *opts,
                                                sentry_event_function_t func,
                                                void *closure);
 
+/*
+ * adds an event processor that runs at `phase`.
+ *
+ * Processors of a phase run in the order they were added.  Each one gets
+ * the event and returns it, modified or not, or returns a null value to
+ * drop it, in which case the later ones do not run.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_add_event_processor(
+    sentry_options_t *opts,
+    sentry_event_phase_t phase,
+    sentry_event_function_t func,
+    void *closure);
+
+/*
+ * sets a callback that runs for every added breadcrumb.
+ *
+ * It returns the breadcrumb, modified or not, or a null value to drop it.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_before_breadcrumb(
+    sentry_options_t *opts, sentry_breadcrumb_function_t func, void *closure);
+
 /*
  * deallocates previously allocated sentry options
  */
@@ -497,6 +602,118 @@ SENTRY_API void sentry_options_set_debug(sentry_options_t *opts, int debug);
  */
 SENTRY_API int sentry_options_get_debug(const sentry_options_t *opts);
 
+/*
+ * enables or disables background capturing.
+ *
+ * When enabled `sentry_capture_event` only takes a snapshot of the scope on
+ * the calling thread.  Applying the scope, symbolication, serialization and
+ * handing the event to the transport happen on background threads.  Events
+ * are dropped rather than blocking the caller if the pipeline falls behind.
+ * Fatal events are still sent on the calling thread, as the process is
+ * unlikely to live long enough for the pipeline to get to them.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_background_capture(
+    sentry_options_t *opts, int enabled);
+
+/*
+ * returns the current value of the background capture flag.
+ */
+SENTRY_EXPERIMENTAL_API int sentry_options_get_background_capture(
+    const sentry_options_t *opts);
+
+/*
+ * sets the rate at which events are sent, between 0.0 and 1.0.
+ *
+ * Events that are sampled out are discarded by `sentry_capture_event` before
+ * the scope is applied or anything is serialized.  Fatal events are never
+ * sampled.  Defaults to 1.0 which sends all events.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_sample_rate(
+    sentry_options_t *opts, double sample_rate);
+
+/*
+ * returns the configured sample rate.
+ */
+SENTRY_EXPERIMENTAL_API double sentry_options_get_sample_rate(
+    const sentry_options_t *opts);
+
+/*
+ * suppresses repeated events within a window of `window_ms` milliseconds.
+ *
+ * Events are considered equal if they share exception types, fingerprint,
+ * message and stack trace addresses.  The first event is sent right away,
+ * repeats within the window are only counted.  Once the window has passed
+ * the count is sent as one aggregated event with an `extra.duplicate_count`
+ * entry and the scope of the first event.  Aggregates are sent at most one
+ * window late and on shutdown.  A value of 0 (the default) disables
+ * suppression.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_dedup_window(
+    sentry_options_t *opts, uint64_t window_ms);
+
+/*
+ * returns the duplicate suppression window in milliseconds.
+ */
+SENTRY_EXPERIMENTAL_API uint64_t
+sentry_options_get_dedup_window(const sentry_options_t *opts);
+
+/*
+ * lets the default transport collect envelopes before sending them.
+ *
+ * New envelopes wait up to `linger_ms` milliseconds for more to arrive, or
+ * until `max_bytes` are pending (0 picks a default of 1MB).  The batch is
+ * then sent over a single kept alive connection, multiplexed if the server
+ * speaks HTTP/2.  Fatal events and shutdown send the batch right away.  A
+ * `linger_ms` of 0 (the default) sends every envelope on its own.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_batching(
+    sentry_options_t *opts, uint64_t linger_ms, size_t max_bytes);
+
+/*
+ * sets how often the crashpad backend writes scope changes to disk.
+ *
+ * Changes within `interval_ms` milliseconds (100 by default) are written
+ * together.  Capturing a fatal event and shutting down write right away, as
+ * does a crash.  Crashpad only offers the hook for the latter on Linux, so
+ * everywhere else every change is written right away and the interval is
+ * ignored.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_scope_flush_interval(
+    sentry_options_t *opts, uint64_t interval_ms);
+
+/*
+ * limits the memory that breadcrumbs take up.
+ *
+ * Both limits count the bytes of the compact records that breadcrumbs are
+ * kept in, not of their JSON.  Every thread keeps its breadcrumbs in
+ * `max_bytes` bytes of records (32 KiB by default), and events get no more
+ * than that many bytes worth of breadcrumbs, including those of pushed
+ * scopes.  A single breadcrumb is cut down to a record of
+ * `max_breadcrumb_size` bytes (8 KiB by default and at most a quarter of
+ * `max_bytes`) by dropping its data and then truncating its message.
+ * Passing 0 keeps the default.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_breadcrumb_budget(
+    sentry_options_t *opts, size_t max_bytes, size_t max_breadcrumb_size);
+
+/*
+ * type of the callback for periodic SDK statistics.
+ *
+ * The stats value is released after the callback returns.
+ */
+typedef void (*sentry_stats_function_t)(sentry_value_t stats, void *data);
+
+/*
+ * reports the SDK statistics returned by `sentry_get_stats` every
+ * `interval_ms` milliseconds to `func`.  The callback runs on a background
+ * thread.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_stats_callback(
+    sentry_options_t *opts,
+    sentry_stats_function_t func,
+    uint64_t interval_ms,
+    void *data);
+
 /*
  * adds a new attachment to be sent along
  */
@@ -504,6 +721,22 @@ SENTRY_API void sentry_options_add_attachment(sentry_options_t *opts,
                                               const char *name,
                                               const char *path);
 
+/*
+ * limits the number of bytes sent per attachment.
+ *
+ * Attachments larger than this are truncated at the front so that only the
+ * last `max_size` bytes of the file are sent.  A value of 0 (the default)
+ * sends attachments in full.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_options_set_max_attachment_size(
+    sentry_options_t *opts, size_t max_size);
+
+/*
+ * returns the maximum attachment size.
+ */
+SENTRY_EXPERIMENTAL_API size_t
+sentry_options_get_max_attachment_size(const sentry_options_t *opts);
+
 /*
  * sets the path to the crashpad handler if the crashpad backend is used
  */
@@ -551,14 +784,68 @@ SENTRY_API const sentry_options_t *sentry_get_options(void);
 
 /*
  * Sends a sentry event.
+ *
+ * Returns the nil uuid if the event was discarded by sampling.
  */
 SENTRY_API sentry_uuid_t sentry_capture_event(sentry_value_t event);
 
+/*
+ * decides whether an event of the given level would be sent.
+ *
+ * This is cheap and can be used to skip building events that sampling would
+ * discard anyway.  A positive answer is remembered on the calling thread so
+ * that the next `sentry_capture_event` on the same thread does not sample a
+ * second time, if that event has the same level.  Events without a level
+ * count as errors.  Any other event samples as usual.
+ */
+SENTRY_EXPERIMENTAL_API int sentry_should_capture(sentry_level_t level);
+
+/*
+ * returns the number of events that were discarded by sampling.
+ */
+SENTRY_EXPERIMENTAL_API uint64_t sentry_get_sampled_out_count(void);
+
+/*
+ * sends all envelopes waiting in the shared memory ring `name` with the
+ * configured transport and returns how many were sent.
+ *
+ * This is called periodically by the uploader process of a host that uses
+ * `sentry_options_set_shared_ring` in its other processes.  Only one process
+ * may drain a ring at a time.
+ */
+SENTRY_EXPERIMENTAL_API size_t sentry_drain_shared_ring(const char *name);
+
+/*
+ * returns statistics about the SDK itself.
+ *
+ * The returned object contains `counters` for captured, sampled, dropped and
+ * sent events, bytes and HTTP status classes, and `timers` with latency
+ * histograms of capturing, applying the scope, serializing and sending.
+ * Depending on the configuration `pipeline` and `transport` hold queue
+ * depths, and `pipeline` has the processed and dropped events and the
+ * queue and run times of every stage.  Counters are kept since the start
+ * of the process.
+ */
+SENTRY_EXPERIMENTAL_API sentry_value_t sentry_get_stats(void);
+
 /*
  * Adds the breadcrumb to be sent in case of an event.
  */
 SENTRY_API void sentry_add_breadcrumb(sentry_value_t breadcrumb);
 
+/*
+ * Adds a breadcrumb without creating a value for it first.
+ *
+ * The breadcrumb is kept in a compact form until an event is captured, so
+ * this is cheap enough to use breadcrumbs like a trace log.  `type`,
+ * `category` and `message` may be NULL.  Use few distinct types and
+ * categories: they are interned and never freed.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_record_breadcrumb(const char *type,
+                                                      const char *category,
+                                                      sentry_level_t level,
+                                                      const char *message);
+
 /*
  * Sets the specified user.
  */
@@ -574,6 +861,16 @@ SENTRY_API void sentry_remove_user(void);
  */
 SENTRY_API void sentry_set_tag(const char *key, const char *value);
 
+/*
+ * Sets `count` tags at once.
+ *
+ * This is the same as calling `sentry_set_tag` for every pair of `keys` and
+ * `values` but changes the scope only once.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_set_tags(const char *const *keys,
+                                             const char *const *values,
+                                             size_t count);
+
 /*
  * Removes the tag with the specified key.
  */
@@ -624,6 +921,29 @@ SENTRY_API void sentry_remove_transaction(void);
  */
 SENTRY_API void sentry_set_level(sentry_level_t level);
 
+/*
+ * Pushes a new scope for the calling thread.
+ *
+ * Until it is popped again, everything set on the scope from this thread
+ * only goes to the new scope.  It is not visible to other threads, does not
+ * take any lock and is applied on top of the global scope and the scopes
+ * pushed before when an event is captured on this thread.  Removing a value
+ * only removes what the pushed scope set itself.  The scopes of a thread are
+ * not written to the crash reports of the crashpad and breakpad backends.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_push_scope(void);
+
+/*
+ * Pops the scope pushed last on the calling thread.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_pop_scope(void);
+
+/*
+ * Runs `func` with a new scope pushed for its duration.
+ */
+SENTRY_EXPERIMENTAL_API void sentry_with_scope(void (*func)(void *data),
+                                               void *data);
+
 #ifdef __cplusplus
 }
 #endif
@@ -66,6 +66,7 @@ function sentry_native_library()
       "uuid",
       "curl",
       "dl",
+      "rt",
     }
     defines {
       "SENTRY_WITH_LIBCURL_TRANSPORT",
@@ -228,6 +229,9 @@ project "test_sentry"
   files {
     SRC_ROOT.."/tests/**.cpp",
   }
+  removefiles {
+    SRC_ROOT.."/tests/bench/**.cpp",
+  }
 
   -- make sure we have a build-id
   filter "system:linux"
@@ -235,3 +239,25 @@ project "test_sentry"
     linkoptions { "-Wl,--build-id=uuid,-E" }
 
   filter {}
+
+project "bench_transport"
+  kind "ConsoleApp"
+  sentry_native_common()
+  sentry_native_library()
+
+  includedirs {
+    SRC_ROOT.."/src",
+  }
+
+  files {
+    SRC_ROOT.."/tests/bench/bench_transport.cpp",
+    SRC_ROOT.."/tests/relayreceiver.cpp",
+    SRC_ROOT.."/tests/testserver.cpp",
+  }
+
+  filter "system:linux"
+    linkoptions { "-Wl,--build-id=uuid,-E" }
+
+  filter {}
+
+  disable_for_android()
@@ -1,27 +1,82 @@
 #include <assert.h>
 #include <stdarg.h>
+#include <string.h>
 #include <fstream>
 #include <mutex>
 
 #include "attachment.hpp"
+#include "breadcrumbs.hpp"
 #include "cleanup.hpp"
+#include "dedup.hpp"
 #include "internal.hpp"
 #include "modulefinder.hpp"
 #include "options.hpp"
+#include "pipeline.hpp"
+#include "processors.hpp"
+#include "sampling.hpp"
+#include "shmring.hpp"
 #include "scope.hpp"
+#include "stats.hpp"
 #include "transports/base_transport.hpp"
 #include "unwind.hpp"
 #include "uuid.hpp"
 #include "value.hpp"
+#include "worker.hpp"
 
 using namespace sentry;
 
 static sentry_options_t *g_options;
+static CapturePipeline *g_pipeline;
+static Deduplicator *g_dedup;
+// runs the periodic stats reports and flushes of duplicate aggregates.
+static BackgroundWorker *g_timer_worker;
+#if !defined(_WIN32) && !defined(__ANDROID__)
+// the ring drained by `sentry_drain_shared_ring`.  It stays open between
+// calls so that stalled records can be detected.
+static SharedRing *g_drain_ring;
+static std::string g_drain_ring_name;
+#endif
+
+// the level that `sentry_should_capture` last said yes to on this thread.
+// The next capture on the thread consumes it, but only skips sampling if
+// its event has that level.
+static thread_local sentry_level_t t_presampled_level = SCOPE_LEVEL_UNSET;
 
 static bool sdk_disabled() {
     return !g_options || g_options->dsn.disabled();
 }
 
+static void report_stats() {
+    if (!g_options || !g_options->stats_callback) {
+        return;
+    }
+    sentry_value_t stats = sentry_get_stats();
+    g_options->stats_callback(stats, g_options->stats_callback_data);
+    sentry_value_decref(stats);
+}
+
+static void schedule_stats_report() {
+    g_timer_worker->submit_delayed_task(
+        []() {
+            report_stats();
+            schedule_stats_report();
+        },
+        std::chrono::milliseconds(g_options->stats_interval));
+}
+
+static void flush_duplicates(bool all);
+
+// aggregates are due once their window has passed, so they are looked for
+// once per window instead of waiting for the next capture.
+static void schedule_duplicates_flush() {
+    g_timer_worker->submit_delayed_task(
+        []() {
+            flush_duplicates(false);
+            schedule_duplicates_flush();
+        },
+        std::chrono::milliseconds(g_options->dedup_window));
+}
+
 int sentry_init(sentry_options_t *options) {
     assert(!g_options);
     g_options = options;
@@ -42,14 +97,60 @@ int sentry_init(sentry_options_t *options) {
         g_options->transport->start();
     }
 
+    if (g_options->background_capture) {
+        g_pipeline = new CapturePipeline(SENTRY_PIPELINE_QUEUE_MAX);
+        g_pipeline->start();
+    }
+
+    bool wants_stats =
+        g_options->stats_callback && g_options->stats_interval > 0;
+    if (wants_stats || g_options->dedup_window > 0) {
+        g_timer_worker = new BackgroundWorker();
+        g_timer_worker->start();
+    }
+    if (wants_stats) {
+        schedule_stats_report();
+    }
+
+    if (g_options->dedup_window > 0) {
+        g_dedup = new Deduplicator(
+            SENTRY_DEDUP_ENTRIES_MAX,
+            std::chrono::milliseconds(g_options->dedup_window));
+        schedule_duplicates_flush();
+    }
+
     return 0;
 }
 
 void sentry_shutdown(void) {
     if (g_options) {
+        // the timer tasks refer to the deduplicator, so they have to be
+        // done before it goes away.
+        if (g_timer_worker) {
+            g_timer_worker->shutdown(true);
+            delete g_timer_worker;
+            g_timer_worker = nullptr;
+        }
+        if (g_dedup) {
+            flush_duplicates(true);
+            delete g_dedup;
+            g_dedup = nullptr;
+        }
+#if !defined(_WIN32) && !defined(__ANDROID__)
+        delete g_drain_ring;
+        g_drain_ring = nullptr;
+#endif
+        if (g_pipeline) {
+            g_pipeline->shutdown();
+            delete g_pipeline;
+            g_pipeline = nullptr;
+        }
         if (g_options->transport) {
             g_options->transport->shutdown();
         }
+        if (g_options->backend && !g_options->dsn.disabled()) {
+            g_options->backend->shutdown();
+        }
         sentry_options_free(g_options);
     }
     g_options = nullptr;
@@ -59,8 +160,114 @@ const sentry_options_t *sentry_get_options(void) {
     return g_options;
 }
 
-sentry_uuid_t sentry_capture_event(sentry_value_t evt) {
-    Value event = Value::consume(evt);
+static bool sample_event(const Value &event) {
+    sentry_level_t presampled = t_presampled_level;
+    t_presampled_level = SCOPE_LEVEL_UNSET;
+
+    // events without a level get the one of the scope, which is error
+    // unless it was changed.
+    Value level_value = event.get_by_key("level");
+    const char *level = level_value.type() == SENTRY_VALUE_TYPE_STRING
+                            ? level_value.as_cstr()
+                            : Value::level_name(SENTRY_LEVEL_ERROR);
+    if (presampled != SCOPE_LEVEL_UNSET &&
+        strcmp(level, Value::level_name(presampled)) == 0) {
+        return true;
+    }
+
+    double sample_rate = g_options ? g_options->sample_rate : 1.0;
+    if (sample_rate >= 1.0 ||
+        strcmp(level, Value::level_name(SENTRY_LEVEL_FATAL)) == 0) {
+        return true;
+    }
+    if (sample(sample_rate)) {
+        return true;
+    }
+    stat_add(STAT_EVENTS_SAMPLED_OUT);
+    return false;
+}
+
+int sentry_should_capture(sentry_level_t level) {
+    if (sdk_disabled()) {
+        return 0;
+    }
+    if (level == SENTRY_LEVEL_FATAL || sample(g_options->sample_rate)) {
+        t_presampled_level = level;
+        return 1;
+    }
+    t_presampled_level = SCOPE_LEVEL_UNSET;
+    stat_add(STAT_EVENTS_SAMPLED_OUT);
+    return 0;
+}
+
+size_t sentry_drain_shared_ring(const char *name) {
+#if defined(_WIN32) || defined(__ANDROID__)
+    return 0;
+#else
+    if (!name || !g_options || !g_options->transport) {
+        return 0;
+    }
+    if (!g_drain_ring || g_drain_ring_name != name) {
+        delete g_drain_ring;
+        g_drain_ring = new SharedRing();
+        g_drain_ring_name = name;
+        if (!g_drain_ring->open(name)) {
+            delete g_drain_ring;
+            g_drain_ring = nullptr;
+            return 0;
+        }
+    }
+
+    size_t sent = 0;
+    std::string buf;
+    while (g_drain_ring->pop(&buf)) {
+        transports::EnvelopeReader reader(buf.data(), buf.size());
+        transports::Envelope envelope;
+        if (!transports::Envelope::deserialize(reader, &envelope)) {
+            SENTRY_LOG("dropping malformed envelope from shared memory ring");
+            continue;
+        }
+        g_options->transport->send_envelope(envelope);
+        sent++;
+    }
+    return sent;
+#endif
+}
+
+sentry_value_t sentry_get_stats(void) {
+    Value stats = collect_stats();
+    if (g_pipeline) {
+        Value pipeline = Value::new_object();
+        g_pipeline->report_stats(pipeline);
+        stats.set_by_key("pipeline", pipeline);
+    }
+    if (g_options && g_options->transport) {
+        Value transport = Value::new_object();
+        g_options->transport->report_stats(transport);
+        stats.set_by_key("transport", transport);
+    }
+    return stats.lower();
+}
+
+uint64_t sentry_get_sampled_out_count(void) {
+    return stat_total(STAT_EVENTS_SAMPLED_OUT);
+}
+
+// the scope is immutable, so it can be applied without holding on to any
+// lock.  Only the breadcrumbs of all threads are cut off now, so that later
+// ones do not end up in the event.  With the pipeline running they are
+// collected by its first stage instead of the calling thread.
+static Scope capture_scope(const Scope &current) {
+    Scope scope = current;
+    scope.breadcrumbs_cutoff = breadcrumbs_cutoff();
+    if (!g_pipeline) {
+        collect_scope_breadcrumbs(scope);
+    }
+    return scope;
+}
+
+static sentry_uuid_t capture_event(Value event, const Scope &scope) {
+    stat_add(STAT_EVENTS_CAPTURED);
     sentry_uuid_t uuid;
     Value event_id = event.get_by_key("event_id");
 
@@ -73,40 +280,136 @@ sentry_uuid_t sentry_capture_event(sentry_value_t evt) {
         uuid = sentry_uuid_from_string(event_id.as_cstr());
     }
 
-    Scope::with_scope(
-        [&event](const Scope &scope) { scope.apply_to_event(event); });
-
+    // a fatal event is usually followed by the process going down, so the
+    // backend must not hold on to scope changes it has not written yet, and
+    // the event is sent right away instead of going through the pipeline.
     const sentry_options_t *opts = sentry_get_options();
+    bool fatal = task_priority_for_event(event) == TASK_PRIORITY_FATAL;
+    if (opts->backend && fatal) {
+        opts->backend->flush_pending();
+    }
+
+    if (g_pipeline && !fatal) {
+        g_pipeline->submit(event, scope);
+        return uuid;
+    }
+
+    Scope collected = scope;
+    collect_scope_breadcrumbs(collected);
+    collected.apply_to_event(event);
+
+    if (!run_event_processors(SENTRY_EVENT_PHASE_POST_ENRICHMENT, event)) {
+        return uuid;
+    }
     if (opts->before_send) {
         event = opts->before_send(event, nullptr);
     }
 
-    if (opts->transport && !event.is_null()) {
+    if (opts->transport && !event.is_null() &&
+        run_event_processors(SENTRY_EVENT_PHASE_PRE_SERIALIZATION, event)) {
         opts->transport->send_event(event);
     }
 
     return uuid;
 }
 
+// aggregates are captured with the scope of the event they stand for.  Only
+// if that event raced with the flush is the current scope used instead.
+static void flush_duplicates(bool all) {
+    std::vector<Deduplicator::Aggregate> aggregates =
+        g_dedup->take_aggregates(all);
+    for (size_t i = 0; i < aggregates.size(); i++) {
+        const Deduplicator::Aggregate &aggregate = aggregates[i];
+        capture_event(aggregate.event,
+                      aggregate.scope ? *aggregate.scope
+                                      : capture_scope(*Scope::current()));
+    }
+}
+
+static sentry_uuid_t capture_unless_duplicate(Value event) {
+    std::shared_ptr<const Scope> current = Scope::current();
+    Value fingerprint;
+    if (event.get_by_key("fingerprint").is_null()) {
+        fingerprint = current->fingerprint;
+    }
+    uint64_t signature;
+    if (!g_dedup->check(event, fingerprint, &signature)) {
+        stat_add(STAT_EVENTS_DUPLICATE);
+        return sentry_uuid_nil();
+    }
+
+    // breadcrumbs are only collected for events that are let through
+    std::shared_ptr<const Scope> scope =
+        std::make_shared<const Scope>(capture_scope(*current));
+    g_dedup->attach_scope(signature, scope);
+    return capture_event(event, *scope);
+}
+
+sentry_uuid_t sentry_capture_event(sentry_value_t evt) {
+    ScopedStatTimer timer(STAT_TIMER_CAPTURE);
+    Value event = Value::consume(evt);
+    if (!sample_event(event) ||
+        !run_event_processors(SENTRY_EVENT_PHASE_PRE_ENRICHMENT, event)) {
+        return sentry_uuid_nil();
+    }
+    if (!g_dedup) {
+        return capture_event(event, capture_scope(*Scope::current()));
+    }
+
+    sentry_uuid_t uuid = capture_unless_duplicate(event);
+    flush_duplicates(false);
+    return uuid;
+}
+
 void sentry_add_breadcrumb(sentry_value_t breadcrumb) {
     Value breadcrumb_value = Value::consume(breadcrumb);
-    if (sdk_disabled()) {
+    if (sdk_disabled() || !run_before_breadcrumb(breadcrumb_value)) {
         return;
     }
 
-    Scope::with_scope_mut([breadcrumb_value](Scope &scope) {
-        scope.breadcrumbs.append_bounded(breadcrumb_value,
-                                         SENTRY_BREADCRUMBS_MAX);
-    });
+    // breadcrumbs of pushed scopes go away with the scope, all others are
+    // recorded without touching the global scope.
+    if (Scope::has_layers()) {
+        Value record = layer_breadcrumb(breadcrumb_value);
+        Scope::with_scope_mut([&record](Scope &scope) {
+            scope.breadcrumbs.append_bounded(record, SENTRY_BREADCRUMBS_MAX);
+        });
+    } else {
+        record_breadcrumb(breadcrumb_value);
+    }
 
     if (g_options->backend) {
         g_options->backend->add_breadcrumb(breadcrumb_value);
     }
 }
 
+void sentry_record_breadcrumb(const char *type,
+                              const char *category,
+                              sentry_level_t level,
+                              const char *message) {
+    if (sdk_disabled()) {
+        return;
+    }
+
+    bool needs_value = Scope::has_layers() || g_options->before_breadcrumb ||
+                       (g_options->backend &&
+                        g_options->backend->wants_breadcrumbs());
+    if (!needs_value) {
+        record_breadcrumb(type, category, level, message);
+        return;
+    }
+
+    Value breadcrumb = Value::new_breadcrumb(type, message);
+    if (category) {
+        breadcrumb.set_by_key("category", Value::new_string(category));
+    }
+    breadcrumb.set_by_key("level", Value::new_level(level));
+    sentry_add_breadcrumb(breadcrumb.lower());
+}
+
 void sentry_set_user(sentry_value_t value) {
     Scope::with_scope_mut(
-        [value](Scope &scope) { scope.user = Value::consume(value); });
+        [&value](Scope &scope) { scope.user = Value::consume(value); });
 }
 
 void sentry_remove_user() {
@@ -114,36 +417,46 @@ void sentry_remove_user() {
 }
 
 void sentry_set_tag(const char *key, const char *value) {
-    Scope::with_scope_mut([key, value](Scope &scope) {
+    Scope::with_scope_mut([&key, &value](Scope &scope) {
         scope.tags.set_by_key(key, Value::new_string(value));
     });
 }
 
+void sentry_set_tags(const char *const *keys,
+                     const char *const *values,
+                     size_t count) {
+    Scope::with_scope_mut([&keys, &values, &count](Scope &scope) {
+        for (size_t i = 0; i < count; i++) {
+            scope.tags.set_by_key(keys[i], Value::new_string(values[i]));
+        }
+    });
+}
+
 void sentry_remove_tag(const char *key) {
     Scope::with_scope_mut(
-        [key](Scope &scope) { scope.tags.remove_by_key(key); });
+        [&key](Scope &scope) { scope.tags.remove_by_key(key); });
 }
 
 void sentry_set_extra(const char *key, sentry_value_t value) {
-    Scope::with_scope_mut([key, value](Scope &scope) {
+    Scope::with_scope_mut([&key, &value](Scope &scope) {
         scope.extra.set_by_key(key, Value::consume(value));
     });
 }
 
 void sentry_remove_extra(const char *key) {
     Scope::with_scope_mut(
-        [key](Scope &scope) { scope.extra.remove_by_key(key); });
+        [&key](Scope &scope) { scope.extra.remove_by_key(key); });
 }
 
 void sentry_set_context(const char *key, sentry_value_t value) {
-    Scope::with_scope_mut([key, value](Scope &scope) {
+    Scope::with_scope_mut([&key, &value](Scope &scope) {
         scope.contexts.set_by_key(key, Value::consume(value));
     });
 }
 
 void sentry_remove_context(const char *key) {
     Scope::with_scope_mut(
-        [key](Scope &scope) { scope.contexts.remove_by_key(key); });
+        [&key](Scope &scope) { scope.contexts.remove_by_key(key); });
 }
 
 void sentry_set_fingerprint(const char *fingerprint, ...) {
@@ -156,7 +469,7 @@ void sentry_set_fingerprint(const char *fingerprint, ...) {
     }
     va_end(va);
 
-    Scope::with_scope_mut([fingerprint_value](Scope &scope) {
+    Scope::with_scope_mut([&fingerprint_value](Scope &scope) {
         scope.fingerprint = fingerprint_value;
     });
 }
@@ -167,7 +480,7 @@ void sentry_remove_fingerprint(void) {
 
 void sentry_set_transaction(const char *transaction) {
     Scope::with_scope_mut(
-        [transaction](Scope &scope) { scope.transaction = transaction; });
+        [&transaction](Scope &scope) { scope.transaction = transaction; });
 }
 
 void sentry_remove_transaction() {
@@ -175,7 +488,23 @@ void sentry_remove_transaction() {
 }
 
 void sentry_set_level(sentry_level_t level) {
-    Scope::with_scope_mut([level](Scope &scope) { scope.level = level; });
+    Scope::with_scope_mut([&level](Scope &scope) { scope.level = level; });
+}
+
+void sentry_push_scope(void) {
+    Scope::push_layer();
+}
+
+void sentry_pop_scope(void) {
+    if (!Scope::pop_layer()) {
+        SENTRY_LOG("sentry_pop_scope called without a pushed scope");
+    }
+}
+
+void sentry_with_scope(void (*func)(void *data), void *data) {
+    Scope::push_layer();
+    func(data);
+    Scope::pop_layer();
 }
 
 void sentry_string_free(char *str) {
@@ -203,6 +532,20 @@ char *sentry_envelope_serialize(const sentry_envelope_t *envelope,
     return e->serialize(size_out);
 }
 
+sentry_envelope_t *sentry_envelope_deserialize(const char *buf, size_t len) {
+    transports::EnvelopeReader reader(buf, len);
+    transports::Envelope *e = new transports::Envelope();
+    if (!transports::Envelope::deserialize(reader, e)) {
+        delete e;
+        return nullptr;
+    }
+    return (sentry_envelope_t *)e;
+}
+
+void sentry_envelope_free(sentry_envelope_t *envelope) {
+    delete (transports::Envelope *)envelope;
+}
+
 int sentry_envelope_write_to_file(const sentry_envelope_t *envelope,
                                   const char *path) {
     const transports::Envelope *e = (const transports::Envelope *)envelope;
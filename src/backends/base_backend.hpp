@@ -19,8 +19,17 @@ class Backend {
     }
     virtual void flush_scope(const sentry::Scope &scope) {
     }
+    // writes out anything that was deferred.  Called when a crash is
+    // imminent and on shutdown.
+    virtual void flush_pending() {
+    }
     virtual void add_breadcrumb(sentry::Value breadcrumb) {
     }
+    // whether `add_breadcrumb` does anything.  Breadcrumbs recorded with
+    // `sentry_record_breadcrumb` only become values for such backends.
+    virtual bool wants_breadcrumbs() const {
+        return false;
+    }
 
    private:
     Backend(const Backend &) = delete;
@@ -19,6 +19,25 @@
 using namespace sentry;
 using namespace backends;
 
+#ifdef SENTRY_CRASHPAD_BLACKBOX
+static std::atomic<CrashpadBackend *> g_backend(nullptr);
+
+bool CrashpadBackend::handle_first_chance(int signum,
+                                          siginfo_t *info,
+                                          ucontext_t *context) {
+    (void)signum;
+    (void)info;
+    (void)context;
+    CrashpadBackend *backend = g_backend.load();
+    if (backend) {
+        backend->blackbox.write_files(backend->event_filename,
+                                      backend->breadcrumb_filename);
+    }
+    // crashpad still writes the minidump
+    return false;
+}
+#endif
+
 CrashpadBackend::CrashpadBackend()
     : breadcrumb_fileid(0), breadcrumbs_in_segment(0) {
 }
@@ -77,6 +96,24 @@ void CrashpadBackend::start() {
         return;
     }
 
+    // without a first chance handler nothing brings the event file up to
+    // date once the process crashed, so every change is written right away.
+    std::chrono::milliseconds flush_interval(0);
+#ifdef SENTRY_CRASHPAD_BLACKBOX
+    breadcrumb_filename = current_run_folder.join(SENTRY_BREADCRUMBS1_FILE);
+    if (blackbox.open(current_run_folder.join(SENTRY_BLACKBOX_FILE))) {
+        g_backend = this;
+        crashpad::CrashpadClient::SetFirstChanceExceptionHandler(
+            &CrashpadBackend::handle_first_chance);
+        flush_interval =
+            std::chrono::milliseconds(options->scope_flush_interval);
+    }
+    scope_flusher.set_breadcrumbs_path(breadcrumb_filename);
+#endif
+    scope_flusher.start(event_filename,
+                        current_run_folder.join(SENTRY_EVENT_TEMP_FILE),
+                        flush_interval);
+
     std::unique_ptr<crashpad::CrashReportDatabase> db =
         crashpad::CrashReportDatabase::Initialize(database);
 
@@ -85,20 +122,32 @@ void CrashpadBackend::start() {
     }
 }
 
+void CrashpadBackend::shutdown() {
+    scope_flusher.shutdown();
+#ifdef SENTRY_CRASHPAD_BLACKBOX
+    g_backend = nullptr;
+    blackbox.close();
+#endif
+}
+
 void CrashpadBackend::flush_scope(const sentry::Scope &scope) {
-    mpack_writer_t writer;
-    mpack_writer_init_stdfile(&writer, event_filename.open("wb"), true);
-    Value event = Value::new_object();
-    scope.apply_to_event(event, SENTRY_SCOPE_NONE);
-    event.to_msgpack(&writer);
-    mpack_error_t err = mpack_writer_destroy(&writer);
-    if (err != mpack_ok) {
-        SENTRY_LOGF("an error occurred encoding the data. Code: %d", err);
-        return;
-    }
+#ifdef SENTRY_CRASHPAD_BLACKBOX
+    blackbox.write_scope(scope);
+#endif
+    // called right after `scope` was published, so the snapshot is the same
+    scope_flusher.mark_dirty(Scope::snapshot());
+}
+
+void CrashpadBackend::flush_pending() {
+    scope_flusher.flush();
 }
 
 void CrashpadBackend::add_breadcrumb(sentry::Value breadcrumb) {
+#ifdef SENTRY_CRASHPAD_BLACKBOX
+    blackbox.add_breadcrumb(breadcrumb);
+    // the breadcrumb file is written along with the scope
+    scope_flusher.mark_dirty(Scope::snapshot());
+#else
     std::lock_guard<std::mutex> _blck(breadcrumb_lock);
     const sentry_options_t *opts = sentry_get_options();
 
@@ -123,5 +172,6 @@ void CrashpadBackend::add_breadcrumb(sentry::Value breadcrumb) {
     free(mpack);
 
     breadcrumbs_in_segment++;
+#endif
 }
 #endif
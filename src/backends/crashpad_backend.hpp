@@ -4,12 +4,23 @@
 
 #include <mutex>
 
+#include "../blackbox.hpp"
 #include "../internal.hpp"
 #include "../path.hpp"
 #include "../scope.hpp"
+#include "../scope_flusher.hpp"
 
 #include "base_backend.hpp"
 
+// the black box is copied into the attachment files by a first chance
+// handler, which crashpad only offers on Linux.  Elsewhere every breadcrumb
+// is appended to the breadcrumb files right away.
+#if defined(__linux__)
+#define SENTRY_CRASHPAD_BLACKBOX
+#include <signal.h>
+#include <ucontext.h>
+#endif
+
 namespace sentry {
 namespace backends {
 
@@ -18,10 +29,29 @@ class CrashpadBackend : public Backend {
     CrashpadBackend();
 
     void start();
+    void shutdown();
     void flush_scope(const sentry::Scope &scope);
+    void flush_pending();
     void add_breadcrumb(sentry::Value breadcrumb);
+    bool wants_breadcrumbs() const {
+        return true;
+    }
 
    private:
+#ifdef SENTRY_CRASHPAD_BLACKBOX
+    static bool handle_first_chance(int signum,
+                                    siginfo_t *info,
+                                    ucontext_t *context);
+
+    // the black box has the scope and breadcrumbs at the time of the crash.
+    // The debounced flusher writes the attachment files after the fact, and
+    // the first chance handler brings them up to date.  The flusher keeps
+    // running while the black box is open: the handler only replaces the
+    // files if it could read the black box, and a crash that damaged it
+    // still gets the scope of the last flush.
+    BlackBox blackbox;
+#endif
+    ScopeFlusher scope_flusher;
     Path event_filename;
     Path breadcrumb_filename;
     std::mutex breadcrumb_lock;
@@ -1,6 +1,7 @@
 #include "inproc_backend.hpp"
 #ifdef SENTRY_WITH_INPROC_BACKEND
 
+#include "../breadcrumbs.hpp"
 #include "../io.hpp"
 #include "../options.hpp"
 #include "../scope.hpp"
@@ -125,12 +126,25 @@ static void handle_signal(int signum, siginfo_t *info, void *user_context) {
         values.append(exc);
         event.set_by_key("exception", exceptions);
 
+        // the breadcrumbs live in the rings of the threads, not the scope
         Scope::with_scope([&event](const Scope &scope) {
-            scope.apply_to_event(event, SENTRY_SCOPE_ALL);
+            scope.apply_to_event(event, (ScopeMode)(SENTRY_SCOPE_ALL &
+                                                    ~SENTRY_SCOPE_BREADCRUMBS));
+            Value breadcrumbs = collect_breadcrumbs(scope.breadcrumbs,
+                                                    SENTRY_BREADCRUMBS_MAX);
+            if (breadcrumbs.length() > 0) {
+                event.merge_key("breadcrumbs", breadcrumbs);
+            }
         });
 
         Envelope e(event);
         const sentry_options_t *opts = sentry_get_options();
+        for (const Attachment &attachment : opts->attachments) {
+            EnvelopeItem item(attachment.path(), "attachment",
+                              opts->max_attachment_size);
+            item.set_header("name", Value::new_string(attachment.name()));
+            e.add_item(std::move(item));
+        }
         opts->transport->send_envelope(e);
     }
 
@@ -0,0 +1,432 @@
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "vendor/mpack.h"
+
+#include "blackbox.hpp"
+
+using namespace sentry;
+
+static const uint64_t BLACKBOX_MAGIC = 0x31786f6262746e73ULL;  // "sntbbox1"
+static const size_t HEADER_SIZE = 4096;
+static const size_t READ_ATTEMPTS = 16;
+
+struct BlackBox::Header {
+    std::atomic<uint64_t> magic;
+    uint64_t scope_size;
+    uint64_t breadcrumbs_size;
+    // the number of committed scope writes.  Write `n` goes to slot `n & 1`.
+    alignas(64) std::atomic<uint64_t> scope_seq;
+    // the number of breadcrumb segment rotations.  The segment at
+    // `rotations & 1` is the one that is appended to.
+    alignas(64) std::atomic<uint64_t> rotations;
+};
+
+// the scope slot that write `n` goes to has a sequence of `2n - 1` while it
+// is being written and `2n` once it is complete.
+struct ScopeSlot {
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> len;
+};
+
+// the generation of a breadcrumb segment is odd while it is being reset.
+struct BreadcrumbSegment {
+    std::atomic<uint64_t> gen;
+    std::atomic<uint64_t> len;
+    uint64_t count;
+};
+
+// where a read copies the data to.  A copy that turns out to be torn is
+// undone by truncating the sink to its size before the copy.
+struct BlackBox::Sink {
+    virtual ~Sink() {
+    }
+    virtual size_t size() const = 0;
+    virtual void append(const char *buf, size_t len) = 0;
+    virtual void truncate(size_t size) = 0;
+};
+
+struct BlackBox::StringSink : public BlackBox::Sink {
+    explicit StringSink(std::string *out) : out(out) {
+    }
+    size_t size() const {
+        return out->size();
+    }
+    void append(const char *buf, size_t len) {
+        out->append(buf, len);
+    }
+    void truncate(size_t size) {
+        out->resize(size);
+    }
+
+    std::string *out;
+};
+
+// only uses async-signal-safe calls.
+struct BlackBox::FileSink : public BlackBox::Sink {
+    explicit FileSink(int fd) : fd(fd), written(0), ok(fd >= 0) {
+    }
+    size_t size() const {
+        return written;
+    }
+    void append(const char *buf, size_t len) {
+        while (ok && len > 0) {
+            ssize_t rv = ::write(fd, buf, len);
+            if (rv < 0 && errno == EINTR) {
+                continue;
+            }
+            ok = rv > 0;
+            if (ok) {
+                buf += rv;
+                len -= (size_t)rv;
+                written += (size_t)rv;
+            }
+        }
+    }
+    void truncate(size_t size) {
+        ok = ok && ftruncate(fd, (off_t)size) == 0 &&
+             lseek(fd, (off_t)size, SEEK_SET) == (off_t)size;
+        written = size;
+    }
+
+    int fd;
+    size_t written;
+    bool ok;
+};
+
+static size_t align8(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+static size_t slot_stride(uint64_t scope_size) {
+    return sizeof(ScopeSlot) + align8((size_t)scope_size);
+}
+
+static size_t segment_stride(uint64_t breadcrumbs_size) {
+    return sizeof(BreadcrumbSegment) + align8((size_t)breadcrumbs_size);
+}
+
+static size_t mapping_size_for(uint64_t scope_size, uint64_t breadcrumbs_size) {
+    return HEADER_SIZE + 2 * slot_stride(scope_size) +
+           2 * segment_stride(breadcrumbs_size);
+}
+
+static ScopeSlot *get_slot(const char *mapping,
+                           uint64_t scope_size,
+                           uint64_t index) {
+    return (ScopeSlot *)(mapping + HEADER_SIZE +
+                         (index & 1) * slot_stride(scope_size));
+}
+
+static BreadcrumbSegment *get_segment(const char *mapping,
+                                      uint64_t scope_size,
+                                      uint64_t breadcrumbs_size,
+                                      uint64_t index) {
+    return (BreadcrumbSegment *)(mapping + HEADER_SIZE +
+                                 2 * slot_stride(scope_size) +
+                                 (index & 1) *
+                                     segment_stride(breadcrumbs_size));
+}
+
+BlackBox::BlackBox() : m_header(nullptr), m_mapping_size(0) {
+}
+
+BlackBox::~BlackBox() {
+    close();
+}
+
+bool BlackBox::open(const Path &path,
+                    size_t scope_size,
+                    size_t breadcrumbs_size) {
+    close();
+
+    size_t mapping_size = mapping_size_for(scope_size, breadcrumbs_size);
+    int fd = ::open(path.as_osstr(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        SENTRY_LOG("failed to open the crash context file");
+        return false;
+    }
+    // a zero filled file is a black box without a scope and breadcrumbs
+    if (ftruncate(fd, (off_t)mapping_size) != 0) {
+        ::close(fd);
+        return false;
+    }
+    void *mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    Header *header = (Header *)mapping;
+    header->scope_size = scope_size;
+    header->breadcrumbs_size = breadcrumbs_size;
+    header->magic.store(BLACKBOX_MAGIC, std::memory_order_release);
+
+    std::lock_guard<std::mutex> _lock(m_lock);
+    m_header = header;
+    m_mapping_size = mapping_size;
+    // `write_files` cannot allocate, so its temporary files are named now
+    m_scope_temp = Path((std::string(path.as_osstr()) + ".scope").c_str());
+    m_breadcrumbs_temp =
+        Path((std::string(path.as_osstr()) + ".breadcrumbs").c_str());
+    return true;
+}
+
+void BlackBox::close() {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    if (m_header) {
+        munmap((void *)m_header, m_mapping_size);
+        m_header = nullptr;
+        m_mapping_size = 0;
+    }
+}
+
+bool BlackBox::write_scope(const Scope &scope) {
+    Value event = Value::new_object();
+    scope.apply_to_event(event, SENTRY_SCOPE_NONE);
+
+    std::lock_guard<std::mutex> _lock(m_lock);
+    if (!m_header) {
+        return false;
+    }
+    uint64_t n = m_header->scope_seq.load(std::memory_order_relaxed) + 1;
+    ScopeSlot *slot = get_slot((const char *)m_header, m_header->scope_size, n);
+
+    slot->seq.store(2 * n - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    mpack_writer_t writer;
+    mpack_writer_init(&writer, (char *)(slot + 1),
+                      (size_t)m_header->scope_size);
+    event.to_msgpack(&writer);
+    size_t len = mpack_writer_buffer_used(&writer);
+    mpack_error_t err = mpack_writer_destroy(&writer);
+    if (err != mpack_ok) {
+        // the slot stays odd and is never read, the previous write is still
+        // the committed one.
+        SENTRY_LOGF("failed to encode the scope into the black box: %d", err);
+        return false;
+    }
+
+    slot->len.store(len, std::memory_order_relaxed);
+    slot->seq.store(2 * n, std::memory_order_release);
+    m_header->scope_seq.store(n, std::memory_order_release);
+    return true;
+}
+
+bool BlackBox::add_breadcrumb(const Value &breadcrumb) {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    if (!m_header) {
+        return false;
+    }
+    const char *mapping = (const char *)m_header;
+    uint64_t size = m_header->breadcrumbs_size;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        uint64_t rotations =
+            m_header->rotations.load(std::memory_order_relaxed);
+        BreadcrumbSegment *segment =
+            get_segment(mapping, m_header->scope_size, size, rotations);
+        uint64_t len = segment->len.load(std::memory_order_relaxed);
+
+        if (segment->count < SENTRY_BREADCRUMBS_MAX) {
+            mpack_writer_t writer;
+            mpack_writer_init(&writer, (char *)(segment + 1) + len,
+                              (size_t)(size - len));
+            breadcrumb.to_msgpack(&writer);
+            size_t used = mpack_writer_buffer_used(&writer);
+            mpack_error_t err = mpack_writer_destroy(&writer);
+            if (err == mpack_ok) {
+                segment->count++;
+                segment->len.store(len + used, std::memory_order_release);
+                return true;
+            } else if (err != mpack_error_too_big || len == 0) {
+                SENTRY_LOGF(
+                    "failed to encode a breadcrumb into the black box: %d",
+                    err);
+                return false;
+            }
+        }
+
+        // start over in the other segment, which drops the oldest crumbs
+        BreadcrumbSegment *next =
+            get_segment(mapping, m_header->scope_size, size, rotations + 1);
+        uint64_t gen = next->gen.load(std::memory_order_relaxed);
+        next->gen.store(gen + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        next->len.store(0, std::memory_order_relaxed);
+        next->count = 0;
+        next->gen.store(gen + 2, std::memory_order_release);
+        m_header->rotations.store(rotations + 1, std::memory_order_release);
+    }
+    return false;
+}
+
+// copies the committed scope.  Returns `false` if a writer got in the way.
+template <typename Sink>
+static bool read_scope(const char *mapping,
+                       uint64_t scope_size,
+                       const std::atomic<uint64_t> &scope_seq,
+                       Sink *out) {
+    uint64_t n = scope_seq.load(std::memory_order_acquire);
+    out->truncate(0);
+    if (n == 0) {
+        return true;
+    }
+    const ScopeSlot *slot = get_slot(mapping, scope_size, n);
+    uint64_t seq = slot->seq.load(std::memory_order_acquire);
+    if (seq != 2 * n) {
+        return false;
+    }
+    uint64_t len = slot->len.load(std::memory_order_relaxed);
+    if (len > scope_size) {
+        return false;
+    }
+    out->append((const char *)(slot + 1), (size_t)len);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->seq.load(std::memory_order_relaxed) == seq;
+}
+
+// appends the contents of a segment to `out`.  A segment that is being
+// reset is about to lose its crumbs anyway and counts as empty.
+template <typename Sink>
+static void read_segment(const BreadcrumbSegment *segment,
+                         uint64_t size,
+                         Sink *out) {
+    uint64_t gen = segment->gen.load(std::memory_order_acquire);
+    if (gen & 1) {
+        return;
+    }
+    uint64_t len = segment->len.load(std::memory_order_acquire);
+    if (len > size) {
+        return;
+    }
+    size_t start = out->size();
+    out->append((const char *)(segment + 1), (size_t)len);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (segment->gen.load(std::memory_order_relaxed) != gen) {
+        out->truncate(start);
+    }
+}
+
+bool BlackBox::read_mapping(const char *mapping,
+                            size_t mapping_size,
+                            Sink *scope_out,
+                            Sink *breadcrumbs_out) {
+    const Header *header = (const Header *)mapping;
+    if (mapping_size < HEADER_SIZE ||
+        header->magic.load(std::memory_order_acquire) != BLACKBOX_MAGIC ||
+        header->scope_size > mapping_size ||
+        header->breadcrumbs_size > mapping_size ||
+        mapping_size_for(header->scope_size, header->breadcrumbs_size) >
+            mapping_size) {
+        return false;
+    }
+    uint64_t scope_size = header->scope_size;
+    uint64_t size = header->breadcrumbs_size;
+
+    bool scope_read = !scope_out;
+    bool breadcrumbs_read = !breadcrumbs_out;
+    for (size_t i = 0; i < READ_ATTEMPTS; i++) {
+        if (!scope_read) {
+            scope_read =
+                read_scope(mapping, scope_size, header->scope_seq, scope_out);
+        }
+        if (!breadcrumbs_read) {
+            uint64_t rotations =
+                header->rotations.load(std::memory_order_acquire);
+            breadcrumbs_out->truncate(0);
+            read_segment(get_segment(mapping, scope_size, size, rotations + 1),
+                         size, breadcrumbs_out);
+            read_segment(get_segment(mapping, scope_size, size, rotations),
+                         size, breadcrumbs_out);
+            breadcrumbs_read =
+                header->rotations.load(std::memory_order_acquire) == rotations;
+        }
+        if (scope_read && breadcrumbs_read) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BlackBox::read(std::string *scope_out,
+                    std::string *breadcrumbs_out) const {
+    // the mapping is only replaced by `open` and `close`, which are not
+    // called while the black box is in use.
+    if (!m_header) {
+        return false;
+    }
+    StringSink scope(scope_out);
+    StringSink breadcrumbs(breadcrumbs_out);
+    return read_mapping((const char *)m_header, m_mapping_size,
+                        scope_out ? &scope : nullptr,
+                        breadcrumbs_out ? &breadcrumbs : nullptr);
+}
+
+bool BlackBox::read_file(const Path &path,
+                         std::string *scope_out,
+                         std::string *breadcrumbs_out) {
+    int fd = ::open(path.as_osstr(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < HEADER_SIZE) {
+        ::close(fd);
+        return false;
+    }
+    size_t mapping_size = (size_t)st.st_size;
+    void *mapping =
+        mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    StringSink scope(scope_out);
+    StringSink breadcrumbs(breadcrumbs_out);
+    bool rv = read_mapping((const char *)mapping, mapping_size,
+                           scope_out ? &scope : nullptr,
+                           breadcrumbs_out ? &breadcrumbs : nullptr);
+    munmap(mapping, mapping_size);
+    return rv;
+}
+
+bool BlackBox::write_files(const Path &scope_path,
+                           const Path &breadcrumbs_path) const {
+    if (!m_header) {
+        return false;
+    }
+    FileSink scope(::open(m_scope_temp.as_osstr(),
+                          O_WRONLY | O_CREAT | O_TRUNC, 0600));
+    FileSink breadcrumbs(::open(m_breadcrumbs_temp.as_osstr(),
+                                O_WRONLY | O_CREAT | O_TRUNC, 0600));
+    bool rv = scope.ok && breadcrumbs.ok &&
+              read_mapping((const char *)m_header, m_mapping_size, &scope,
+                           &breadcrumbs) &&
+              scope.ok && breadcrumbs.ok;
+    if (scope.fd >= 0) {
+        ::close(scope.fd);
+    }
+    if (breadcrumbs.fd >= 0) {
+        ::close(breadcrumbs.fd);
+    }
+
+    // the previous files stay in place unless both could be written
+    if (rv) {
+        rv = ::rename(m_breadcrumbs_temp.as_osstr(),
+                      breadcrumbs_path.as_osstr()) == 0 &&
+             ::rename(m_scope_temp.as_osstr(), scope_path.as_osstr()) == 0;
+    }
+    ::unlink(m_scope_temp.as_osstr());
+    ::unlink(m_breadcrumbs_temp.as_osstr());
+    return rv;
+}
+#endif
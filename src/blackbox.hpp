@@ -0,0 +1,92 @@
+#ifndef SENTRY_BLACKBOX_HPP_INCLUDED
+#define SENTRY_BLACKBOX_HPP_INCLUDED
+#ifndef _WIN32
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include "internal.hpp"
+#include "path.hpp"
+#include "scope.hpp"
+#include "value.hpp"
+
+namespace sentry {
+
+// a memory mapped file that mirrors the scope and the breadcrumbs so that
+// they can be read after the process died.
+//
+// The file has a fixed size and is mapped shared, so updates are plain
+// memory stores that the kernel writes back even if the process crashes.
+// The scope is encoded into one of two slots in turn and published by
+// bumping a sequence number once it is complete, which keeps the previous
+// scope intact until then.  Breadcrumbs are appended to one of two
+// segments that are rotated like the breadcrumb files, and every append
+// is published by storing the new length of its segment.  Readers, be it
+// another thread or a process that reads the file after a crash, only
+// ever see complete writes.
+class BlackBox {
+   public:
+    BlackBox();
+    ~BlackBox();
+
+    // creates or truncates the file at `path` and maps it.
+    bool open(const Path &path,
+              size_t scope_size = SENTRY_BLACKBOX_SCOPE_SIZE,
+              size_t breadcrumbs_size = SENTRY_BLACKBOX_BREADCRUMBS_SIZE);
+    void close();
+    bool is_open() const {
+        return m_header != nullptr;
+    }
+
+    // encodes the scope in the same format as the event file.  Fails and
+    // keeps the previous scope if it does not fit.
+    bool write_scope(const Scope &scope);
+    bool add_breadcrumb(const Value &breadcrumb);
+
+    // reads a consistent copy of the mapped data.  `scope_out` receives the
+    // msgpack encoded event, `breadcrumbs_out` the msgpack encoded
+    // breadcrumbs from oldest to newest.
+    bool read(std::string *scope_out, std::string *breadcrumbs_out) const;
+
+    // reads the black box that a previous, possibly crashed, process left
+    // behind at `path`.
+    static bool read_file(const Path &path,
+                          std::string *scope_out,
+                          std::string *breadcrumbs_out);
+
+    // writes the same data as `read` to the files at `scope_path` and
+    // `breadcrumbs_path`, which then look like the event and breadcrumb
+    // files.  They are written next to the black box and renamed into
+    // place, so a damaged black box leaves the previous files alone.
+    // Neither allocates nor takes locks, so this is safe to call from a
+    // signal handler.
+    bool write_files(const Path &scope_path,
+                     const Path &breadcrumbs_path) const;
+
+   private:
+    BlackBox(const BlackBox &) = delete;
+    BlackBox &operator=(const BlackBox &) = delete;
+
+    struct Header;
+    struct Sink;
+    struct StringSink;
+    struct FileSink;
+
+    static bool read_mapping(const char *mapping,
+                             size_t mapping_size,
+                             Sink *scope_out,
+                             Sink *breadcrumbs_out);
+
+    Header *m_header;
+    size_t m_mapping_size;
+    Path m_scope_temp;
+    Path m_breadcrumbs_temp;
+    // serializes writers, readers never take it
+    std::mutex m_lock;
+};
+
+}  // namespace sentry
+
+#endif
+#endif
@@ -0,0 +1,630 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "options.hpp"
+
+#include "breadcrumbs.hpp"
+
+using namespace sentry;
+
+namespace {
+const uint8_t RECORD_HAS_MESSAGE = 0x1;
+const uint16_t NO_ATOM = 0;
+
+// the fixed part of a record, followed by the message and the blob.
+struct RecordHeader {
+    // of the whole record including padding
+    uint32_t size;
+    uint32_t message_len;
+    uint32_t data_len;
+    uint16_t type;
+    uint16_t category;
+    int8_t level;
+    uint8_t flags;
+    uint64_t seq;
+    // milliseconds since the epoch, 0 if the blob has the timestamp
+    uint64_t timestamp;
+};
+
+size_t record_size(size_t message_len, size_t data_len) {
+    return (sizeof(RecordHeader) + message_len + data_len + 7) & ~(size_t)7;
+}
+
+// interned type and category strings.  Atoms are never freed, there are
+// only a handful of distinct types and categories in practice.
+struct AtomTable {
+    AtomTable() : count(1) {
+    }
+
+    std::mutex lock;
+    std::unordered_map<std::string, uint16_t> ids;
+    std::atomic<const char *> names[SENTRY_BREADCRUMB_ATOMS_MAX];
+    std::atomic<uint16_t> count;
+};
+
+// intentionally leaked, breadcrumbs can be recorded during static
+// destruction.
+AtomTable &atoms() {
+    static AtomTable *atoms = new AtomTable();
+    return *atoms;
+}
+
+// returns the atom for `name`, or `NO_ATOM` if the table is full.
+uint16_t intern(const char *name) {
+    // callers tend to pass the same few literals over and over
+    struct CacheEntry {
+        const char *name;
+        uint16_t atom;
+    };
+    static thread_local CacheEntry cache[8];
+    static thread_local size_t next_entry;
+
+    AtomTable &table = atoms();
+    for (size_t i = 0; i < 8; i++) {
+        if (cache[i].name == name &&
+            strcmp(table.names[cache[i].atom].load(), name) == 0) {
+            return cache[i].atom;
+        }
+    }
+
+    uint16_t atom;
+    {
+        std::lock_guard<std::mutex> _lock(table.lock);
+        std::unordered_map<std::string, uint16_t>::iterator iter =
+            table.ids.find(name);
+        if (iter != table.ids.end()) {
+            atom = iter->second;
+        } else if (table.count.load() < SENTRY_BREADCRUMB_ATOMS_MAX) {
+            atom = table.count.load();
+            iter = table.ids.emplace(name, atom).first;
+            table.names[atom].store(iter->first.c_str());
+            table.count.store(atom + 1);
+        } else {
+            return NO_ATOM;
+        }
+    }
+    cache[next_entry] = CacheEntry{name, atom};
+    next_entry = (next_entry + 1) % 8;
+    return atom;
+}
+
+// returns the atom for `name` if it was interned before, `NO_ATOM`
+// otherwise.  Unlike `intern` this neither takes the lock of the table nor
+// adds to it.
+uint16_t find_atom(const char *name) {
+    AtomTable &table = atoms();
+    uint16_t count = table.count.load();
+    for (uint16_t atom = 1; atom < count; atom++) {
+        const char *atom_name = table.names[atom].load();
+        if (atom_name && strcmp(atom_name, name) == 0) {
+            return atom;
+        }
+    }
+    return NO_ATOM;
+}
+
+const char *atom_name(uint16_t atom) {
+    AtomTable &table = atoms();
+    return atom != NO_ATOM && atom < table.count.load()
+               ? table.names[atom].load()
+               : nullptr;
+}
+
+struct RecordCopy {
+    uint64_t seq;
+    std::string bytes;
+};
+
+bool operator<(const RecordCopy &a, const RecordCopy &b) {
+    return a.seq < b.seq;
+}
+
+// the ring of one thread.
+//
+// Only the owning thread appends, which never blocks.  Other threads copy
+// records out without a lock and throw away everything the owner may have
+// overwritten in the meantime: the owner announces the range it is about to
+// write before it writes it, and a copied record is only kept if that range
+// has not reached it.
+class BreadcrumbRing {
+   public:
+    explicit BreadcrumbRing(size_t capacity)
+        : next(nullptr),
+          m_data(new char[capacity]),
+          m_capacity(capacity),
+          m_head(0),
+          m_write_end(0),
+          m_count(0) {
+        for (size_t i = 0; i < SENTRY_BREADCRUMBS_MAX; i++) {
+            m_offsets[i] = 0;
+        }
+    }
+
+    size_t capacity() const {
+        return m_capacity;
+    }
+
+    // the ring that was created before this one
+    BreadcrumbRing *next;
+
+    void append(const RecordHeader &header,
+                const char *message,
+                const char *data) {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        m_write_end.store(head + header.size, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        copy_in(head, (const char *)&header, sizeof(header));
+        copy_in(head + sizeof(header), message, header.message_len);
+        copy_in(head + sizeof(header) + header.message_len, data,
+                header.data_len);
+
+        uint64_t count = m_count.load(std::memory_order_relaxed);
+        m_offsets[count % SENTRY_BREADCRUMBS_MAX].store(
+            head, std::memory_order_relaxed);
+        m_head.store(head + header.size, std::memory_order_release);
+        m_count.store(count + 1, std::memory_order_release);
+    }
+
+    void copy_into(std::vector<RecordCopy> &out) const {
+        uint64_t count = m_count.load(std::memory_order_acquire);
+        uint64_t first =
+            count > SENTRY_BREADCRUMBS_MAX ? count - SENTRY_BREADCRUMBS_MAX : 0;
+        size_t start = out.size();
+        std::vector<uint64_t> positions;
+        for (uint64_t i = first; i < count; i++) {
+            uint64_t pos = m_offsets[i % SENTRY_BREADCRUMBS_MAX].load(
+                std::memory_order_relaxed);
+            RecordHeader header;
+            copy_out(pos, (char *)&header, sizeof(header));
+            if (header.size < sizeof(header) ||
+                header.size > m_capacity) {
+                continue;
+            }
+            RecordCopy copy;
+            copy.seq = header.seq;
+            copy.bytes.resize(header.size);
+            copy_out(pos, &copy.bytes[0], header.size);
+            out.push_back(std::move(copy));
+            positions.push_back(pos);
+        }
+
+        // drop whatever the owner got to while we were copying.  A slot of
+        // `m_offsets` is reused for record `i + SENTRY_BREADCRUMBS_MAX`,
+        // which may already be in progress if `m_count` says `i + MAX`.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t write_end = m_write_end.load(std::memory_order_relaxed);
+        uint64_t count_now = m_count.load(std::memory_order_relaxed);
+        size_t kept = start;
+        for (size_t i = start; i < out.size(); i++) {
+            uint64_t index = first + (i - start);
+            uint64_t pos = positions[i - start];
+            if (index + SENTRY_BREADCRUMBS_MAX > count_now &&
+                write_end <= pos + m_capacity) {
+                if (kept != i) {
+                    out[kept] = std::move(out[i]);
+                }
+                kept++;
+            }
+        }
+        out.resize(kept);
+    }
+
+   private:
+    void copy_in(uint64_t pos, const char *buf, size_t len) {
+        if (len == 0) {
+            return;
+        }
+        size_t offset = pos % m_capacity;
+        size_t first = std::min(len, m_capacity - offset);
+        memcpy(&m_data[offset], buf, first);
+        memcpy(&m_data[0], buf + first, len - first);
+    }
+
+    void copy_out(uint64_t pos, char *buf, size_t len) const {
+        size_t offset = pos % m_capacity;
+        size_t first = std::min(len, m_capacity - offset);
+        memcpy(buf, &m_data[offset], first);
+        memcpy(buf + first, &m_data[0], len - first);
+    }
+
+    std::unique_ptr<char[]> m_data;
+    size_t m_capacity;
+    std::atomic<uint64_t> m_offsets[SENTRY_BREADCRUMBS_MAX];
+    std::atomic<uint64_t> m_head;
+    std::atomic<uint64_t> m_write_end;
+    std::atomic<uint64_t> m_count;
+};
+
+struct RingRegistry {
+    RingRegistry() : seq(0), newest(nullptr) {
+    }
+
+    std::atomic<uint64_t> seq;
+    std::mutex lock;
+    std::vector<std::shared_ptr<BreadcrumbRing>> rings;
+    // the same rings as a list that readers walk without taking `lock`,
+    // which is safe as rings are never freed.
+    std::atomic<BreadcrumbRing *> newest;
+    // rings of threads that have exited, waiting for a new owner
+    std::vector<std::shared_ptr<BreadcrumbRing>> idle;
+};
+
+// intentionally leaked so that threads exiting during static destruction
+// can still hand back their ring.
+RingRegistry &registry() {
+    static RingRegistry *registry = new RingRegistry();
+    return *registry;
+}
+
+size_t breadcrumbs_max_bytes() {
+    const sentry_options_t *opts = sentry_get_options();
+    return opts ? opts->breadcrumbs_max_bytes : SENTRY_BREADCRUMBS_BYTES_MAX;
+}
+
+class ThreadRing {
+   public:
+    ThreadRing() {
+        // a ring keeps its size, later changes of the options only apply to
+        // rings of new threads.
+        size_t capacity = std::max(breadcrumbs_max_bytes(),
+                                   (size_t)SENTRY_BREADCRUMBS_BYTES_MIN);
+
+        RingRegistry &reg = registry();
+        std::lock_guard<std::mutex> _lock(reg.lock);
+        for (size_t i = reg.idle.size(); i > 0; i--) {
+            if (reg.idle[i - 1]->capacity() == capacity) {
+                m_ring = reg.idle[i - 1];
+                reg.idle.erase(reg.idle.begin() + (i - 1));
+                return;
+            }
+        }
+        m_ring.reset(new BreadcrumbRing(capacity));
+        m_ring->next = reg.newest.load(std::memory_order_relaxed);
+        reg.rings.push_back(m_ring);
+        reg.newest.store(m_ring.get(), std::memory_order_release);
+    }
+
+    ~ThreadRing() {
+        RingRegistry &reg = registry();
+        std::lock_guard<std::mutex> _lock(reg.lock);
+        reg.idle.push_back(m_ring);
+    }
+
+    BreadcrumbRing &ring() {
+        return *m_ring;
+    }
+
+   private:
+    std::shared_ptr<BreadcrumbRing> m_ring;
+};
+
+BreadcrumbRing &thread_ring() {
+    static thread_local ThreadRing ring;
+    return ring.ring();
+}
+
+// returns the largest record that may go into a ring of `capacity` bytes.
+// Records are capped so that a ring always holds a few of them.
+size_t record_size_max(size_t capacity) {
+    const sentry_options_t *opts = sentry_get_options();
+    size_t rv = opts ? opts->breadcrumb_max_size : SENTRY_BREADCRUMB_SIZE_MAX;
+    rv = std::min(rv, capacity / 4);
+    return std::max(rv, record_size(0, 0) + 8);
+}
+
+// the limit for breadcrumbs that are not recorded into the calling
+// thread's ring, which is what a new ring would get.
+size_t default_record_size_max() {
+    return record_size_max(std::max(breadcrumbs_max_bytes(),
+                                    (size_t)SENTRY_BREADCRUMBS_BYTES_MIN));
+}
+
+// a record before it is written.  The message and the blob point into
+// memory of the caller.
+struct RecordParts {
+    RecordHeader header;
+    const char *message;
+    size_t message_len;
+    const char *data;
+    size_t data_len;
+};
+
+// cuts a record down to `size_max`: the blob is dropped first, then the
+// message is truncated.  This fills in the sizes of the header.
+void fit_record(RecordParts &parts, size_t size_max) {
+    if (record_size(parts.message_len, parts.data_len) > size_max) {
+        parts.data_len = 0;
+    }
+    if (record_size(parts.message_len, 0) > size_max) {
+        parts.message_len = size_max - sizeof(RecordHeader);
+    }
+    parts.header.size =
+        (uint32_t)record_size(parts.message_len, parts.data_len);
+    parts.header.message_len = (uint32_t)parts.message_len;
+    parts.header.data_len = (uint32_t)parts.data_len;
+}
+
+// appends a record that is cut down to `size_max`.
+void append_record(RecordParts &parts, size_t size_max) {
+    fit_record(parts, size_max);
+    parts.header.seq = registry().seq.fetch_add(1, std::memory_order_relaxed);
+    thread_ring().append(parts.header, parts.message, parts.data);
+}
+
+// encodes `blob` into a buffer of the calling thread.  Returns the number
+// of bytes written, 0 if there is nothing to write or it is larger than
+// `size_max`.
+size_t encode_blob(const Value &blob, size_t size_max, const char **data_out) {
+    static thread_local std::vector<char> buf;
+    if (blob.length() == 0) {
+        return 0;
+    }
+    if (buf.size() < size_max) {
+        buf.resize(size_max);
+    }
+    mpack_writer_t writer;
+    mpack_writer_init(&writer, &buf[0], size_max);
+    blob.to_msgpack(&writer);
+    size_t len = mpack_writer_buffer_used(&writer);
+    if (mpack_writer_destroy(&writer) != mpack_ok) {
+        return 0;
+    }
+    *data_out = &buf[0];
+    return len;
+}
+
+Value materialize(const std::string &bytes) {
+    RecordHeader header;
+    memcpy(&header, bytes.data(), sizeof(header));
+    const char *message = bytes.data() + sizeof(header);
+    const char *data = message + header.message_len;
+
+    Value rv;
+    if (header.data_len == 0 ||
+        !Value::from_msgpack(data, header.data_len, &rv) ||
+        rv.type() != SENTRY_VALUE_TYPE_OBJECT) {
+        rv = Value::new_object();
+    }
+    if (header.timestamp) {
+        time_t secs = (time_t)(header.timestamp / 1000);
+        char buf[255];
+        size_t len = strftime(buf, sizeof buf, "%FT%T", gmtime(&secs));
+        snprintf(buf + len, sizeof buf - len, ".%03dZ",
+                 (int)(header.timestamp % 1000));
+        rv.set_by_key("timestamp", Value::new_string(buf));
+    }
+    const char *type = atom_name(header.type);
+    if (type) {
+        rv.set_by_key("type", Value::new_string(type));
+    }
+    const char *category = atom_name(header.category);
+    if (category) {
+        rv.set_by_key("category", Value::new_string(category));
+    }
+    if (header.level != (int8_t)SCOPE_LEVEL_UNSET) {
+        rv.set_by_key("level", Value::new_level((sentry_level_t)header.level));
+    }
+    if (header.flags & RECORD_HAS_MESSAGE) {
+        rv.set_by_key("message",
+                      Value::new_string(message, header.message_len));
+    }
+    return rv;
+}
+
+// splits `breadcrumb` into the parts of a record: the type and category
+// become atoms, the message is stored as is and everything else goes into
+// the blob.  The message points into `breadcrumb`, the blob into a buffer of
+// the calling thread.  Unless `intern_atoms` is set only existing atoms are
+// used.
+void split_breadcrumb(const Value &breadcrumb,
+                      size_t size_max,
+                      bool intern_atoms,
+                      RecordParts &parts) {
+    parts = RecordParts();
+    parts.header.timestamp = 0;
+    parts.header.level = (int8_t)SCOPE_LEVEL_UNSET;
+
+    Value blob = breadcrumb.clone_shallow();
+    Value type = breadcrumb.get_by_key("type");
+    if (type.type() == SENTRY_VALUE_TYPE_STRING) {
+        parts.header.type = intern_atoms ? intern(type.as_cstr())
+                                         : find_atom(type.as_cstr());
+        if (parts.header.type != NO_ATOM) {
+            blob.remove_by_key("type");
+        }
+    }
+    Value category = breadcrumb.get_by_key("category");
+    if (category.type() == SENTRY_VALUE_TYPE_STRING) {
+        parts.header.category = intern_atoms ? intern(category.as_cstr())
+                                             : find_atom(category.as_cstr());
+        if (parts.header.category != NO_ATOM) {
+            blob.remove_by_key("category");
+        }
+    }
+    Value message = breadcrumb.get_by_key("message");
+    if (message.type() == SENTRY_VALUE_TYPE_STRING) {
+        parts.header.flags |= RECORD_HAS_MESSAGE;
+        parts.message = message.as_cstr();
+        parts.message_len = message.length();
+        blob.remove_by_key("message");
+    }
+    parts.data_len = encode_blob(blob, size_max, &parts.data);
+}
+
+// copies the parts of a record into one string.
+std::string join_record(const RecordParts &parts) {
+    std::string bytes(parts.header.size, '\0');
+    memcpy(&bytes[0], &parts.header, sizeof(parts.header));
+    if (parts.message_len) {
+        memcpy(&bytes[sizeof(parts.header)], parts.message,
+               parts.message_len);
+    }
+    if (parts.data_len) {
+        memcpy(&bytes[sizeof(parts.header) + parts.message_len], parts.data,
+               parts.data_len);
+    }
+    return bytes;
+}
+
+// turns an item of the breadcrumbs of pushed scopes into a record copy.
+// Items made by `layer_breadcrumb` already are records.  Other values are
+// encoded without interning atoms and are numbered after everything that
+// was recorded, starting at `seq`.
+bool copy_extra(const Value &item, uint64_t seq, RecordCopy &copy_out) {
+    if (item.type() == SENTRY_VALUE_TYPE_STRING) {
+        RecordHeader header;
+        if (item.length() < sizeof(header)) {
+            return false;
+        }
+        copy_out.bytes.assign(item.as_cstr(), item.length());
+        memcpy(&header, copy_out.bytes.data(), sizeof(header));
+        if (header.size != copy_out.bytes.size()) {
+            return false;
+        }
+        copy_out.seq = header.seq;
+        return true;
+    }
+
+    size_t size_max = default_record_size_max();
+    RecordParts parts;
+    split_breadcrumb(item, size_max, false, parts);
+    fit_record(parts, size_max);
+    parts.header.seq = seq;
+    copy_out.seq = seq;
+    copy_out.bytes = join_record(parts);
+    return true;
+}
+}  // namespace
+
+void sentry::record_breadcrumb(const Value &breadcrumb) {
+    size_t size_max = record_size_max(thread_ring().capacity());
+    RecordParts parts;
+    split_breadcrumb(breadcrumb, size_max, true, parts);
+    append_record(parts, size_max);
+}
+
+Value sentry::layer_breadcrumb(const Value &breadcrumb) {
+    size_t size_max = default_record_size_max();
+    RecordParts parts;
+    split_breadcrumb(breadcrumb, size_max, true, parts);
+    fit_record(parts, size_max);
+    parts.header.seq = registry().seq.fetch_add(1, std::memory_order_relaxed);
+    std::string bytes = join_record(parts);
+    return Value::new_string(bytes.data(), bytes.size());
+}
+
+void sentry::record_breadcrumb(const char *type,
+                               const char *category,
+                               sentry_level_t level,
+                               const char *message) {
+    RecordParts parts = RecordParts();
+    RecordHeader &header = parts.header;
+    header.timestamp =
+        (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    header.level = (int8_t)level;
+    header.type = type ? intern(type) : NO_ATOM;
+    header.category = category ? intern(category) : NO_ATOM;
+    if (message) {
+        header.flags |= RECORD_HAS_MESSAGE;
+        parts.message = message;
+        parts.message_len = strlen(message);
+    }
+
+    // only a full atom table needs the blob
+    size_t size_max = record_size_max(thread_ring().capacity());
+    if ((type && header.type == NO_ATOM) ||
+        (category && header.category == NO_ATOM)) {
+        Value blob = Value::new_object();
+        if (type && header.type == NO_ATOM) {
+            blob.set_by_key("type", Value::new_string(type));
+        }
+        if (category && header.category == NO_ATOM) {
+            blob.set_by_key("category", Value::new_string(category));
+        }
+        parts.data_len = encode_blob(blob, size_max, &parts.data);
+    }
+    append_record(parts, size_max);
+}
+
+uint64_t sentry::breadcrumbs_cutoff() {
+    return registry().seq.load(std::memory_order_relaxed);
+}
+
+Value sentry::collect_breadcrumbs(const Value &extra,
+                                  size_t max,
+                                  size_t max_bytes,
+                                  uint64_t cutoff) {
+    // no lock of the SDK is taken so that this also works from a crash
+    // handler that interrupted a thread holding one.
+    std::vector<RecordCopy> all;
+    for (const BreadcrumbRing *ring =
+             registry().newest.load(std::memory_order_acquire);
+         ring; ring = ring->next) {
+        ring->copy_into(all);
+    }
+    if (cutoff != BREADCRUMBS_COLLECTED) {
+        all.erase(std::remove_if(all.begin(), all.end(),
+                                 [cutoff](const RecordCopy &copy) {
+                                     return copy.seq >= cutoff;
+                                 }),
+                  all.end());
+    }
+
+    // the breadcrumbs of pushed scopes are merged in by their number
+    size_t extra_count = extra.length();
+    for (size_t i = 0; i < extra_count; i++) {
+        RecordCopy copy;
+        if (copy_extra(extra.get_by_index(i), ~0ULL - (extra_count - i),
+                       copy)) {
+            all.push_back(copy);
+        }
+    }
+
+    size_t keep = std::min(all.size(), max);
+    std::vector<RecordCopy>::iterator first = all.end() - keep;
+    std::nth_element(all.begin(), first, all.end());
+    std::sort(first, all.end());
+
+    // only the newest records that fit into the budget are kept
+    size_t bytes = 0;
+    std::vector<RecordCopy>::iterator fitting = all.end();
+    while (fitting != first &&
+           bytes + (fitting - 1)->bytes.size() <= max_bytes) {
+        --fitting;
+        bytes += fitting->bytes.size();
+    }
+    first = fitting;
+
+    Value rv = Value::new_list();
+    for (std::vector<RecordCopy>::iterator iter = first; iter != all.end();
+         ++iter) {
+        rv.append(materialize(iter->bytes));
+    }
+    return rv;
+}
+
+Value sentry::collect_breadcrumbs(const Value &extra, size_t max) {
+    return collect_breadcrumbs(extra, max, breadcrumbs_max_bytes());
+}
+
+void sentry::collect_scope_breadcrumbs(Scope &scope) {
+    if (scope.breadcrumbs_cutoff == BREADCRUMBS_COLLECTED) {
+        return;
+    }
+    scope.breadcrumbs =
+        collect_breadcrumbs(scope.breadcrumbs, SENTRY_BREADCRUMBS_MAX,
+                            breadcrumbs_max_bytes(), scope.breadcrumbs_cutoff);
+    scope.breadcrumbs_cutoff = BREADCRUMBS_COLLECTED;
+}
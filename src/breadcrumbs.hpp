@@ -0,0 +1,71 @@
+#ifndef SENTRY_BREADCRUMBS_HPP_INCLUDED
+#define SENTRY_BREADCRUMBS_HPP_INCLUDED
+
+#include "internal.hpp"
+#include "scope.hpp"
+#include "value.hpp"
+
+namespace sentry {
+
+// records a breadcrumb in the ring of the calling thread.
+//
+// Every thread has its own ring of the last `SENTRY_BREADCRUMBS_MAX`
+// breadcrumbs, within a byte budget that is set by the options.  Recording
+// one never waits for other threads.  Breadcrumbs
+// are numbered from a global sequence, which is what `collect_breadcrumbs`
+// orders them by.  The ring of a thread that exits is kept and handed to
+// the next new thread, so its breadcrumbs are still reported.
+//
+// Rings hold breadcrumbs as compact records rather than values: a fixed
+// header with the timestamp, the level and the type and category as
+// interned atoms, followed by the message and a msgpack blob with all other
+// keys.  They only become values again when an event is captured.  Records
+// larger than the per breadcrumb limit lose their blob and then have their
+// message truncated.
+void record_breadcrumb(const Value &breadcrumb);
+
+// records a breadcrumb without creating a value for it.  Apart from the
+// first use of a type or category this does not allocate.  `level` may be
+// `SCOPE_LEVEL_UNSET` to leave out the level.
+void record_breadcrumb(const char *type,
+                       const char *category,
+                       sentry_level_t level,
+                       const char *message);
+
+// turns a breadcrumb of a pushed scope into a record like the ones in the
+// rings, cut down to the per breadcrumb limit and numbered from the same
+// sequence.  The record is returned as a string value, which the scope
+// holds until `collect_breadcrumbs` merges it with the rings.
+Value layer_breadcrumb(const Value &breadcrumb);
+
+// returns the number the next recorded breadcrumb gets.  Passed on to
+// `collect_breadcrumbs` it leaves out the breadcrumbs recorded after this
+// call, which is how the breadcrumbs of an event are collected off the
+// calling thread.  Those that the rings drop in the meantime are lost.
+uint64_t breadcrumbs_cutoff();
+
+// returns the last `max` breadcrumbs of all threads, oldest first, as long
+// as their records take up no more than `max_bytes`.  The items of `extra`
+// are the breadcrumbs of pushed scopes.  Those made by `layer_breadcrumb`
+// are merged in by their number, any other values count as newer than all
+// recorded breadcrumbs.  Only breadcrumbs numbered below `cutoff` are taken
+// from the rings.
+//
+// This takes none of the locks of the SDK, not even to encode the items of
+// `extra`, so a crash handler that interrupted a thread holding one can
+// still call it.  It does allocate.
+Value collect_breadcrumbs(const Value &extra,
+                          size_t max,
+                          size_t max_bytes,
+                          uint64_t cutoff = BREADCRUMBS_COLLECTED);
+
+// collects breadcrumbs within the byte budget of the options.
+Value collect_breadcrumbs(const Value &extra, size_t max);
+
+// merges the breadcrumbs of the rings that were recorded before
+// `scope.breadcrumbs_cutoff` into the scope, unless that already happened.
+void collect_scope_breadcrumbs(Scope &scope);
+
+}  // namespace sentry
+
+#endif
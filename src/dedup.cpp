@@ -0,0 +1,187 @@
+#include <string.h>
+#include <iterator>
+
+#include "dedup.hpp"
+
+using namespace sentry;
+
+namespace {
+// 64 bit FNV-1a
+class SignatureHasher {
+   public:
+    SignatureHasher() : m_hash(14695981039346656037ULL), m_fed(false) {
+    }
+
+    void feed(const void *data, size_t len) {
+        const unsigned char *ptr = (const unsigned char *)data;
+        for (size_t i = 0; i < len; i++) {
+            m_hash ^= ptr[i];
+            m_hash *= 1099511628211ULL;
+        }
+        m_fed = true;
+    }
+
+    void feed_value(const Value &value) {
+        switch (value.type()) {
+            case SENTRY_VALUE_TYPE_STRING: {
+                const char *str = value.as_cstr();
+                feed(str, strlen(str) + 1);
+                break;
+            }
+            case SENTRY_VALUE_TYPE_INT32: {
+                int32_t val = value.as_int32();
+                feed(&val, sizeof(val));
+                break;
+            }
+            case SENTRY_VALUE_TYPE_DOUBLE: {
+                double val = value.as_double();
+                feed(&val, sizeof(val));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void feed_frames(const Value &stacktrace) {
+        Value frames = stacktrace.get_by_key("frames");
+        for (size_t i = 0; i < frames.length(); i++) {
+            feed_value(frames.get_by_index(i).get_by_key("instruction_addr"));
+        }
+    }
+
+    uint64_t finish() const {
+        // 0 is reserved for events without a signature
+        return !m_fed ? 0 : (m_hash ? m_hash : 1);
+    }
+
+   private:
+    uint64_t m_hash;
+    bool m_fed;
+};
+}  // namespace
+
+Deduplicator::Deduplicator(size_t capacity, std::chrono::milliseconds window)
+    : m_capacity(capacity ? capacity : 1), m_window(window) {
+}
+
+uint64_t Deduplicator::signature(const Value &event, const Value &fingerprint) {
+    SignatureHasher hasher;
+
+    Value exceptions = event.navigate("exception.values");
+    for (size_t i = 0; i < exceptions.length(); i++) {
+        Value exception = exceptions.get_by_index(i);
+        hasher.feed_value(exception.get_by_key("type"));
+        hasher.feed_frames(exception.get_by_key("stacktrace"));
+    }
+
+    Value event_fingerprint = event.get_by_key("fingerprint");
+    if (event_fingerprint.length() == 0) {
+        event_fingerprint = fingerprint;
+    }
+    for (size_t i = 0; i < event_fingerprint.length(); i++) {
+        hasher.feed_value(event_fingerprint.get_by_index(i));
+    }
+
+    Value message = event.get_by_key("message");
+    if (message.type() == SENTRY_VALUE_TYPE_OBJECT) {
+        message = message.get_by_key("formatted");
+    }
+    hasher.feed_value(message);
+
+    hasher.feed_frames(event.get_by_key("stacktrace"));
+    Value threads = event.get_by_key("threads");
+    for (size_t i = 0; i < threads.length(); i++) {
+        hasher.feed_frames(threads.get_by_index(i).get_by_key("stacktrace"));
+    }
+
+    return hasher.finish();
+}
+
+bool Deduplicator::check(const Value &event,
+                         const Value &fingerprint,
+                         Clock::time_point now,
+                         uint64_t *signature_out) {
+    uint64_t sig = signature(event, fingerprint);
+    if (signature_out) {
+        *signature_out = sig;
+    }
+    if (!sig) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> _blck(m_lock);
+    auto found = m_index.find(sig);
+    if (found != m_index.end()) {
+        std::list<Entry>::iterator iter = found->second;
+        if (now < iter->first_seen + m_window) {
+            iter->suppressed++;
+            m_entries.splice(m_entries.begin(), m_entries, iter);
+            return false;
+        }
+        retire_locked(iter);
+    }
+
+    while (m_entries.size() >= m_capacity) {
+        retire_locked(std::prev(m_entries.end()));
+    }
+
+    Entry entry;
+    entry.signature = sig;
+    entry.first_seen = now;
+    entry.suppressed = 0;
+    // the event is mutated further once it is captured
+    entry.event = event.clone();
+    m_entries.push_front(entry);
+    m_index[sig] = m_entries.begin();
+    return true;
+}
+
+void Deduplicator::attach_scope(uint64_t signature,
+                                std::shared_ptr<const Scope> scope) {
+    std::lock_guard<std::mutex> _blck(m_lock);
+    auto found = m_index.find(signature);
+    if (found != m_index.end()) {
+        found->second->scope = scope;
+    }
+}
+
+std::vector<Deduplicator::Aggregate> Deduplicator::take_aggregates(
+    Clock::time_point now, bool all) {
+    std::lock_guard<std::mutex> _blck(m_lock);
+    for (auto iter = m_entries.begin(); iter != m_entries.end();) {
+        auto next = std::next(iter);
+        if (all || now >= iter->first_seen + m_window) {
+            retire_locked(iter);
+        }
+        iter = next;
+    }
+    std::vector<Aggregate> rv;
+    rv.swap(m_aggregates);
+    return rv;
+}
+
+size_t Deduplicator::size() const {
+    std::lock_guard<std::mutex> _blck(m_lock);
+    return m_entries.size();
+}
+
+void Deduplicator::retire_locked(std::list<Entry>::iterator iter) {
+    if (iter->suppressed > 0) {
+        Value event = iter->event;
+        event.remove_by_key("event_id");
+        Value extra = event.get_by_key("extra");
+        if (extra.type() != SENTRY_VALUE_TYPE_OBJECT) {
+            extra = Value::new_object();
+            event.set_by_key("extra", extra);
+        }
+        extra.set_by_key("duplicate_count",
+                         Value::new_double((double)iter->suppressed));
+        Aggregate aggregate;
+        aggregate.event = event;
+        aggregate.scope = iter->scope;
+        m_aggregates.push_back(aggregate);
+    }
+    m_index.erase(iter->signature);
+    m_entries.erase(iter);
+}
@@ -0,0 +1,92 @@
+#ifndef SENTRY_DEDUP_HPP_INCLUDED
+#define SENTRY_DEDUP_HPP_INCLUDED
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "internal.hpp"
+#include "scope.hpp"
+#include "value.hpp"
+
+namespace sentry {
+
+// suppresses repeated events that share the same signature.
+//
+// The first occurrence of an event is let through and starts a window.
+// Repeats within that window are counted and dropped.  Once the window has
+// passed, or the entry is evicted from the bounded LRU, a single aggregated
+// copy of the first event is handed out that carries the number of
+// suppressed duplicates in `extra.duplicate_count`.
+class Deduplicator {
+   public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Aggregate {
+        Value event;
+        // the scope the first event was captured with, if one was attached.
+        std::shared_ptr<const Scope> scope;
+    };
+
+    Deduplicator(size_t capacity, std::chrono::milliseconds window);
+
+    // computes the signature of an event from its exception types,
+    // fingerprint, message and the instruction addresses of its stack
+    // traces.  Returns 0 if the event has nothing to go by.  The
+    // fingerprint of the scope is used if the event does not have one.
+    static uint64_t signature(const Value &event, const Value &fingerprint);
+
+    // returns `false` if the event is a duplicate and should be dropped.
+    // Otherwise `signature_out` receives the signature of its entry, which
+    // is 0 if none was opened.
+    bool check(const Value &event,
+               const Value &fingerprint,
+               uint64_t *signature_out = nullptr) {
+        return check(event, fingerprint, Clock::now(), signature_out);
+    }
+    bool check(const Value &event,
+               const Value &fingerprint,
+               Clock::time_point now,
+               uint64_t *signature_out = nullptr);
+
+    // attaches the scope the first event of an entry was captured with, so
+    // that its aggregate does not pick up whatever is current once it is
+    // flushed.
+    void attach_scope(uint64_t signature, std::shared_ptr<const Scope> scope);
+
+    // returns the aggregated events of all entries whose window has passed.
+    // If `all` is set every pending aggregate is returned regardless.
+    std::vector<Aggregate> take_aggregates(bool all = false) {
+        return take_aggregates(Clock::now(), all);
+    }
+    std::vector<Aggregate> take_aggregates(Clock::time_point now,
+                                           bool all = false);
+
+    size_t size() const;
+
+   private:
+    struct Entry {
+        uint64_t signature;
+        Clock::time_point first_seen;
+        uint64_t suppressed;
+        Value event;
+        std::shared_ptr<const Scope> scope;
+    };
+
+    void retire_locked(std::list<Entry>::iterator iter);
+
+    size_t m_capacity;
+    std::chrono::milliseconds m_window;
+    mutable std::mutex m_lock;
+    // most recently seen entries are at the front
+    std::list<Entry> m_entries;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> m_index;
+    std::vector<Aggregate> m_aggregates;
+};
+
+}  // namespace sentry
+
+#endif
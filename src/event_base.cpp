@@ -0,0 +1,56 @@
+#include "options.hpp"
+
+#include "event_base.hpp"
+
+using namespace sentry;
+
+static Value frozen_string(const std::string &s) {
+    if (s.empty()) {
+        return Value();
+    }
+    Value rv = Value::new_string(s.c_str());
+    rv.freeze_json();
+    return rv;
+}
+
+static Value sdk_info() {
+    Value sdk_info = Value::new_object();
+    Value version = Value::new_string(SENTRY_SDK_VERSION);
+    sdk_info.set_by_key("name", Value::new_string(SENTRY_SDK_NAME));
+    sdk_info.set_by_key("version", version);
+    Value package = Value::new_object();
+    package.set_by_key("name",
+                       Value::new_string("github:getsentry/sentry-native"));
+    package.set_by_key("version", version);
+    Value packages = Value::new_list();
+    packages.append(package);
+    sdk_info.set_by_key("packages", packages);
+    sdk_info.freeze_json();
+    return sdk_info;
+}
+
+EventBase EventBase::from_options(const sentry_options_t *options) {
+    EventBase rv;
+    rv.platform = frozen_string("native");
+    rv.release = frozen_string(options->release);
+    rv.dist = frozen_string(options->dist);
+    rv.environment = frozen_string(options->environment);
+    rv.sdk = sdk_info();
+    return rv;
+}
+
+void EventBase::apply_to_event(Value &event) const {
+    if (event.get_by_key("platform").is_null()) {
+        event.set_by_key("platform", platform);
+    }
+    if (!release.is_null()) {
+        event.set_by_key("release", release);
+    }
+    if (!dist.is_null()) {
+        event.set_by_key("dist", dist);
+    }
+    if (!environment.is_null()) {
+        event.set_by_key("environment", environment);
+    }
+    event.set_by_key("sdk", sdk);
+}
@@ -0,0 +1,28 @@
+#ifndef SENTRY_EVENT_BASE_HPP_INCLUDED
+#define SENTRY_EVENT_BASE_HPP_INCLUDED
+
+#include "internal.hpp"
+#include "value.hpp"
+
+namespace sentry {
+
+// the fields of every event that only depend on the options and the SDK.
+//
+// They are built once when the options change and frozen with their json,
+// so applying them to an event takes one reference per field and
+// serializing them writes the cached json.
+struct EventBase {
+    Value platform;
+    Value release;
+    Value dist;
+    Value environment;
+    Value sdk;
+
+    static EventBase from_options(const sentry_options_t *options);
+
+    void apply_to_event(Value &event) const;
+};
+
+}  // namespace sentry
+
+#endif
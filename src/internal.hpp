@@ -46,11 +46,37 @@
 #endif
 
 #define SENTRY_BREADCRUMBS_MAX 100
+#define SENTRY_BREADCRUMBS_BYTES_MAX (32 * 1024)
+#define SENTRY_BREADCRUMBS_BYTES_MIN 1024
+#define SENTRY_BREADCRUMB_SIZE_MAX (8 * 1024)
+#define SENTRY_BREADCRUMB_ATOMS_MAX 256
+#define SENTRY_SCOPE_FLUSH_INTERVAL_MS 100
+#define SENTRY_BLACKBOX_SCOPE_SIZE (64 * 1024)
+#define SENTRY_BLACKBOX_BREADCRUMBS_SIZE (64 * 1024)
+#define SENTRY_PIPELINE_QUEUE_MAX 256
+#define SENTRY_DEDUP_ENTRIES_MAX 128
+#define SENTRY_OUTBOX_SEGMENT_SIZE (1024 * 1024)
+#define SENTRY_OUTBOX_SEGMENTS_MAX 64
+#define SENTRY_OUTBOX_ATTEMPTS_MAX 5
+#define SENTRY_BATCH_BYTES_MAX (1024 * 1024)
+#define SENTRY_BATCH_REQUESTS_MAX 32
+#define SENTRY_URGENT_SEND_TIMEOUT_MS 5000
+#define SENTRY_RELAY_WRITE_TIMEOUT_MS 1000
+#define SENTRY_RELAY_RECONNECT_MIN_MS 100
+#define SENTRY_RELAY_RECONNECT_MAX_MS 30000
+#define SENTRY_SHM_RING_SIZE (4 * 1024 * 1024)
+#define SENTRY_SHM_RING_STALL_MS 5000
+#define SENTRY_FILE_SINK_FILE_SIZE (64 * 1024 * 1024)
+#define SENTRY_FILE_SINK_FILE_AGE_MS (60 * 60 * 1000)
+#define SENTRY_FILE_SINK_QUEUE_MAX 65536
 static const char *SENTRY_RUNS_FOLDER = "sentry-runs";
 static const char *SENTRY_PENDING_FOLDER = "sentry-pending";
+static const char *SENTRY_RELAY_SPILL_FOLDER = "sentry-relay-spill";
 static const char *SENTRY_EVENT_FILE = "__sentry-event";
+static const char *SENTRY_EVENT_TEMP_FILE = "__sentry-event.tmp";
 static const char *SENTRY_BREADCRUMBS1_FILE = "__sentry-breadcrumb1";
 static const char *SENTRY_BREADCRUMBS2_FILE = "__sentry-breadcrumb2";
+static const char *SENTRY_BLACKBOX_FILE = "__sentry-blackbox";
 
 #include "value.hpp"
 
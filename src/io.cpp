@@ -4,8 +4,17 @@
 #include "io.hpp"
 #include "path.hpp"
 
-#ifndef _WIN32
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <sys/file.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #endif
 
@@ -63,6 +72,14 @@ bool FileIoWriter::open(const Path &path, const char *mode) {
 #endif
 }
 
+bool FileIoWriter::is_closed() const {
+#ifdef _WIN32
+    return m_file == nullptr;
+#else
+    return m_fd < 0;
+#endif
+}
+
 void FileIoWriter::write(const char *buf, size_t len) {
     size_t to_write = len;
     while (to_write) {
@@ -77,6 +94,67 @@ void FileIoWriter::write(const char *buf, size_t len) {
     }
 }
 
+bool FileIoWriter::write_slices(const IoSlice *slices, size_t count) {
+    flush();
+#ifdef _WIN32
+    for (size_t i = 0; i < count; i++) {
+        if (fwrite(slices[i].buf, 1, slices[i].len, m_file) != slices[i].len) {
+            return false;
+        }
+    }
+    return fflush(m_file) == 0;
+#else
+#ifdef IOV_MAX
+    const size_t max_iov = IOV_MAX;
+#else
+    const size_t max_iov = 1024;
+#endif
+    struct iovec iov[64];
+    size_t slice = 0;
+    size_t slice_offset = 0;
+    while (slice < count) {
+        size_t iovcnt = 0;
+        for (size_t i = slice; i < count && iovcnt < 64 && iovcnt < max_iov;
+             i++) {
+            size_t offset = i == slice ? slice_offset : 0;
+            iov[iovcnt].iov_base = (void *)(slices[i].buf + offset);
+            iov[iovcnt].iov_len = slices[i].len - offset;
+            iovcnt++;
+        }
+
+        ssize_t written = ::writev(m_fd, iov, (int)iovcnt);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        // advance past everything that was written, short writes resume in
+        // the middle of a slice.
+        size_t left = (size_t)written;
+        while (slice < count && left >= slices[slice].len - slice_offset) {
+            left -= slices[slice].len - slice_offset;
+            slice++;
+            slice_offset = 0;
+        }
+        slice_offset += left;
+    }
+    return true;
+#endif
+}
+
+bool FileIoWriter::sync() {
+    flush();
+#ifdef _WIN32
+    return _commit(_fileno(m_file)) == 0;
+#elif defined(__APPLE__)
+    return fcntl(m_fd, F_FULLFSYNC) == 0 || fsync(m_fd) == 0;
+#else
+    return fdatasync(m_fd) == 0;
+#endif
+}
+
 void FileIoWriter::flush() {
 #ifdef _WIN32
     fwrite(m_buf, 1, m_buflen, m_file);
@@ -88,11 +166,16 @@ void FileIoWriter::flush() {
 }
 
 void FileIoWriter::close() {
+    if (is_closed()) {
+        return;
+    }
     flush();
 #ifdef _WIN32
     fclose(m_file);
+    m_file = nullptr;
 #else
     ::close(m_fd);
+    m_fd = -1;
 #endif
     m_buflen = 0;
 }
@@ -146,3 +229,47 @@ const char *MemoryIoWriter::buf() const {
 size_t MemoryIoWriter::len() const {
     return m_buflen;
 }
+
+FileLock::FileLock() : m_fd(-1) {
+}
+
+FileLock::~FileLock() {
+    unlock();
+}
+
+bool FileLock::try_lock(const Path &path) {
+    unlock();
+#ifdef _WIN32
+    // nobody else can open the file while it is open without sharing
+    int fd = -1;
+    if (_wsopen_s(&fd, path.as_osstr(), _O_RDWR | _O_CREAT, _SH_DENYRW,
+                  _S_IREAD | _S_IWRITE) != 0) {
+        return false;
+    }
+#else
+    // unlike fcntl locks, flock locks also exclude each other within a
+    // process.
+    int fd = ::open(path.as_osstr(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        ::close(fd);
+        return false;
+    }
+#endif
+    m_fd = fd;
+    return true;
+}
+
+void FileLock::unlock() {
+    if (m_fd < 0) {
+        return;
+    }
+#ifdef _WIN32
+    _close(m_fd);
+#else
+    ::close(m_fd);
+#endif
+    m_fd = -1;
+}
@@ -5,6 +5,12 @@ namespace sentry {
 
 class Path;
 
+// a buffer that is written as part of a gathered write.
+struct IoSlice {
+    const char *buf;
+    size_t len;
+};
+
 class IoWriter {
    public:
     IoWriter();
@@ -42,7 +48,12 @@ class FileIoWriter : public IoWriter {
     bool open(const Path &path, const char *mode = "wb");
     bool is_closed() const;
     void write(const char *buf, size_t len);
+    // writes all slices with as few system calls as possible.  Returns
+    // `false` if not everything could be written.
+    bool write_slices(const IoSlice *slices, size_t count);
     void flush();
+    // flushes and waits until the data reached the disk.
+    bool sync();
     void close();
 
    private:
@@ -56,6 +67,26 @@ class FileIoWriter : public IoWriter {
     size_t m_buflen;
 };
 
+// an exclusive lock on a file that other processes and other locks in the
+// same process cannot take while it is held.  It goes away with the process.
+class FileLock {
+   public:
+    FileLock();
+    ~FileLock();
+    // creates the file if needed.  Returns `false` if it is locked already.
+    bool try_lock(const Path &path);
+    void unlock();
+    bool is_locked() const {
+        return m_fd >= 0;
+    }
+
+   private:
+    FileLock(const FileLock &) = delete;
+    FileLock &operator=(const FileLock &) = delete;
+
+    int m_fd;
+};
+
 class MemoryIoWriter : public IoWriter {
    public:
     MemoryIoWriter(size_t bufsize = 128);
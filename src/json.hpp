@@ -85,6 +85,19 @@ class JsonWriter {
         m_depth -= 1;
     }
 
+    // returns whether an item that is nested `depth` levels deep can be
+    // written without hitting the depth limit.
+    bool fits_depth(uint32_t depth) const {
+        return m_depth + depth <= 64;
+    }
+
+    // writes an item that is already serialized.
+    void write_raw(const std::string &json) {
+        if (can_write_item()) {
+            m_writer.write_str(json);
+        }
+    }
+
    private:
     void do_write_string(const char *ptr) {
         m_writer.write_char('"');
@@ -112,9 +125,9 @@ class JsonWriter {
                     m_writer.write_str("\\t");
                     break;
                 default:
-                    if (*ptr < 32) {
+                    if ((unsigned char)*ptr < 32) {
                         char buf[10];
-                        sprintf(buf, "u%04x", *ptr);
+                        sprintf(buf, "\\u%04x", *ptr);
                         m_writer.write_str(buf);
                     } else {
                         m_writer.write_char(*ptr);
@@ -11,7 +11,10 @@
 #include "backends/breakpad_backend.hpp"
 #endif
 #include "transports/base_transport.hpp"
+#include "transports/file_sink_transport.hpp"
 #include "transports/function_transport.hpp"
+#include "transports/shared_ring_transport.hpp"
+#include "transports/unix_socket_transport.hpp"
 
 #include "options.hpp"
 
@@ -25,22 +28,35 @@ static const char *empty_str_null(const char *s) {
 }
 
 sentry_options_s::sentry_options_s()
-    : debug(false),
-      database_path("./.sentry-native"),
-      dsn(getenv_or_empty("SENTRY_DSN")),
-      environment(getenv_or_empty("SENTRY_ENVIRONMENT")),
+    : dsn(getenv_or_empty("SENTRY_DSN")),
       release(getenv_or_empty("SENTRY_RELEASE")),
+      environment(getenv_or_empty("SENTRY_ENVIRONMENT")),
+      debug(false),
+      background_capture(false),
+      sample_rate(1.0),
+      dedup_window(0),
+      batch_linger(0),
+      batch_max_bytes(0),
+      scope_flush_interval(SENTRY_SCOPE_FLUSH_INTERVAL_MS),
+      breadcrumbs_max_bytes(SENTRY_BREADCRUMBS_BYTES_MAX),
+      breadcrumb_max_size(SENTRY_BREADCRUMB_SIZE_MAX),
+      max_attachment_size(0),
+      database_path("./.sentry-native"),
+      before_send([](sentry::Value event, void *hint) { return event; }),
+      stats_callback(nullptr),
+      stats_callback_data(nullptr),
+      stats_interval(0),
       transport(sentry::transports::create_default_transport()),
 #ifdef SENTRY_WITH_INPROC_BACKEND
-      backend(new sentry::backends::InprocBackend()),
+      backend(new sentry::backends::InprocBackend())
 #elif defined(SENTRY_WITH_CRASHPAD_BACKEND)
-      backend(new sentry::backends::CrashpadBackend()),
+      backend(new sentry::backends::CrashpadBackend())
 #elif defined(SENTRY_WITH_BREAKPAD_BACKEND)
-      backend(new sentry::backends::BreakpadBackend()),
+      backend(new sentry::backends::BreakpadBackend())
 #else
-      backend(nullptr),
+      backend(nullptr)
 #endif
-      before_send([](sentry::Value event, void *hint) { return event; }) {
+{
     std::random_device seed;
     std::default_random_engine engine(seed());
     std::uniform_int_distribution<int> uniform_dist(0, INT32_MAX);
@@ -48,6 +64,7 @@ sentry_options_s::sentry_options_s()
     std::stringstream ss;
     ss << result << "-" << uniform_dist(engine);
     run_id = ss.str();
+    event_base = sentry::EventBase::from_options(this);
 }
 
 sentry_options_t *sentry_options_new(void) {
@@ -64,6 +81,55 @@ void sentry_options_set_transport(sentry_options_t *opts,
         });
 }
 
+void sentry_options_set_relay_socket(sentry_options_t *opts,
+                                     const char *path) {
+#ifdef _WIN32
+    SENTRY_LOG("relay sockets are not supported on windows");
+#else
+    if (!path) {
+        return;
+    }
+    delete opts->transport;
+    opts->transport = new sentry::transports::UnixSocketTransport(path);
+#endif
+}
+
+void sentry_options_set_shared_ring(sentry_options_t *opts,
+                                    const char *name,
+                                    size_t capacity) {
+#if defined(_WIN32) || defined(__ANDROID__)
+    SENTRY_LOG("shared memory rings are not supported on this platform");
+#else
+    if (!name) {
+        return;
+    }
+    delete opts->transport;
+    opts->transport = new sentry::transports::SharedRingTransport(
+        name, capacity ? capacity : SENTRY_SHM_RING_SIZE);
+#endif
+}
+
+void sentry_options_set_file_sink(sentry_options_t *opts,
+                                  const char *directory,
+                                  size_t max_file_size,
+                                  uint64_t max_file_age_ms,
+                                  sentry_file_sink_sync_t sync) {
+    if (!directory) {
+        return;
+    }
+    sentry::transports::FileSinkPolicy policy;
+    if (max_file_size) {
+        policy.max_file_size = max_file_size;
+    }
+    if (max_file_age_ms) {
+        policy.max_file_age = std::chrono::milliseconds(max_file_age_ms);
+    }
+    policy.sync = sync;
+    delete opts->transport;
+    opts->transport =
+        new sentry::transports::FileSinkTransport(directory, policy);
+}
+
 void sentry_options_set_before_send(sentry_options_t *opts,
                                     sentry_event_function_t func,
                                     void *closure) {
@@ -72,6 +138,26 @@ void sentry_options_set_before_send(sentry_options_t *opts,
     };
 }
 
+void sentry_options_add_event_processor(sentry_options_t *opts,
+                                        sentry_event_phase_t phase,
+                                        sentry_event_function_t func,
+                                        void *closure) {
+    sentry::EventProcessor processor;
+    processor.phase = phase;
+    processor.func = func;
+    processor.closure = closure;
+    opts->event_processors.push_back(processor);
+}
+
+void sentry_options_set_before_breadcrumb(sentry_options_t *opts,
+                                          sentry_breadcrumb_function_t func,
+                                          void *closure) {
+    opts->before_breadcrumb = [func, closure](sentry::Value breadcrumb,
+                                              void *hint) {
+        return sentry::Value::consume(func(breadcrumb.lower(), hint, closure));
+    };
+}
+
 void sentry_options_free(sentry_options_t *opts) {
     if (opts) {
         delete opts;
@@ -88,6 +174,7 @@ const char *sentry_options_get_dsn(const sentry_options_t *opts) {
 
 void sentry_options_set_release(sentry_options_t *opts, const char *release) {
     opts->release = release;
+    opts->event_base = sentry::EventBase::from_options(opts);
 }
 
 const char *sentry_options_get_release(const sentry_options_t *opts) {
@@ -97,6 +184,7 @@ const char *sentry_options_get_release(const sentry_options_t *opts) {
 void sentry_options_set_environment(sentry_options_t *opts,
                                     const char *environment) {
     opts->environment = environment;
+    opts->event_base = sentry::EventBase::from_options(opts);
 }
 
 const char *sentry_options_get_environment(const sentry_options_t *opts) {
@@ -105,6 +193,7 @@ const char *sentry_options_get_environment(const sentry_options_t *opts) {
 
 void sentry_options_set_dist(sentry_options_t *opts, const char *dist) {
     opts->dist = dist;
+    opts->event_base = sentry::EventBase::from_options(opts);
 }
 
 const char *sentry_options_get_dist(const sentry_options_t *opts) {
@@ -135,12 +224,83 @@ int sentry_options_get_debug(const sentry_options_t *opts) {
     return opts->debug;
 }
 
+void sentry_options_set_background_capture(sentry_options_t *opts,
+                                           int enabled) {
+    opts->background_capture = !!enabled;
+}
+
+int sentry_options_get_background_capture(const sentry_options_t *opts) {
+    return opts->background_capture;
+}
+
+void sentry_options_set_sample_rate(sentry_options_t *opts,
+                                    double sample_rate) {
+    if (sample_rate < 0.0) {
+        sample_rate = 0.0;
+    } else if (sample_rate > 1.0 || sample_rate != sample_rate) {
+        sample_rate = 1.0;
+    }
+    opts->sample_rate = sample_rate;
+}
+
+double sentry_options_get_sample_rate(const sentry_options_t *opts) {
+    return opts->sample_rate;
+}
+
+void sentry_options_set_dedup_window(sentry_options_t *opts,
+                                     uint64_t window_ms) {
+    opts->dedup_window = window_ms;
+}
+
+uint64_t sentry_options_get_dedup_window(const sentry_options_t *opts) {
+    return opts->dedup_window;
+}
+
+void sentry_options_set_batching(sentry_options_t *opts,
+                                 uint64_t linger_ms,
+                                 size_t max_bytes) {
+    opts->batch_linger = linger_ms;
+    opts->batch_max_bytes = max_bytes;
+}
+
+void sentry_options_set_scope_flush_interval(sentry_options_t *opts,
+                                             uint64_t interval_ms) {
+    opts->scope_flush_interval = interval_ms;
+}
+
+void sentry_options_set_breadcrumb_budget(sentry_options_t *opts,
+                                          size_t max_bytes,
+                                          size_t max_breadcrumb_size) {
+    opts->breadcrumbs_max_bytes =
+        max_bytes ? max_bytes : SENTRY_BREADCRUMBS_BYTES_MAX;
+    opts->breadcrumb_max_size =
+        max_breadcrumb_size ? max_breadcrumb_size : SENTRY_BREADCRUMB_SIZE_MAX;
+}
+
+void sentry_options_set_stats_callback(sentry_options_t *opts,
+                                       sentry_stats_function_t func,
+                                       uint64_t interval_ms,
+                                       void *data) {
+    opts->stats_callback = func;
+    opts->stats_interval = interval_ms;
+    opts->stats_callback_data = data;
+}
+
 void sentry_options_add_attachment(sentry_options_t *opts,
                                    const char *name,
                                    const char *path) {
     opts->attachments.emplace_back(sentry::Attachment(name, path));
 }
 
+void sentry_options_set_max_attachment_size(sentry_options_t *opts,
+                                            size_t max_size) {
+    opts->max_attachment_size = max_size;
+}
+
+size_t sentry_options_get_max_attachment_size(const sentry_options_t *opts) {
+    return opts->max_attachment_size;
+}
+
 void sentry_options_set_handler_path(sentry_options_t *opts, const char *path) {
     opts->handler_path = path;
 }
@@ -8,8 +8,10 @@
 #include "attachment.hpp"
 #include "backends/base_backend.hpp"
 #include "dsn.hpp"
+#include "event_base.hpp"
 #include "internal.hpp"
 #include "path.hpp"
+#include "processors.hpp"
 #include "transports/base_transport.hpp"
 
 struct sentry_options_s {
@@ -22,15 +24,30 @@ struct sentry_options_s {
     std::string http_proxy;
     std::string ca_certs;
     bool debug;
+    bool background_capture;
+    double sample_rate;
+    uint64_t dedup_window;
+    uint64_t batch_linger;
+    size_t batch_max_bytes;
+    uint64_t scope_flush_interval;
+    size_t breadcrumbs_max_bytes;
+    size_t breadcrumb_max_size;
     std::vector<sentry::Attachment> attachments;
+    size_t max_attachment_size;
     sentry::Path handler_path;
     sentry::Path database_path;
 
     std::function<sentry::Value(sentry::Value, void *hint)> before_send;
+    std::function<sentry::Value(sentry::Value, void *hint)> before_breadcrumb;
+    std::vector<sentry::EventProcessor> event_processors;
+    sentry_stats_function_t stats_callback;
+    void *stats_callback_data;
+    uint64_t stats_interval;
     sentry::transports::Transport *transport;
     sentry::backends::Backend *backend;
 
     // internal options
+    sentry::EventBase event_base;
     std::string run_id;
     sentry::Path runs_folder;
 };
@@ -0,0 +1,526 @@
+#include <algorithm>
+#include <cstring>
+
+#include "outbox.hpp"
+
+using namespace sentry;
+
+static const uint32_t RECORD_MAGIC = 0x584f4253;
+static const uint32_t RECORD_TYPE_DATA = 1;
+static const uint32_t RECORD_TYPE_ACK = 2;
+static const char *SPARE_SEGMENT_NAME = "recycled";
+
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t type;
+    uint64_t segment;
+    uint64_t seq;
+    uint64_t len;
+    uint32_t crc;
+    uint32_t tag;
+};
+
+namespace {
+struct Crc32Table {
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int j = 0; j < 8; j++) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+            }
+            values[i] = crc;
+        }
+    }
+
+    uint32_t values[256];
+};
+}  // namespace
+
+static uint32_t crc32_update(uint32_t crc, const void *buf, size_t len) {
+    static const Crc32Table table;
+    const unsigned char *ptr = (const unsigned char *)buf;
+    for (size_t i = 0; i < len; i++) {
+        crc = table.values[(crc ^ ptr[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+// the checksum covers the payload as well as the header so that stale
+// records in recycled segments are never mistaken for new ones.
+static uint32_t record_crc(uint32_t payload_crc, RecordHeader header) {
+    header.crc = 0;
+    return ~crc32_update(payload_crc, &header, sizeof(header));
+}
+
+static bool read_segment_id(const Path &path, uint64_t *id_out) {
+    FILE *f = path.open("rb");
+    if (!f) {
+        return false;
+    }
+    RecordHeader header;
+    bool rv = fread(&header, sizeof(header), 1, f) == 1 &&
+              header.magic == RECORD_MAGIC;
+    fclose(f);
+    if (rv) {
+        *id_out = header.segment;
+    }
+    return rv;
+}
+
+Outbox::Outbox()
+    : m_segment_size(SENTRY_OUTBOX_SEGMENT_SIZE),
+      m_max_segments(SENTRY_OUTBOX_SEGMENTS_MAX),
+      m_file(nullptr),
+      m_has_spare(false),
+      m_next_seq(0),
+      m_next_segment_id(0),
+      m_dropped(0) {
+}
+
+Outbox::~Outbox() {
+    close();
+}
+
+bool Outbox::open(const Path &directory,
+                  size_t segment_size,
+                  size_t max_segments) {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    close_locked();
+    if (!directory.create_directories()) {
+        return false;
+    }
+
+    m_directory = directory;
+    m_segment_size = segment_size;
+    m_max_segments = std::max(max_segments, (size_t)2);
+
+    std::vector<Segment> found;
+    PathIterator iter = directory.iter_directory();
+    while (iter.next()) {
+        const Path &path = *iter.path();
+        if (path.filename_matches(SPARE_SEGMENT_NAME)) {
+            m_has_spare = true;
+            continue;
+        }
+        Segment segment;
+        segment.path = path;
+        segment.size = 0;
+        segment.live = 0;
+        if (read_segment_id(path, &segment.id)) {
+            found.push_back(segment);
+        } else {
+            // segments that never got their first record written
+            path.remove();
+        }
+    }
+
+    std::sort(found.begin(), found.end(),
+              [](const Segment &a, const Segment &b) { return a.id < b.id; });
+    for (Segment &segment : found) {
+        m_segments.push_back(segment);
+        replay_segment(m_segments.back());
+        m_next_segment_id = segment.id + 1;
+    }
+    collect_segments_locked();
+
+    if (m_segments.empty()) {
+        return open_segment_locked();
+    }
+
+    Segment &active = m_segments.back();
+    m_file = active.path.open("r+b");
+    if (!m_file || fseek(m_file, (long)active.size, SEEK_SET) != 0) {
+        close_locked();
+        return false;
+    }
+
+    SENTRY_LOGF("opened outbox with %llu pending records",
+                (unsigned long long)m_records.size());
+    return true;
+}
+
+void Outbox::close() {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    close_locked();
+}
+
+void Outbox::close_locked() {
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+    for (auto &doomed : m_doomed) {
+        doomed.second.remove();
+    }
+    m_doomed.clear();
+    m_readers.clear();
+    m_segments.clear();
+    m_records.clear();
+    m_ready.clear();
+    m_has_spare = false;
+    m_next_seq = 0;
+    m_next_segment_id = 0;
+}
+
+bool Outbox::is_open() const {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    return m_file != nullptr;
+}
+
+void Outbox::replay_segment(Segment &segment) {
+    FILE *f = segment.path.open("rb");
+    size_t file_size = 0;
+    if (!f) {
+        return;
+    }
+    segment.path.get_size(&file_size);
+
+    RecordHeader header;
+    char buf[4096];
+    size_t offset = 0;
+    while (fread(&header, sizeof(header), 1, f) == 1) {
+        size_t payload_offset = offset + sizeof(header);
+        if (header.magic != RECORD_MAGIC || header.segment != segment.id ||
+            header.len > file_size - payload_offset) {
+            break;
+        }
+
+        uint32_t crc = 0xffffffff;
+        size_t remaining = (size_t)header.len;
+        while (remaining > 0) {
+            size_t len =
+                fread(buf, 1, std::min(remaining, sizeof(buf)), f);
+            if (len == 0) {
+                break;
+            }
+            crc = crc32_update(crc, buf, len);
+            remaining -= len;
+        }
+        if (remaining > 0 || record_crc(crc, header) != header.crc) {
+            SENTRY_LOG("discarding torn outbox record");
+            break;
+        }
+
+        m_next_seq = std::max(m_next_seq, header.seq + 1);
+        if (header.type == RECORD_TYPE_DATA) {
+            OutboxRecord record;
+            record.seq = header.seq;
+            record.segment = segment.id;
+            record.path = segment.path;
+            record.offset = payload_offset;
+            record.len = (size_t)header.len;
+            record.tag = header.tag;
+            m_records[header.seq] = record;
+            m_ready.insert(header.seq);
+            segment.live++;
+        } else if (header.type == RECORD_TYPE_ACK) {
+            forget_record_locked(header.seq);
+        }
+        offset = payload_offset + (size_t)header.len;
+    }
+
+    // anything after the last valid record is overwritten by new records
+    segment.size = offset;
+    fclose(f);
+}
+
+bool Outbox::append(transports::RequestBody &body,
+                    uint64_t *seq_out,
+                    uint32_t tag) {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    uint64_t seq = m_next_seq;
+    if (!write_record_locked(RECORD_TYPE_DATA, seq, &body, tag)) {
+        return false;
+    }
+    m_next_seq++;
+    if (seq_out) {
+        *seq_out = seq;
+    }
+    return true;
+}
+
+bool Outbox::append(const char *buf,
+                    size_t len,
+                    uint64_t *seq_out,
+                    uint32_t tag) {
+    transports::RequestBody body;
+    body.append_ref(buf, len);
+    return append(body, seq_out, tag);
+}
+
+bool Outbox::front(OutboxRecord *record_out) const {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    if (m_records.empty()) {
+        return false;
+    }
+    *record_out = m_records.begin()->second;
+    return true;
+}
+
+bool Outbox::next(uint64_t seq, OutboxRecord *record_out) const {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    auto iter = m_records.lower_bound(seq);
+    if (iter == m_records.end()) {
+        return false;
+    }
+    *record_out = iter->second;
+    return true;
+}
+
+bool Outbox::get(uint64_t seq, OutboxRecord *record_out) const {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    auto iter = m_records.find(seq);
+    if (iter == m_records.end()) {
+        return false;
+    }
+    *record_out = iter->second;
+    return true;
+}
+
+bool Outbox::ack(uint64_t seq) {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    if (m_records.find(seq) == m_records.end()) {
+        return false;
+    }
+
+    // if the tombstone cannot be written the record is delivered again
+    // after a restart, which is preferable to losing it.
+    write_record_locked(RECORD_TYPE_ACK, seq, nullptr);
+    forget_record_locked(seq);
+    collect_segments_locked();
+    return true;
+}
+
+void Outbox::ready(std::vector<OutboxRecord> *records_out) const {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    for (uint64_t seq : m_ready) {
+        records_out->push_back(m_records.find(seq)->second);
+    }
+}
+
+void Outbox::hold(uint64_t seq) {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    m_ready.erase(seq);
+}
+
+void Outbox::release(uint64_t seq) {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    if (m_records.find(seq) != m_records.end()) {
+        m_ready.insert(seq);
+    }
+}
+
+bool Outbox::pin(const OutboxRecord &record) {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    if (m_records.find(record.seq) == m_records.end()) {
+        return false;
+    }
+    m_readers[record.segment]++;
+    return true;
+}
+
+void Outbox::unpin(const OutboxRecord &record) {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    auto iter = m_readers.find(record.segment);
+    if (iter == m_readers.end() || --iter->second > 0) {
+        return;
+    }
+    m_readers.erase(iter);
+
+    auto doomed = m_doomed.find(record.segment);
+    if (doomed != m_doomed.end()) {
+        doomed->second.remove();
+        m_doomed.erase(doomed);
+    }
+    collect_segments_locked();
+}
+
+bool Outbox::is_pinned_locked(uint64_t segment) const {
+    return m_readers.find(segment) != m_readers.end();
+}
+
+size_t Outbox::pending() const {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    return m_records.size();
+}
+
+uint64_t Outbox::dropped() const {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    return m_dropped;
+}
+
+void Outbox::forget_record_locked(uint64_t seq) {
+    auto iter = m_records.find(seq);
+    if (iter == m_records.end()) {
+        return;
+    }
+    for (Segment &segment : m_segments) {
+        if (segment.id == iter->second.segment) {
+            segment.live--;
+            break;
+        }
+    }
+    m_records.erase(iter);
+    m_ready.erase(seq);
+}
+
+bool Outbox::write_record_locked(uint32_t type,
+                                 uint64_t seq,
+                                 transports::RequestBody *body,
+                                 uint32_t tag) {
+    size_t len = body ? body->size() : 0;
+    if (!m_file || !reserve_locked(sizeof(RecordHeader) + len)) {
+        return false;
+    }
+
+    Segment &active = m_segments.back();
+    RecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = RECORD_MAGIC;
+    header.type = type;
+    header.segment = active.id;
+    header.seq = seq;
+    header.len = len;
+    header.tag = tag;
+
+    // the payload is read only once, the checksum is filled into the header
+    // after it was written.  Until then the record fails verification.
+    char buf[4096];
+    uint32_t crc = 0xffffffff;
+    bool ok = fwrite(&header, sizeof(header), 1, m_file) == 1;
+    if (body) {
+        body->seek(0);
+        while (ok) {
+            size_t read = body->read(buf, sizeof(buf));
+            if (!read) {
+                break;
+            }
+            crc = crc32_update(crc, buf, read);
+            ok = fwrite(buf, 1, read, m_file) == read;
+        }
+    }
+    header.crc = record_crc(crc, header);
+    ok = ok && fseek(m_file, (long)active.size, SEEK_SET) == 0 &&
+         fwrite(&header, sizeof(header), 1, m_file) == 1 &&
+         fseek(m_file, (long)(active.size + sizeof(header) + len),
+               SEEK_SET) == 0;
+    ok = fflush(m_file) == 0 && ok;
+    if (!ok) {
+        // leave the partial record to be overwritten by the next one
+        SENTRY_LOG("failed to write outbox record");
+        clearerr(m_file);
+        fseek(m_file, (long)active.size, SEEK_SET);
+        return false;
+    }
+
+    if (type == RECORD_TYPE_DATA) {
+        OutboxRecord record;
+        record.seq = seq;
+        record.segment = active.id;
+        record.path = active.path;
+        record.offset = active.size + sizeof(header);
+        record.len = len;
+        record.tag = tag;
+        m_records[seq] = record;
+        m_ready.insert(seq);
+        active.live++;
+    }
+    active.size += sizeof(header) + len;
+    return true;
+}
+
+bool Outbox::reserve_locked(size_t len) {
+    const Segment &active = m_segments.back();
+    if (active.size == 0 || active.size + len <= m_segment_size) {
+        return true;
+    }
+
+    fclose(m_file);
+    m_file = nullptr;
+    collect_segments_locked();
+
+    if (m_segments.size() >= m_max_segments) {
+        // the outbox is full, make room by dropping the oldest records.
+        // The segment is removed rather than recycled, and only once no
+        // in-flight upload reads from it any more.
+        Segment oldest = m_segments.front();
+        m_segments.pop_front();
+        for (auto iter = m_records.begin(); iter != m_records.end();) {
+            if (iter->second.segment == oldest.id) {
+                m_ready.erase(iter->first);
+                iter = m_records.erase(iter);
+                m_dropped++;
+            } else {
+                ++iter;
+            }
+        }
+        SENTRY_LOG("outbox is full, dropping oldest records");
+        if (is_pinned_locked(oldest.id)) {
+            m_doomed[oldest.id] = oldest.path;
+        } else {
+            oldest.path.remove();
+        }
+    }
+
+    return open_segment_locked();
+}
+
+bool Outbox::open_segment_locked() {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.seg",
+             (unsigned long long)m_next_segment_id);
+
+    Segment segment;
+    segment.id = m_next_segment_id++;
+    segment.path = m_directory.join(name);
+    segment.size = 0;
+    segment.live = 0;
+
+    if (m_has_spare) {
+        m_has_spare = false;
+        if (m_directory.join(SPARE_SEGMENT_NAME).rename_to(segment.path)) {
+            m_file = segment.path.open("r+b");
+        }
+    }
+    if (!m_file) {
+        m_file = segment.path.open("wb");
+    }
+    if (!m_file) {
+        SENTRY_LOG("failed to open outbox segment");
+        return false;
+    }
+
+    m_segments.push_back(segment);
+    return true;
+}
+
+void Outbox::collect_segments_locked() {
+    while (m_segments.size() > 1 && m_segments.front().live == 0 &&
+           !is_pinned_locked(m_segments.front().id)) {
+        recycle_segment_locked(m_segments.front());
+        m_segments.pop_front();
+    }
+}
+
+void Outbox::recycle_segment_locked(const Segment &segment) {
+    if (m_has_spare) {
+        segment.path.remove();
+        return;
+    }
+
+    // the first header is cleared before the segment is renamed so that a
+    // crash while reusing it can never bring back its old records.
+    FILE *f = segment.path.open("r+b");
+    if (f) {
+        RecordHeader header;
+        memset(&header, 0, sizeof(header));
+        bool cleared = fwrite(&header, sizeof(header), 1, f) == 1;
+        cleared = fclose(f) == 0 && cleared;
+        if (cleared &&
+            segment.path.rename_to(m_directory.join(SPARE_SEGMENT_NAME))) {
+            m_has_spare = true;
+            return;
+        }
+    }
+    segment.path.remove();
+}
@@ -0,0 +1,133 @@
+#ifndef SENTRY_OUTBOX_HPP_INCLUDED
+#define SENTRY_OUTBOX_HPP_INCLUDED
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "internal.hpp"
+#include "path.hpp"
+#include "transports/envelopes.hpp"
+
+namespace sentry {
+
+// the location of a record's payload within the outbox.
+struct OutboxRecord {
+    uint64_t seq;
+    uint64_t segment;
+    Path path;
+    size_t offset;
+    size_t len;
+    // an opaque value that is stored along with the record
+    uint32_t tag;
+};
+
+// a persistent queue of opaque records.
+//
+// Records are appended to segment files in a directory.  Every record is
+// length prefixed and carries a crc32 so that torn writes from a crash are
+// detected and ignored when the outbox is opened again.  Acknowledging a
+// record appends a tombstone for it.  Once all records of the oldest
+// segment are acknowledged the segment is recycled for future writes.  If
+// the outbox grows beyond `max_segments` the oldest records are dropped.
+// Segments that are pinned by a reader are only removed once it is done.
+//
+// Records that a reader holds back, such as those waiting for a retry, are
+// kept out of the index of ready records, so that finding the new ones does
+// not get slower the more are held.
+class Outbox {
+   public:
+    Outbox();
+    ~Outbox();
+
+    // opens the outbox in `directory` and replays all records that were not
+    // acknowledged yet.
+    bool open(const Path &directory,
+              size_t segment_size = SENTRY_OUTBOX_SEGMENT_SIZE,
+              size_t max_segments = SENTRY_OUTBOX_SEGMENTS_MAX);
+    void close();
+    bool is_open() const;
+
+    // appends a record with the contents of `body`.  The record is flushed
+    // to the operating system before this returns.
+    bool append(transports::RequestBody &body,
+                uint64_t *seq_out = nullptr,
+                uint32_t tag = 0);
+    bool append(const char *buf,
+                size_t len,
+                uint64_t *seq_out = nullptr,
+                uint32_t tag = 0);
+
+    // returns the oldest record that was not acknowledged yet.  The record
+    // stays valid until it is acknowledged.
+    bool front(OutboxRecord *record_out) const;
+    // returns the first pending record with a sequence number of at least
+    // `seq`.
+    bool next(uint64_t seq, OutboxRecord *record_out) const;
+    bool get(uint64_t seq, OutboxRecord *record_out) const;
+    bool ack(uint64_t seq);
+
+    // appends all pending records that are not held back, oldest first.
+    void ready(std::vector<OutboxRecord> *records_out) const;
+    // holds a record back from `ready` until it is released again.  New
+    // and replayed records are not held.
+    void hold(uint64_t seq);
+    void release(uint64_t seq);
+
+    // keeps the segment of `record` on disk while its payload is read,
+    // even if the record is dropped in the meantime.  Returns `false` if the
+    // record is already gone.  Every successful `pin` needs an `unpin`.
+    bool pin(const OutboxRecord &record);
+    void unpin(const OutboxRecord &record);
+
+    size_t pending() const;
+    uint64_t dropped() const;
+
+   private:
+    Outbox(const Outbox &) = delete;
+    Outbox &operator=(const Outbox &) = delete;
+
+    struct Segment {
+        uint64_t id;
+        Path path;
+        size_t size;
+        size_t live;
+    };
+
+    void close_locked();
+    void replay_segment(Segment &segment);
+    bool reserve_locked(size_t len);
+    bool open_segment_locked();
+    void collect_segments_locked();
+    void recycle_segment_locked(const Segment &segment);
+    void forget_record_locked(uint64_t seq);
+    bool write_record_locked(uint32_t type,
+                             uint64_t seq,
+                             transports::RequestBody *body,
+                             uint32_t tag = 0);
+    bool is_pinned_locked(uint64_t segment) const;
+
+    mutable std::mutex m_lock;
+    Path m_directory;
+    size_t m_segment_size;
+    size_t m_max_segments;
+    std::deque<Segment> m_segments;
+    std::map<uint64_t, OutboxRecord> m_records;
+    // the records of `m_records` that are not held back
+    std::set<uint64_t> m_ready;
+    // the number of readers per segment, and the dropped segments that are
+    // removed once their last reader is done.
+    std::map<uint64_t, size_t> m_readers;
+    std::map<uint64_t, Path> m_doomed;
+    FILE *m_file;
+    bool m_has_spare;
+    uint64_t m_next_seq;
+    uint64_t m_next_segment_id;
+    uint64_t m_dropped;
+};
+
+}  // namespace sentry
+
+#endif
@@ -99,6 +99,11 @@ bool Path::remove_all() const {
     return rv == 0 || rv == ERROR_FILE_NOT_FOUND;
 }
 
+bool Path::rename_to(const Path &target) const {
+    return MoveFileExW(m_path.c_str(), target.m_path.c_str(),
+                       MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
 Path Path::join(const wchar_t *other) const {
     if (::isalpha(*other) && other[1] == L':') {
         return Path(other);
@@ -147,6 +152,22 @@ bool Path::filename_matches(const char *other) const {
     std::wstring wother = cstr_to_wstr(other);
     return wcscmp(ptr, wother.c_str()) == 0;
 }
+
+bool Path::ends_with(const char *suffix) const {
+    std::wstring wsuffix = cstr_to_wstr(suffix);
+    return m_path.size() >= wsuffix.size() &&
+           m_path.compare(m_path.size() - wsuffix.size(), wsuffix.size(),
+                          wsuffix) == 0;
+}
+
+Path Path::strip_suffix(const char *suffix) const {
+    if (!ends_with(suffix)) {
+        return *this;
+    }
+    std::wstring stripped =
+        m_path.substr(0, m_path.size() - cstr_to_wstr(suffix).size());
+    return Path(stripped.c_str());
+}
 #else
 PathIterator::PathIterator(const Path *path) {
     m_parent = *path;
@@ -209,6 +230,10 @@ bool Path::remove_all() const {
     return this->remove();
 }
 
+bool Path::rename_to(const Path &target) const {
+    return rename(m_path.c_str(), target.m_path.c_str()) == 0;
+}
+
 Path Path::join(const char *other) const {
     if (*other == '/') {
         return Path(other);
@@ -238,7 +263,8 @@ bool Path::create_directories() const {
     char *p = strdup(path);
     char *ptr;
     for (ptr = p; *ptr; ptr++) {
-        if (*ptr == '/') {
+        // the root of absolute paths always exists
+        if (*ptr == '/' && ptr != p) {
             *ptr = 0;
             _TRY_MAKE_DIR;
             *ptr = '/';
@@ -259,6 +285,19 @@ bool Path::filename_matches(const char *other) const {
     const char *ptr = strrchr(m_path.c_str(), '/');
     return strcmp(ptr ? ptr + 1 : m_path.c_str(), other) == 0;
 }
+
+bool Path::ends_with(const char *suffix) const {
+    size_t len = strlen(suffix);
+    return m_path.size() >= len &&
+           m_path.compare(m_path.size() - len, len, suffix) == 0;
+}
+
+Path Path::strip_suffix(const char *suffix) const {
+    if (!ends_with(suffix)) {
+        return *this;
+    }
+    return Path(m_path.substr(0, m_path.size() - strlen(suffix)).c_str());
+}
 #endif
 
 bool Path::is_dir() const {
@@ -271,6 +310,15 @@ bool Path::is_file() const {
     return stat_func(m_path.c_str(), &buf) == 0 && S_ISREG(buf.st_mode);
 }
 
+bool Path::get_size(size_t *size_out) const {
+    struct STAT buf;
+    if (stat_func(m_path.c_str(), &buf) != 0 || !S_ISREG(buf.st_mode)) {
+        return false;
+    }
+    *size_out = (size_t)buf.st_size;
+    return true;
+}
+
 PathIterator Path::iter_directory() const {
     return PathIterator(this);
 }
@@ -49,13 +49,19 @@ class Path {
 
     bool is_dir() const;
     bool is_file() const;
+    bool get_size(size_t *size_out) const;
     Path join(const char *other) const;
     bool create_directories() const;
     bool remove() const;
     bool remove_all() const;
+    bool rename_to(const Path &target) const;
     PathIterator iter_directory() const;
     FILE *open(const char *mode) const;
     bool filename_matches(const char *other) const;
+    bool ends_with(const char *suffix) const;
+    // returns the path without `suffix`, or an unchanged copy if it does not
+    // end with it.
+    Path strip_suffix(const char *suffix) const;
     Path get_executable_path() const;
 
    private:
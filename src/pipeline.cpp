@@ -0,0 +1,187 @@
+#include "breadcrumbs.hpp"
+#include "options.hpp"
+#include "processors.hpp"
+
+#include "pipeline.hpp"
+#include "stats.hpp"
+
+using namespace sentry;
+
+static uint64_t micros_since(std::chrono::steady_clock::time_point start) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+const char *sentry::pipeline_stage_name(PipelineStage stage) {
+    switch (stage) {
+        case PIPELINE_STAGE_ENRICH:
+            return "enrich";
+        case PIPELINE_STAGE_SYMBOLIZE:
+            return "symbolize";
+        case PIPELINE_STAGE_SERIALIZE:
+            return "serialize";
+        case PIPELINE_STAGE_SEND:
+            return "send";
+        default:
+            return "unknown";
+    }
+}
+
+CapturePipeline::CapturePipeline(size_t queue_size) {
+    for (size_t i = 0; i < PIPELINE_STAGE_COUNT; i++) {
+        m_workers[i].reset(new BackgroundWorker(queue_size));
+    }
+}
+
+void CapturePipeline::start() {
+    for (size_t i = 0; i < PIPELINE_STAGE_COUNT; i++) {
+        m_workers[i]->start();
+    }
+}
+
+void CapturePipeline::shutdown() {
+    // stages are shut down front to back so that everything still in flight
+    // is handed on before the next worker receives its shutdown marker.
+    // Their tasks refer to the pipeline, so every thread is joined before
+    // the pipeline can be deleted.  This cannot hang: the queues are
+    // bounded and a stage only ever waits for the next one, which is still
+    // running.
+    for (size_t i = 0; i < PIPELINE_STAGE_COUNT; i++) {
+        m_workers[i]->shutdown(true);
+    }
+    log_stats();
+}
+
+bool CapturePipeline::submit(Value event, Scope scope) {
+    std::shared_ptr<CaptureJob> job(new CaptureJob());
+    job->event = event;
+    job->scope = scope;
+    job->priority = task_priority_for_event(event);
+    job->enqueued_at = std::chrono::steady_clock::now();
+
+    if (!m_workers[PIPELINE_STAGE_ENRICH]->submit_task(
+            [this, job]() { dispatch(PIPELINE_STAGE_ENRICH, job); }, false,
+            job->priority)) {
+        m_stats[PIPELINE_STAGE_ENRICH].dropped++;
+        stat_add(STAT_EVENTS_DROPPED);
+        SENTRY_LOG("capture queue is full, dropping event");
+        return false;
+    }
+    return true;
+}
+
+void CapturePipeline::dispatch(PipelineStage stage,
+                               std::shared_ptr<CaptureJob> job) {
+    PipelineStageStats &stats = m_stats[stage];
+    stats.queue_time_us += micros_since(job->enqueued_at);
+
+    std::chrono::steady_clock::time_point started =
+        std::chrono::steady_clock::now();
+    bool proceed = run_stage(stage, *job);
+    uint64_t run_time = micros_since(started);
+
+    stats.processed++;
+    stats.run_time_us += run_time;
+    uint64_t max_run_time = stats.max_run_time_us.load();
+    while (run_time > max_run_time &&
+           !stats.max_run_time_us.compare_exchange_weak(max_run_time,
+                                                        run_time)) {
+    }
+
+    PipelineStage next = (PipelineStage)(stage + 1);
+    if (!proceed || next == PIPELINE_STAGE_COUNT) {
+        return;
+    }
+
+    job->enqueued_at = std::chrono::steady_clock::now();
+    m_workers[next]->submit_task([this, next, job]() { dispatch(next, job); },
+                                 true, job->priority);
+}
+
+bool CapturePipeline::run_stage(PipelineStage stage, CaptureJob &job) {
+    const sentry_options_t *opts = sentry_get_options();
+
+    switch (stage) {
+        case PIPELINE_STAGE_ENRICH:
+            collect_scope_breadcrumbs(job.scope);
+            job.scope.apply_to_event(job.event, SENTRY_SCOPE_BREADCRUMBS);
+            return true;
+        case PIPELINE_STAGE_SYMBOLIZE:
+            Scope::apply_debug_info(
+                job.event,
+                (ScopeMode)(SENTRY_SCOPE_MODULES | SENTRY_SCOPE_STACKTRACES));
+            if (!run_event_processors(SENTRY_EVENT_PHASE_POST_ENRICHMENT,
+                                      job.event)) {
+                return false;
+            }
+            if (opts->before_send) {
+                job.event = opts->before_send(job.event, nullptr);
+            }
+            return !job.event.is_null();
+        case PIPELINE_STAGE_SERIALIZE:
+            if (!run_event_processors(SENTRY_EVENT_PHASE_PRE_SERIALIZATION,
+                                      job.event)) {
+                return false;
+            }
+            job.envelope = transports::Envelope(job.event);
+            job.event = Value();
+            return true;
+        case PIPELINE_STAGE_SEND:
+            if (opts->transport) {
+                opts->transport->send_envelope(job.envelope);
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+void CapturePipeline::report_stats(Value &stats) const {
+    for (size_t i = 0; i < PIPELINE_STAGE_COUNT; i++) {
+        const PipelineStageStats &stage_stats = m_stats[i];
+        Value stage = Value::new_object();
+        stage.set_by_key("processed",
+                         Value::new_double((double)stage_stats.processed));
+        stage.set_by_key("dropped",
+                         Value::new_double((double)stage_stats.dropped));
+        stage.set_by_key(
+            "queue_depth",
+            Value::new_double((double)m_workers[i]->queue_depth()));
+        uint64_t processed = stage_stats.processed.load();
+        stage.set_by_key(
+            "avg_queue_time_us",
+            Value::new_double(
+                processed ? (double)stage_stats.queue_time_us / processed
+                          : 0.0));
+        stage.set_by_key(
+            "avg_run_time_us",
+            Value::new_double(
+                processed ? (double)stage_stats.run_time_us / processed
+                          : 0.0));
+        stage.set_by_key(
+            "max_run_time_us",
+            Value::new_double((double)stage_stats.max_run_time_us));
+        stats.set_by_key(pipeline_stage_name((PipelineStage)i), stage);
+    }
+}
+
+void CapturePipeline::log_stats() const {
+    for (size_t i = 0; i < PIPELINE_STAGE_COUNT; i++) {
+        const PipelineStageStats &stats = m_stats[i];
+        uint64_t processed = stats.processed.load();
+        SENTRY_LOGF(
+            "pipeline stage %s: %llu processed, %llu dropped, avg queue "
+            "%lluus, avg run %lluus, max run %lluus",
+            pipeline_stage_name((PipelineStage)i),
+            (unsigned long long)processed,
+            (unsigned long long)stats.dropped.load(),
+            (unsigned long long)(processed ? stats.queue_time_us.load() /
+                                                 processed
+                                           : 0),
+            (unsigned long long)(processed
+                                     ? stats.run_time_us.load() / processed
+                                     : 0),
+            (unsigned long long)stats.max_run_time_us.load());
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef SENTRY_PIPELINE_HPP_INCLUDED
+#define SENTRY_PIPELINE_HPP_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#include "internal.hpp"
+#include "scope.hpp"
+#include "transports/envelopes.hpp"
+#include "value.hpp"
+#include "worker.hpp"
+
+namespace sentry {
+
+enum PipelineStage {
+    PIPELINE_STAGE_ENRICH,
+    PIPELINE_STAGE_SYMBOLIZE,
+    PIPELINE_STAGE_SERIALIZE,
+    PIPELINE_STAGE_SEND,
+    PIPELINE_STAGE_COUNT,
+};
+
+const char *pipeline_stage_name(PipelineStage stage);
+
+struct PipelineStageStats {
+    PipelineStageStats()
+        : processed(0),
+          dropped(0),
+          queue_time_us(0),
+          run_time_us(0),
+          max_run_time_us(0) {
+    }
+
+    std::atomic<uint64_t> processed;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> queue_time_us;
+    std::atomic<uint64_t> run_time_us;
+    std::atomic<uint64_t> max_run_time_us;
+};
+
+// an event that travels through the capture pipeline.
+struct CaptureJob {
+    Value event;
+    Scope scope;
+    transports::Envelope envelope;
+    TaskPriority priority;
+    std::chrono::steady_clock::time_point enqueued_at;
+};
+
+// moves the expensive parts of `sentry_capture_event` off the calling thread.
+//
+// Every stage runs on its own background worker and hands the event to the
+// next stage through a bounded queue.  The calling thread never blocks: if
+// the first queue is full the event is dropped.  Later stages wait for room
+// in the next queue instead which applies backpressure up to the caller.
+// Fatal and error events take the priority lanes of every stage.
+class CapturePipeline {
+   public:
+    CapturePipeline(size_t queue_size);
+    void start();
+    void shutdown();
+
+    // enqueues an event together with a snapshot of the scope.  Returns
+    // `false` if the event had to be dropped.
+    bool submit(Value event, Scope scope);
+
+    const PipelineStageStats &stats(PipelineStage stage) const {
+        return m_stats[stage];
+    }
+    void log_stats() const;
+
+    // adds the per stage numbers and queue depths to `stats`.
+    void report_stats(Value &stats) const;
+
+   private:
+    CapturePipeline(const CapturePipeline &) = delete;
+    CapturePipeline &operator=(CapturePipeline &) = delete;
+
+    bool run_stage(PipelineStage stage, CaptureJob &job);
+    void dispatch(PipelineStage stage, std::shared_ptr<CaptureJob> job);
+
+    std::unique_ptr<BackgroundWorker> m_workers[PIPELINE_STAGE_COUNT];
+    PipelineStageStats m_stats[PIPELINE_STAGE_COUNT];
+};
+
+}  // namespace sentry
+
+#endif
@@ -0,0 +1,34 @@
+#include "options.hpp"
+#include "stats.hpp"
+
+#include "processors.hpp"
+
+using namespace sentry;
+
+bool sentry::run_event_processors(sentry_event_phase_t phase, Value &event) {
+    const sentry_options_t *opts = sentry_get_options();
+    if (!opts) {
+        return true;
+    }
+    for (const EventProcessor &processor : opts->event_processors) {
+        if (processor.phase != phase) {
+            continue;
+        }
+        event = Value::consume(
+            processor.func(event.lower(), nullptr, processor.closure));
+        if (event.is_null()) {
+            stat_add(STAT_EVENTS_FILTERED);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool sentry::run_before_breadcrumb(Value &breadcrumb) {
+    const sentry_options_t *opts = sentry_get_options();
+    if (!opts || !opts->before_breadcrumb) {
+        return true;
+    }
+    breadcrumb = opts->before_breadcrumb(breadcrumb, nullptr);
+    return !breadcrumb.is_null();
+}
@@ -0,0 +1,27 @@
+#ifndef SENTRY_PROCESSORS_HPP_INCLUDED
+#define SENTRY_PROCESSORS_HPP_INCLUDED
+
+#include "internal.hpp"
+#include "value.hpp"
+
+namespace sentry {
+
+// an event processor as added by `sentry_options_add_event_processor`.
+struct EventProcessor {
+    sentry_event_phase_t phase;
+    sentry_event_function_t func;
+    void *closure;
+};
+
+// runs the event processors of `phase` in the order they were added.
+// Returns `false` once one of them drops the event, the later ones do not
+// run then.
+bool run_event_processors(sentry_event_phase_t phase, Value &event);
+
+// runs the before breadcrumb hook.  Returns `false` if it drops the
+// breadcrumb.
+bool run_before_breadcrumb(Value &breadcrumb);
+
+}  // namespace sentry
+
+#endif
@@ -0,0 +1,35 @@
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include "sampling.hpp"
+
+using namespace sentry;
+
+static uint64_t initial_seed() {
+    std::random_device seed;
+    uint64_t rv = ((uint64_t)seed() << 32) ^ seed();
+    rv ^= (uint64_t)std::hash<std::thread::id>()(std::this_thread::get_id());
+    rv ^= (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+    // xorshift must never be seeded with zero
+    return rv ? rv : 0x9e3779b97f4a7c15ULL;
+}
+
+uint64_t sentry::fast_random() {
+    static thread_local uint64_t state = initial_seed();
+    // xorshift64*
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dULL;
+}
+
+bool sentry::sample(double rate) {
+    if (rate >= 1.0) {
+        return true;
+    } else if (rate <= 0.0) {
+        return false;
+    }
+    // the top 53 bits give an evenly distributed double in [0, 1)
+    return (double)(fast_random() >> 11) * (1.0 / 9007199254740992.0) < rate;
+}
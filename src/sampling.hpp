@@ -0,0 +1,20 @@
+#ifndef SENTRY_SAMPLING_HPP_INCLUDED
+#define SENTRY_SAMPLING_HPP_INCLUDED
+
+#include <stdint.h>
+
+#include "internal.hpp"
+
+namespace sentry {
+
+// returns a uniformly distributed random number from a per-thread
+// xorshift generator.  This is not cryptographically secure but cheap
+// enough to call on every captured event.
+uint64_t fast_random();
+
+// rolls the dice for a sample rate between 0 and 1.
+bool sample(double rate);
+
+}  // namespace sentry
+
+#endif
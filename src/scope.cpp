@@ -1,32 +1,143 @@
 #include <mutex>
+#include <vector>
 
 #include "modulefinder.hpp"
 #include "options.hpp"
+#include "stats.hpp"
 #include "symbolize.hpp"
 
 #include "scope.hpp"
 
 using namespace sentry;
 
-static Scope g_scope;
-static std::mutex scope_lock;
+static std::shared_ptr<const Scope> initial_scope() {
+    std::shared_ptr<Scope> scope(new Scope());
+    scope->freeze();
+    return scope;
+}
+
+// only ever accessed through `std::atomic_load` and `std::atomic_store`
+static std::shared_ptr<const Scope> g_scope = initial_scope();
+static std::mutex scope_write_lock;
+// the layers pushed on this thread, innermost last
+static thread_local std::vector<Scope> t_layers;
 
-void Scope::with_scope(std::function<void(const Scope &)> func) {
-    std::lock_guard<std::mutex> _slck(scope_lock);
-    func(g_scope);
+std::shared_ptr<const Scope> Scope::snapshot() {
+    return std::atomic_load(&g_scope);
+}
+
+std::shared_ptr<const Scope> Scope::current() {
+    std::shared_ptr<const Scope> global = snapshot();
+    if (t_layers.empty()) {
+        return global;
+    }
+    std::shared_ptr<Scope> scope(new Scope(global->clone()));
+    for (const Scope &layer : t_layers) {
+        scope->apply_layer(layer);
+    }
+    // the layers keep changing on this thread while the merged scope may be
+    // applied on another one
+    scope->freeze();
+    return scope;
 }
 
-void Scope::with_scope_mut(std::function<void(Scope &)> func) {
-    std::lock_guard<std::mutex> _slck(scope_lock);
+void Scope::with_scope_mut_impl(void (*func)(Scope &scope, void *data),
+                                void *data) {
     const sentry_options_t *opts = sentry_get_options();
+    if (!t_layers.empty()) {
+        if (opts && !opts->dsn.disabled()) {
+            func(t_layers.back(), data);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> _slck(scope_write_lock);
     if (opts && !opts->dsn.disabled()) {
-        func(g_scope);
+        std::shared_ptr<Scope> scope(new Scope(snapshot()->clone()));
+        func(*scope, data);
+        scope->freeze();
+        std::atomic_store(&g_scope, std::shared_ptr<const Scope>(scope));
         if (opts->backend) {
-            opts->backend->flush_scope(g_scope);
+            opts->backend->flush_scope(*scope);
         }
     }
 }
 
+Scope Scope::clone() const {
+    Scope rv;
+    rv.transaction = transaction;
+    rv.fingerprint = fingerprint;
+    rv.user = user;
+    rv.tags = tags.clone_shallow();
+    rv.extra = extra.clone_shallow();
+    rv.contexts = contexts.clone_shallow();
+    rv.breadcrumbs = breadcrumbs.clone_shallow();
+    rv.breadcrumbs_cutoff = breadcrumbs_cutoff;
+    rv.level = level;
+    return rv;
+}
+
+void Scope::push_layer() {
+    Scope layer;
+    layer.fingerprint = Value();
+    layer.level = SCOPE_LEVEL_UNSET;
+    t_layers.push_back(layer);
+}
+
+bool Scope::pop_layer() {
+    if (t_layers.empty()) {
+        return false;
+    }
+    t_layers.pop_back();
+    return true;
+}
+
+bool Scope::has_layers() {
+    return !t_layers.empty();
+}
+
+// returns `inner` with the keys of `outer` that it does not have itself.
+static Value merge_objects(const Value &outer, const Value &inner) {
+    if (inner.length() == 0) {
+        return outer;
+    }
+    Value holder = Value::new_object();
+    holder.set_by_key("merged", inner.clone_shallow());
+    holder.merge_key("merged", outer);
+    return holder.get_by_key("merged");
+}
+
+void Scope::apply_layer(const Scope &layer) {
+    if (!layer.transaction.empty()) {
+        transaction = layer.transaction;
+    }
+    if (!layer.fingerprint.is_null()) {
+        fingerprint = layer.fingerprint;
+    }
+    if (!layer.user.is_null()) {
+        user = layer.user;
+    }
+    if (layer.level != SCOPE_LEVEL_UNSET) {
+        level = layer.level;
+    }
+    tags = merge_objects(tags, layer.tags);
+    extra = merge_objects(extra, layer.extra);
+    contexts = merge_objects(contexts, layer.contexts);
+    for (size_t i = 0, n = layer.breadcrumbs.length(); i < n; i++) {
+        breadcrumbs.append_bounded(layer.breadcrumbs.get_by_index(i),
+                                   SENTRY_BREADCRUMBS_MAX);
+    }
+}
+
+void Scope::freeze() {
+    fingerprint.freeze();
+    user.freeze();
+    tags.freeze();
+    extra.freeze();
+    contexts.freeze();
+    breadcrumbs.freeze();
+}
+
 static std::vector<Value> find_stacktraces_in_event(Value event) {
     std::vector<Value> rv;
 
@@ -106,65 +217,40 @@ static void postprocess_stacktrace(Value stacktrace) {
 }
 
 void Scope::apply_to_event(Value &event, ScopeMode mode) const {
+    ScopedStatTimer timer(STAT_TIMER_APPLY_SCOPE);
     const sentry_options_t *options = sentry_get_options();
 
-    if (event.get_by_key("platform").is_null()) {
-        event.set_by_key("platform", Value::new_string("native"));
-    }
+    options->event_base.apply_to_event(event);
 
-    if (!options->release.empty()) {
-        event.set_by_key("release",
-                         Value::new_string(options->release.c_str()));
-    }
-    if (!options->dist.empty()) {
-        event.set_by_key("dist", Value::new_string(options->dist.c_str()));
-    }
-    if (!options->environment.empty()) {
-        event.set_by_key("environment",
-                         Value::new_string(options->environment.c_str()));
-    }
     if (event.get_by_key("level").is_null()) {
         event.set_by_key("level", Value::new_level(level));
     }
     if (event.get_by_key("user").is_null()) {
-        event.set_by_key("user", user);
+        event.set_by_key("user", user.clone_shallow());
     }
     if (!transaction.empty()) {
         event.set_by_key("transaction", Value::new_string(transaction.c_str()));
     }
 
     event.merge_key("tags", tags);
-    event.merge_key("extra", extra);
-    event.merge_key("contexts", contexts);
+    // the values of the scope are frozen, the event gets copies that
+    // `before_send` and event processors can still modify.
+    event.merge_key_copy("extra", extra);
+    event.merge_key_copy("contexts", contexts);
 
     if (fingerprint.type() == SENTRY_VALUE_TYPE_LIST &&
         fingerprint.length() > 0) {
-        event.set_by_key("fingerprint", fingerprint);
+        event.set_by_key("fingerprint", fingerprint.clone_shallow());
     }
 
-    // make sure to clone the breadcrumbs so that concurrent modifications
-    // on the list after the scope lock was released do not cause a crash.
     if ((mode & SENTRY_SCOPE_BREADCRUMBS) && breadcrumbs.length() > 0) {
-        event.merge_key("breadcrumbs", breadcrumbs.clone());
-    }
-
-    static Value shared_sdk_info;
-    if (shared_sdk_info.is_null()) {
-        Value sdk_info = Value::new_object();
-        Value version = Value::new_string(SENTRY_SDK_VERSION);
-        sdk_info.set_by_key("name", Value::new_string(SENTRY_SDK_NAME));
-        sdk_info.set_by_key("version", version);
-        Value package = Value::new_object();
-        package.set_by_key("name",
-                           Value::new_string("github:getsentry/sentry-native"));
-        package.set_by_key("version", version);
-        Value packages = Value::new_list();
-        packages.append(package);
-        sdk_info.set_by_key("packages", packages);
-        sdk_info.freeze();
-        shared_sdk_info = sdk_info;
+        event.merge_key("breadcrumbs", breadcrumbs);
     }
 
+    apply_debug_info(event, mode);
+}
+
+void Scope::apply_debug_info(Value &event, ScopeMode mode) {
     if (mode & SENTRY_SCOPE_MODULES) {
         Value modules(modulefinders::get_module_list());
         if (!modules.is_null()) {
@@ -181,6 +267,4 @@ void Scope::apply_to_event(Value &event, ScopeMode mode) const {
             postprocess_stacktrace(*iter);
         }
     }
-
-    event.set_by_key("sdk", shared_sdk_info);
 }
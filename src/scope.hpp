@@ -1,8 +1,9 @@
 #ifndef SENTRY_SCOPE_HPP_INCLUDED
 #define SENTRY_SCOPE_HPP_INCLUDED
 
-#include <functional>
+#include <memory>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -18,6 +19,12 @@ enum ScopeMode {
     SENTRY_SCOPE_ALL = 0x7,
 };
 
+// the level of a scope layer that does not override the level below it.
+static const sentry_level_t SCOPE_LEVEL_UNSET = (sentry_level_t)-2;
+
+// the `breadcrumbs_cutoff` of a scope whose breadcrumbs are complete.
+static const uint64_t BREADCRUMBS_COLLECTED = ~0ULL;
+
 struct Scope {
     Scope()
         : level(SENTRY_LEVEL_ERROR),
@@ -25,17 +32,66 @@ struct Scope {
           tags(Value::new_object()),
           contexts(Value::new_object()),
           breadcrumbs(Value::new_list()),
+          breadcrumbs_cutoff(BREADCRUMBS_COLLECTED),
           fingerprint(Value::new_list()) {
     }
 
-    static void with_scope(std::function<void(const Scope &)> func);
-    static void with_scope_mut(std::function<void(Scope &)> func);
+    // the global scope is an immutable snapshot that writers replace as a
+    // whole.  Readers never block: they hold on to the snapshot that was
+    // current when they asked for it, even if it is replaced in the meantime.
+    static std::shared_ptr<const Scope> snapshot();
+
+    // returns the scope of the calling thread, which is the global snapshot
+    // with the thread's layers applied on top.
+    static std::shared_ptr<const Scope> current();
+
+    template <typename Func>
+    static void with_scope(Func &&func) {
+        std::shared_ptr<const Scope> scope = current();
+        func(*scope);
+    }
+
+    // runs `func` on the innermost layer of the calling thread.  Without
+    // layers it runs on a copy of the global scope and publishes the copy.
+    // Writers of the global scope are serialized among each other but never
+    // block readers.
+    //
+    // `func` is passed on by reference, so neither it nor what it captures
+    // is copied.
+    template <typename Func>
+    static void with_scope_mut(Func &&func) {
+        typedef typename std::remove_reference<Func>::type FuncType;
+        with_scope_mut_impl(
+            [](Scope &scope, void *data) { (*(FuncType *)data)(scope); },
+            (void *)&func);
+    }
+
+    // pushes and pops a layer of the calling thread.  A layer only holds
+    // what was set while it is the innermost one, which overrides the
+    // layers below it.
+    static void push_layer();
+    static bool pop_layer();
+    static bool has_layers();
+
+    // creates a copy of the scope whose lists and objects can be modified
+    // without affecting this one.  The values inside of them are shared.
+    Scope clone() const;
+
+    // makes all values of the scope immutable.
+    void freeze();
+
+    // applies everything `layer` sets on top of this scope.
+    void apply_layer(const Scope &layer);
 
     void apply_to_event(Value &event, ScopeMode mode) const;
     void apply_to_event(Value &event) const {
         apply_to_event(event, SENTRY_SCOPE_ALL);
     }
 
+    // attaches the module list and symbolicates stacktraces.  This is the
+    // part of `apply_to_event` that does not depend on the scope.
+    static void apply_debug_info(Value &event, ScopeMode mode);
+
     std::string transaction;
     sentry::Value fingerprint;
     sentry::Value user;
@@ -43,7 +99,15 @@ struct Scope {
     sentry::Value extra;
     sentry::Value contexts;
     sentry::Value breadcrumbs;
+    // the breadcrumbs of all threads are not part of the scope.  A scope
+    // that was captured for an event may hold off on merging them in, in
+    // which case only those numbered below this belong to it.
+    uint64_t breadcrumbs_cutoff;
     sentry_level_t level;
+
+   private:
+    static void with_scope_mut_impl(void (*func)(Scope &scope, void *data),
+                                    void *data);
 };
 }  // namespace sentry
 
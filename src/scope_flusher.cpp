@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vendor/mpack.h"
+
+#include "breadcrumbs.hpp"
+#include "scope_flusher.hpp"
+
+using namespace sentry;
+
+ScopeFlusher::ScopeFlusher()
+    : m_with_breadcrumbs(false),
+      m_interval(SENTRY_SCOPE_FLUSH_INTERVAL_MS),
+      m_running(false),
+      m_scheduled(false),
+      m_writes(0) {
+}
+
+ScopeFlusher::~ScopeFlusher() {
+    shutdown();
+}
+
+void ScopeFlusher::start(const Path &path,
+                         const Path &temp_path,
+                         std::chrono::milliseconds interval) {
+    m_path = path;
+    m_temp_path = temp_path;
+    m_interval = interval;
+    m_worker.start();
+    m_running = true;
+}
+
+void ScopeFlusher::shutdown() {
+    if (!m_running) {
+        return;
+    }
+    // a write that is still waiting for its interval would be discarded
+    flush();
+    m_worker.shutdown();
+    m_running = false;
+}
+
+void ScopeFlusher::mark_dirty(std::shared_ptr<const Scope> scope) {
+    std::chrono::milliseconds delay(0);
+    {
+        std::lock_guard<std::mutex> _lock(m_lock);
+        m_pending = scope;
+        if (m_scheduled || !m_running) {
+            return;
+        }
+        if (m_interval.count() > 0) {
+            m_scheduled = true;
+            Clock::time_point due = m_last_write + m_interval;
+            Clock::time_point now = Clock::now();
+            if (due > now) {
+                delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            due - now) +
+                        std::chrono::milliseconds(1);
+            }
+        }
+    }
+
+    // without an interval nothing is left pending for a crash to miss
+    if (m_interval.count() == 0) {
+        flush();
+        return;
+    }
+
+    auto task = [this]() {
+        {
+            std::lock_guard<std::mutex> _lock(m_lock);
+            m_scheduled = false;
+        }
+        flush();
+    };
+    if (delay.count() == 0) {
+        m_worker.submit_task(task);
+    } else {
+        m_worker.submit_delayed_task(task, delay);
+    }
+}
+
+bool ScopeFlusher::flush() {
+    if (!m_running) {
+        return false;
+    }
+    std::lock_guard<std::mutex> _wlock(m_write_lock);
+    std::shared_ptr<const Scope> scope;
+    {
+        std::lock_guard<std::mutex> _lock(m_lock);
+        scope.swap(m_pending);
+        m_last_write = Clock::now();
+    }
+    return !scope || write(*scope);
+}
+
+bool ScopeFlusher::write_file(const Path &path, const char *buf, size_t size) {
+    FILE *file = m_temp_path.open("wb");
+    bool ok = file && fwrite(buf, 1, size, file) == size;
+    if (file) {
+        ok = fclose(file) == 0 && ok;
+    }
+    return ok && m_temp_path.rename_to(path);
+}
+
+bool ScopeFlusher::write(const Scope &scope) {
+    Value event = Value::new_object();
+    scope.apply_to_event(event, SENTRY_SCOPE_NONE);
+
+    size_t size;
+    char *buf = event.to_msgpack_string(&size);
+    if (!buf) {
+        return false;
+    }
+    bool ok = write_file(m_path, buf, size);
+    free(buf);
+
+    if (ok && m_with_breadcrumbs) {
+        // the breadcrumb files are a plain sequence of msgpack values
+        Value breadcrumbs =
+            collect_breadcrumbs(scope.breadcrumbs, SENTRY_BREADCRUMBS_MAX);
+        mpack_writer_t writer;
+        mpack_writer_init_growable(&writer, &buf, &size);
+        for (size_t i = 0; i < breadcrumbs.length(); i++) {
+            breadcrumbs.get_by_index(i).to_msgpack(&writer);
+        }
+        ok = mpack_writer_destroy(&writer) == mpack_ok &&
+             write_file(m_breadcrumbs_path, buf ? buf : "", size);
+        free(buf);
+    }
+
+    if (!ok) {
+        SENTRY_LOG("failed to persist the scope");
+        return false;
+    }
+    m_writes++;
+    return true;
+}
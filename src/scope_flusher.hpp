@@ -0,0 +1,81 @@
+#ifndef SENTRY_SCOPE_FLUSHER_HPP_INCLUDED
+#define SENTRY_SCOPE_FLUSHER_HPP_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+#include "internal.hpp"
+#include "path.hpp"
+#include "scope.hpp"
+#include "worker.hpp"
+
+namespace sentry {
+
+// persists the scope for an out of process crash handler.
+//
+// Scope changes only mark the scope dirty.  A background worker writes the
+// latest snapshot at most once per `interval`, so a burst of changes costs
+// a single write.  The file is written next to its final location and
+// renamed over it, so a crash never leaves a partially written scope
+// behind.  `flush` writes right away when a crash is imminent.  An interval
+// of 0 writes every change on the calling thread.
+class ScopeFlusher {
+   public:
+    typedef std::chrono::steady_clock Clock;
+
+    ScopeFlusher();
+    ~ScopeFlusher();
+
+    // `temp_path` must be on the same filesystem as `path`.
+    void start(const Path &path,
+               const Path &temp_path,
+               std::chrono::milliseconds interval);
+    void shutdown();
+
+    // also writes the breadcrumbs of all threads and of the scope to
+    // `path`, in the format of the breadcrumb files.  Must be called before
+    // `start`.
+    void set_breadcrumbs_path(const Path &path) {
+        m_breadcrumbs_path = path;
+        m_with_breadcrumbs = true;
+    }
+
+    void mark_dirty(std::shared_ptr<const Scope> scope);
+
+    // writes a pending scope on the calling thread.
+    bool flush();
+
+    uint64_t writes() const {
+        return m_writes;
+    }
+
+   private:
+    ScopeFlusher(const ScopeFlusher &) = delete;
+    ScopeFlusher &operator=(ScopeFlusher &) = delete;
+
+    bool write(const Scope &scope);
+    bool write_file(const Path &path, const char *buf, size_t size);
+
+    Path m_path;
+    Path m_temp_path;
+    Path m_breadcrumbs_path;
+    bool m_with_breadcrumbs;
+    std::chrono::milliseconds m_interval;
+    BackgroundWorker m_worker;
+    std::atomic<bool> m_running;
+
+    std::mutex m_lock;
+    std::shared_ptr<const Scope> m_pending;
+    bool m_scheduled;
+    Clock::time_point m_last_write;
+
+    // serializes writes of the worker with those of `flush`
+    std::mutex m_write_lock;
+    std::atomic<uint64_t> m_writes;
+};
+
+}  // namespace sentry
+
+#endif
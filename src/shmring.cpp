@@ -0,0 +1,250 @@
+#if !defined(_WIN32) && !defined(__ANDROID__)
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <thread>
+
+#include "shmring.hpp"
+
+using namespace sentry;
+
+static const uint64_t RING_MAGIC = 0x31676e6972746e73ULL;  // "sntring1"
+static const uint64_t STATE_RESERVED = 1;
+static const uint64_t STATE_COMMITTED = 2;
+static const uint64_t STATE_MASK = 3;
+static const size_t HEADER_SIZE = 4096;
+static const size_t OPEN_ATTEMPTS = 100;
+
+struct SharedRing::Header {
+    // set last by the process that created the ring
+    std::atomic<uint64_t> magic;
+    uint64_t capacity;
+    // head and tail live on separate cache lines as they are written by
+    // producers and the consumer respectively.
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    alignas(64) std::atomic<uint64_t> dropped;
+};
+
+static uint64_t record_size(size_t len) {
+    return sizeof(uint64_t) + (((uint64_t)len + 7) & ~(uint64_t)7);
+}
+
+SharedRing::SharedRing()
+    : m_header(nullptr),
+      m_data(nullptr),
+      m_mapping_size(0),
+      m_capacity(0),
+      m_stalled_pos(0) {
+}
+
+SharedRing::~SharedRing() {
+    close();
+}
+
+bool SharedRing::open(const char *name, size_t capacity) {
+    close();
+
+    // only one process can create the object.  A zero filled object is an
+    // empty ring, so it only needs to be sized and have its capacity set.
+    capacity = (capacity + 7) & ~(size_t)7;
+    bool created = true;
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        created = false;
+        fd = shm_open(name, O_RDWR, 0600);
+    }
+    if (fd < 0) {
+        SENTRY_LOGF("failed to open shared memory ring %s", name);
+        return false;
+    }
+    if (created && ftruncate(fd, HEADER_SIZE + capacity) != 0) {
+        ::close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    // the creator may not have sized the object yet
+    struct stat st;
+    for (size_t i = 0;; i++) {
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        if ((size_t)st.st_size > HEADER_SIZE || i == OPEN_ATTEMPTS) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if ((size_t)st.st_size <= HEADER_SIZE) {
+        SENTRY_LOGF("shared memory ring %s was never sized", name);
+        ::close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    Header *header = (Header *)mapping;
+    if (created) {
+        header->capacity = capacity;
+        header->magic.store(RING_MAGIC, std::memory_order_release);
+    }
+    for (size_t i = 0;
+         header->magic.load(std::memory_order_acquire) != RING_MAGIC; i++) {
+        if (i == OPEN_ATTEMPTS) {
+            SENTRY_LOGF("%s is not a shared memory ring", name);
+            munmap(mapping, (size_t)st.st_size);
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    uint64_t mapped_capacity = header->capacity;
+    if (mapped_capacity == 0 || mapped_capacity % 8 != 0 ||
+        mapped_capacity > (size_t)st.st_size - HEADER_SIZE) {
+        SENTRY_LOGF("shared memory ring %s is corrupted", name);
+        munmap(mapping, (size_t)st.st_size);
+        return false;
+    }
+    m_header = header;
+    m_data = (char *)mapping + HEADER_SIZE;
+    m_mapping_size = (size_t)st.st_size;
+    m_capacity = (size_t)mapped_capacity;
+    m_stalled_pos = header->tail.load();
+    m_stalled_since = std::chrono::steady_clock::now();
+    return true;
+}
+
+void SharedRing::close() {
+    if (m_header) {
+        munmap((void *)m_header, m_mapping_size);
+        m_header = nullptr;
+        m_data = nullptr;
+        m_mapping_size = 0;
+        m_capacity = 0;
+    }
+}
+
+bool SharedRing::unlink(const char *name) {
+    return shm_unlink(name) == 0;
+}
+
+size_t SharedRing::capacity() const {
+    return m_capacity;
+}
+
+uint64_t SharedRing::dropped() const {
+    return m_header ? m_header->dropped.load() : 0;
+}
+
+std::atomic<uint64_t> &SharedRing::state_word(uint64_t pos) const {
+    // records are 8 byte aligned and so is the capacity, which means a state
+    // word is never split at the end of the buffer.
+    return *(std::atomic<uint64_t> *)(m_data + pos % m_capacity);
+}
+
+void SharedRing::copy_in(uint64_t pos, const char *buf, size_t len) {
+    size_t offset = pos % m_capacity;
+    size_t first = std::min(len, m_capacity - offset);
+    memcpy(m_data + offset, buf, first);
+    memcpy(m_data, buf + first, len - first);
+}
+
+void SharedRing::copy_out(uint64_t pos, char *buf, size_t len) const {
+    size_t offset = pos % m_capacity;
+    size_t first = std::min(len, m_capacity - offset);
+    memcpy(buf, m_data + offset, first);
+    memcpy(buf + first, m_data, len - first);
+}
+
+void SharedRing::zero(uint64_t pos, size_t len) {
+    size_t offset = pos % m_capacity;
+    size_t first = std::min(len, m_capacity - offset);
+    memset(m_data + offset, 0, first);
+    memset(m_data, 0, len - first);
+}
+
+bool SharedRing::push(const char *buf, size_t len) {
+    if (!m_header) {
+        return false;
+    }
+    uint64_t size = record_size(len);
+    if (size > m_capacity || len > (UINT64_MAX >> 2)) {
+        m_header->dropped++;
+        return false;
+    }
+
+    uint64_t head = m_header->head.load(std::memory_order_relaxed);
+    do {
+        uint64_t tail = m_header->tail.load(std::memory_order_acquire);
+        if (head + size - tail > m_capacity) {
+            m_header->dropped++;
+            return false;
+        }
+    } while (!m_header->head.compare_exchange_weak(head, head + size,
+                                                   std::memory_order_acq_rel));
+
+    std::atomic<uint64_t> &state = state_word(head);
+    state.store(((uint64_t)len << 2) | STATE_RESERVED,
+                std::memory_order_release);
+    copy_in(head + sizeof(uint64_t), buf, len);
+    state.store(((uint64_t)len << 2) | STATE_COMMITTED,
+                std::memory_order_release);
+    return true;
+}
+
+bool SharedRing::pop(std::string *out) {
+    if (!m_header) {
+        return false;
+    }
+
+    for (;;) {
+        uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+        if (tail == m_header->head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        uint64_t state = state_word(tail).load(std::memory_order_acquire);
+        size_t len = (size_t)(state >> 2);
+        uint64_t size = record_size(len);
+
+        if ((state & STATE_MASK) != STATE_COMMITTED) {
+            std::chrono::steady_clock::time_point now =
+                std::chrono::steady_clock::now();
+            if (m_stalled_pos != tail) {
+                m_stalled_pos = tail;
+                m_stalled_since = now;
+                return false;
+            }
+            // without a length there is no way to skip the record
+            if ((state & STATE_MASK) != STATE_RESERVED ||
+                now - m_stalled_since <
+                    std::chrono::milliseconds(SENTRY_SHM_RING_STALL_MS)) {
+                return false;
+            }
+            SENTRY_LOG("skipping abandoned record in shared memory ring");
+            m_header->dropped++;
+            zero(tail, size);
+            m_header->tail.store(tail + size, std::memory_order_release);
+            continue;
+        }
+
+        out->resize(len);
+        if (len) {
+            copy_out(tail + sizeof(uint64_t), &(*out)[0], len);
+        }
+        zero(tail, size);
+        m_header->tail.store(tail + size, std::memory_order_release);
+        return true;
+    }
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef SENTRY_SHMRING_HPP_INCLUDED
+#define SENTRY_SHMRING_HPP_INCLUDED
+#if !defined(_WIN32) && !defined(__ANDROID__)
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "internal.hpp"
+
+namespace sentry {
+
+// a multi-producer single-consumer ring buffer of variable sized records in
+// a named shared memory object.
+//
+// Any number of processes can push records concurrently without locks.
+// Producers never wait: if there is not enough room the record is dropped
+// and a drop counter in the shared header is incremented.  Exactly one
+// process may pop records at a time.
+//
+// Every record starts with an 8 byte state word followed by the payload,
+// padded to 8 bytes.  A producer reserves space by advancing the shared
+// head, marks the record as reserved, copies the payload and then marks it
+// as committed.  The consumer zeroes records it has read before it advances
+// the tail, so reserved space is always zeroed.  A record that stays
+// reserved for longer than `SENTRY_SHM_RING_STALL_MS`, for instance because
+// its producer crashed, is skipped and counted as dropped.
+class SharedRing {
+   public:
+    SharedRing();
+    ~SharedRing();
+
+    // opens or creates the shared memory object `name` with room for
+    // `capacity` bytes of records.  If the object already exists its
+    // capacity is used instead.  Only the process that creates the object
+    // initializes it, the others wait until it is ready.
+    bool open(const char *name, size_t capacity = SENTRY_SHM_RING_SIZE);
+    void close();
+    bool is_open() const {
+        return m_header != nullptr;
+    }
+
+    // removes the shared memory object.  Mappings stay valid until closed.
+    static bool unlink(const char *name);
+
+    bool push(const char *buf, size_t len);
+    // pops the oldest committed record into `out`.  Returns `false` if the
+    // ring is empty or the oldest record is still being written.
+    bool pop(std::string *out);
+
+    size_t capacity() const;
+    uint64_t dropped() const;
+
+   private:
+    SharedRing(const SharedRing &) = delete;
+    SharedRing &operator=(const SharedRing &) = delete;
+
+    struct Header;
+
+    std::atomic<uint64_t> &state_word(uint64_t pos) const;
+    void copy_in(uint64_t pos, const char *buf, size_t len);
+    void copy_out(uint64_t pos, char *buf, size_t len) const;
+    void zero(uint64_t pos, size_t len);
+
+    Header *m_header;
+    char *m_data;
+    size_t m_mapping_size;
+    size_t m_capacity;
+    // the consumer side position that has not made progress since
+    uint64_t m_stalled_pos;
+    std::chrono::steady_clock::time_point m_stalled_since;
+};
+
+}  // namespace sentry
+
+#endif
+#endif
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "stats.hpp"
+
+using namespace sentry;
+
+namespace {
+struct StatBlock {
+    StatBlock() {
+        for (size_t i = 0; i < STAT_COUNTER_COUNT; i++) {
+            counters[i] = 0;
+        }
+        for (size_t i = 0; i < STAT_TIMER_COUNT; i++) {
+            timer_sum[i] = 0;
+            for (size_t j = 0; j < SENTRY_STATS_BUCKETS; j++) {
+                buckets[i][j] = 0;
+            }
+        }
+    }
+
+    // only the owning thread writes, so a relaxed load and store is enough
+    // and avoids a locked read-modify-write.
+    static void bump(std::atomic<uint64_t> &slot, uint64_t value) {
+        slot.store(slot.load(std::memory_order_relaxed) + value,
+                   std::memory_order_relaxed);
+    }
+
+    void merge_into(StatBlock &other) const {
+        for (size_t i = 0; i < STAT_COUNTER_COUNT; i++) {
+            bump(other.counters[i], counters[i].load());
+        }
+        for (size_t i = 0; i < STAT_TIMER_COUNT; i++) {
+            bump(other.timer_sum[i], timer_sum[i].load());
+            for (size_t j = 0; j < SENTRY_STATS_BUCKETS; j++) {
+                bump(other.buckets[i][j], buckets[i][j].load());
+            }
+        }
+    }
+
+    std::atomic<uint64_t> counters[STAT_COUNTER_COUNT];
+    std::atomic<uint64_t> timer_sum[STAT_TIMER_COUNT];
+    std::atomic<uint64_t> buckets[STAT_TIMER_COUNT][SENTRY_STATS_BUCKETS];
+};
+
+struct StatRegistry {
+    std::mutex lock;
+    std::vector<StatBlock *> blocks;
+    // totals of threads that have exited
+    StatBlock retired;
+};
+
+// intentionally leaked so that threads exiting during static destruction
+// can still hand in their numbers.
+StatRegistry &registry() {
+    static StatRegistry *registry = new StatRegistry();
+    return *registry;
+}
+
+class ThreadStatBlock {
+   public:
+    ThreadStatBlock() {
+        StatRegistry &reg = registry();
+        std::lock_guard<std::mutex> _blck(reg.lock);
+        reg.blocks.push_back(&m_block);
+    }
+
+    ~ThreadStatBlock() {
+        StatRegistry &reg = registry();
+        std::lock_guard<std::mutex> _blck(reg.lock);
+        m_block.merge_into(reg.retired);
+        reg.blocks.erase(
+            std::remove(reg.blocks.begin(), reg.blocks.end(), &m_block),
+            reg.blocks.end());
+    }
+
+    StatBlock &block() {
+        return m_block;
+    }
+
+   private:
+    StatBlock m_block;
+};
+
+StatBlock &thread_block() {
+    static thread_local ThreadStatBlock block;
+    return block.block();
+}
+
+void collect_locked(StatBlock &out) {
+    StatRegistry &reg = registry();
+    reg.retired.merge_into(out);
+    for (auto iter = reg.blocks.begin(); iter != reg.blocks.end(); ++iter) {
+        (*iter)->merge_into(out);
+    }
+}
+
+uint64_t bucket_limit(size_t bucket) {
+    return (uint64_t)1 << bucket;
+}
+
+// returns the upper bound of the bucket that contains the given quantile.
+uint64_t quantile(const std::atomic<uint64_t> *buckets,
+                  uint64_t count,
+                  double q) {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(count * q);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < SENTRY_STATS_BUCKETS; i++) {
+        seen += buckets[i].load();
+        if (seen > rank) {
+            return bucket_limit(i);
+        }
+    }
+    return bucket_limit(SENTRY_STATS_BUCKETS - 1);
+}
+}  // namespace
+
+const char *sentry::stat_counter_name(StatCounter counter) {
+    switch (counter) {
+        case STAT_EVENTS_CAPTURED:
+            return "events_captured";
+        case STAT_EVENTS_SAMPLED_OUT:
+            return "events_sampled_out";
+        case STAT_EVENTS_DUPLICATE:
+            return "events_duplicate";
+        case STAT_EVENTS_DROPPED:
+            return "events_dropped";
+        case STAT_EVENTS_FILTERED:
+            return "events_filtered";
+        case STAT_REQUESTS_SENT:
+            return "requests_sent";
+        case STAT_REQUESTS_FAILED:
+            return "requests_failed";
+        case STAT_REQUESTS_RATE_LIMITED:
+            return "requests_rate_limited";
+        case STAT_BYTES_SENT:
+            return "bytes_sent";
+        case STAT_HTTP_2XX:
+            return "http_2xx";
+        case STAT_HTTP_3XX:
+            return "http_3xx";
+        case STAT_HTTP_4XX:
+            return "http_4xx";
+        case STAT_HTTP_5XX:
+            return "http_5xx";
+        default:
+            return "unknown";
+    }
+}
+
+const char *sentry::stat_timer_name(StatTimer timer) {
+    switch (timer) {
+        case STAT_TIMER_CAPTURE:
+            return "capture";
+        case STAT_TIMER_APPLY_SCOPE:
+            return "apply_scope";
+        case STAT_TIMER_SERIALIZE:
+            return "serialize";
+        case STAT_TIMER_REQUEST:
+            return "request";
+        default:
+            return "unknown";
+    }
+}
+
+void sentry::stat_add(StatCounter counter, uint64_t value) {
+    StatBlock::bump(thread_block().counters[counter], value);
+}
+
+void sentry::stat_record(StatTimer timer, uint64_t micros) {
+    size_t bucket = 0;
+    while (bucket < SENTRY_STATS_BUCKETS - 1 && micros >= bucket_limit(bucket)) {
+        bucket++;
+    }
+    StatBlock &block = thread_block();
+    StatBlock::bump(block.buckets[timer][bucket], 1);
+    StatBlock::bump(block.timer_sum[timer], micros);
+}
+
+void sentry::stat_record_http_status(long status) {
+    if (status >= 200 && status < 300) {
+        stat_add(STAT_HTTP_2XX);
+    } else if (status >= 300 && status < 400) {
+        stat_add(STAT_HTTP_3XX);
+    } else if (status >= 400 && status < 500) {
+        stat_add(STAT_HTTP_4XX);
+    } else if (status >= 500 && status < 600) {
+        stat_add(STAT_HTTP_5XX);
+    }
+}
+
+uint64_t sentry::stat_total(StatCounter counter) {
+    StatRegistry &reg = registry();
+    std::lock_guard<std::mutex> _blck(reg.lock);
+    uint64_t rv = reg.retired.counters[counter].load();
+    for (auto iter = reg.blocks.begin(); iter != reg.blocks.end(); ++iter) {
+        rv += (*iter)->counters[counter].load();
+    }
+    return rv;
+}
+
+Value sentry::collect_stats() {
+    StatBlock totals;
+    {
+        std::lock_guard<std::mutex> _blck(registry().lock);
+        collect_locked(totals);
+    }
+
+    Value counters = Value::new_object();
+    for (size_t i = 0; i < STAT_COUNTER_COUNT; i++) {
+        counters.set_by_key(stat_counter_name((StatCounter)i),
+                            Value::new_double((double)totals.counters[i]));
+    }
+
+    Value timers = Value::new_object();
+    for (size_t i = 0; i < STAT_TIMER_COUNT; i++) {
+        uint64_t count = 0;
+        Value buckets = Value::new_list();
+        for (size_t j = 0; j < SENTRY_STATS_BUCKETS; j++) {
+            count += totals.buckets[i][j];
+            buckets.append(Value::new_double((double)totals.buckets[i][j]));
+        }
+        Value timer = Value::new_object();
+        timer.set_by_key("count", Value::new_double((double)count));
+        timer.set_by_key("sum_us",
+                         Value::new_double((double)totals.timer_sum[i]));
+        timer.set_by_key(
+            "p50_us",
+            Value::new_double((double)quantile(totals.buckets[i], count, 0.5)));
+        timer.set_by_key("p99_us",
+                         Value::new_double(
+                             (double)quantile(totals.buckets[i], count, 0.99)));
+        timer.set_by_key("buckets", buckets);
+        timers.set_by_key(stat_timer_name((StatTimer)i), timer);
+    }
+
+    Value rv = Value::new_object();
+    rv.set_by_key("counters", counters);
+    rv.set_by_key("timers", timers);
+    return rv;
+}
@@ -0,0 +1,78 @@
+#ifndef SENTRY_STATS_HPP_INCLUDED
+#define SENTRY_STATS_HPP_INCLUDED
+
+#include <stdint.h>
+#include <chrono>
+
+#include "internal.hpp"
+#include "value.hpp"
+
+namespace sentry {
+
+enum StatCounter {
+    STAT_EVENTS_CAPTURED,
+    STAT_EVENTS_SAMPLED_OUT,
+    STAT_EVENTS_DUPLICATE,
+    STAT_EVENTS_DROPPED,
+    STAT_EVENTS_FILTERED,
+    STAT_REQUESTS_SENT,
+    STAT_REQUESTS_FAILED,
+    STAT_REQUESTS_RATE_LIMITED,
+    STAT_BYTES_SENT,
+    STAT_HTTP_2XX,
+    STAT_HTTP_3XX,
+    STAT_HTTP_4XX,
+    STAT_HTTP_5XX,
+    STAT_COUNTER_COUNT,
+};
+
+enum StatTimer {
+    STAT_TIMER_CAPTURE,
+    STAT_TIMER_APPLY_SCOPE,
+    STAT_TIMER_SERIALIZE,
+    STAT_TIMER_REQUEST,
+    STAT_TIMER_COUNT,
+};
+
+// bucket `i` of a timer histogram counts durations below 2^i microseconds,
+// the last bucket everything above.
+#define SENTRY_STATS_BUCKETS 24
+
+const char *stat_counter_name(StatCounter counter);
+const char *stat_timer_name(StatTimer timer);
+
+// Counters and histograms live in per-thread blocks that are only written
+// by their owning thread, so recording never takes a lock or a locked
+// instruction.  Reading sums up all blocks.
+void stat_add(StatCounter counter, uint64_t value = 1);
+void stat_record(StatTimer timer, uint64_t micros);
+void stat_record_http_status(long status);
+
+uint64_t stat_total(StatCounter counter);
+
+// returns all counters and histograms as an object.
+Value collect_stats();
+
+// records the lifetime of the object into a timer histogram.
+class ScopedStatTimer {
+   public:
+    explicit ScopedStatTimer(StatTimer timer)
+        : m_timer(timer), m_start(std::chrono::steady_clock::now()) {
+    }
+
+    ~ScopedStatTimer() {
+        stat_record(
+            m_timer,
+            (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - m_start)
+                .count());
+    }
+
+   private:
+    StatTimer m_timer;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+}  // namespace sentry
+
+#endif
@@ -19,6 +19,9 @@ void Transport::start() {
 void Transport::shutdown() {
 }
 
+void Transport::report_stats(Value &) {
+}
+
 void Transport::send_event(Value event) {
     send_envelope(Envelope(event));
 }
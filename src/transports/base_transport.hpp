@@ -19,6 +19,9 @@ class Transport {
     virtual void send_event(sentry::Value event);
     virtual void send_envelope(Envelope envelope) = 0;
 
+    // adds transport specific gauges such as queue depths to `stats`.
+    virtual void report_stats(Value &stats);
+
    private:
     Transport(const Transport &) = delete;
     Transport &operator=(Transport &) = delete;
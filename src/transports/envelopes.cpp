@@ -1,43 +1,57 @@
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "envelopes.hpp"
 #include "../options.hpp"
+#include "../stats.hpp"
 
 using namespace sentry;
 using namespace transports;
 
 EnvelopeItem::EnvelopeItem()
-    : m_is_event(false), m_headers(Value::new_object()) {
+    : m_headers(Value::new_object()),
+      m_is_event(false),
+      m_is_file(false),
+      m_file_offset(0),
+      m_file_len(0) {
 }
 
 EnvelopeItem::EnvelopeItem(Value event) : EnvelopeItem() {
     m_is_event = true;
     m_event = event;
-    m_bytes = m_event.to_json();
+    {
+        ScopedStatTimer timer(STAT_TIMER_SERIALIZE);
+        m_bytes = m_event.to_json();
+    }
     m_headers.set_by_key("length", Value::new_int32((int32_t)m_bytes.size()));
     m_headers.set_by_key("type", Value::new_string("event"));
 }
 
-EnvelopeItem::EnvelopeItem(const sentry::Path &path, const char *type)
+EnvelopeItem::EnvelopeItem(const sentry::Path &path,
+                           const char *type,
+                           size_t max_size)
     : EnvelopeItem() {
-    std::string rv;
-    m_bytes.clear();
-    m_path = path;
-    FILE *f = path.open("rb");
-    char buf[4096];
-    if (!f) {
-        return;
-    }
-
-    while (true) {
-        size_t read = fread(buf, 1, sizeof(buf), f);
-        if (!read) {
-            break;
+    size_t size = 0;
+    if (path.get_size(&size)) {
+        m_is_file = true;
+        m_path = path;
+        m_file_len = size;
+        // for things like log files the end is the interesting part, so
+        // we cut off the head of oversized files.
+        if (max_size && size > max_size) {
+            m_file_offset = size - max_size;
+            m_file_len = max_size;
+            SENTRY_LOGF("truncating attachment of %llu bytes to %llu bytes",
+                        (unsigned long long)size,
+                        (unsigned long long)max_size);
         }
-        m_bytes.append(buf, read);
     }
 
-    fclose(f);
-
-    m_headers.set_by_key("length", Value::new_int32((int32_t)m_bytes.size()));
+    m_headers.set_by_key("length", Value::new_int32((int32_t)m_file_len));
     m_headers.set_by_key("type", Value::new_string(type));
 }
 
@@ -48,10 +62,34 @@ EnvelopeItem::EnvelopeItem(const char *bytes, size_t length, const char *type)
     m_headers.set_by_key("type", Value::new_string(type));
 }
 
+EnvelopeItem::EnvelopeItem(const EnvelopeItemView &view) : EnvelopeItem() {
+    m_headers = view.headers.clone();
+    m_bytes = std::string(view.payload, view.payload_len);
+    m_is_event = strcmp(view.type(), "event") == 0;
+    m_headers.set_by_key("length", Value::new_int32((int32_t)m_bytes.size()));
+}
+
+void EnvelopeItem::append_payload_to(RequestBody &body) const {
+    if (m_is_file) {
+        body.append_file(m_path, m_file_offset, m_file_len);
+    } else {
+        body.append_ref(m_bytes);
+    }
+}
+
 void EnvelopeItem::serialize_into(IoWriter &writer) const {
     m_headers.to_json(writer);
     writer.write_char('\n');
-    writer.write_str(m_bytes);
+    if (m_is_file) {
+        RequestBody body;
+        append_payload_to(body);
+        char buf[4096];
+        while (size_t len = body.read(buf, sizeof(buf))) {
+            writer.write(buf, len);
+        }
+    } else {
+        writer.write_str(m_bytes);
+    }
     writer.write_char('\n');
 }
 
@@ -60,7 +98,7 @@ void EnvelopeItem::set_header(const char *key, sentry::Value value) {
 }
 
 size_t EnvelopeItem::length() const {
-    return m_bytes.size();
+    return m_is_file ? m_file_len : m_bytes.size();
 }
 
 bool EnvelopeItem::is_event() const {
@@ -68,6 +106,10 @@ bool EnvelopeItem::is_event() const {
 }
 
 Value EnvelopeItem::get_event() const {
+    if (m_is_event && m_event.is_null() &&
+        !Value::from_json(m_bytes.c_str(), m_bytes.size(), &m_event)) {
+        SENTRY_LOG("failed to parse event item");
+    }
     return m_event;
 }
 
@@ -131,6 +173,25 @@ Envelope::Envelope(Value event) : Envelope() {
     add_item(EnvelopeItem(event));
 }
 
+bool Envelope::deserialize(EnvelopeReader &reader, Envelope *envelope_out) {
+    Envelope envelope;
+    if (!reader.read_headers(&envelope.m_headers) ||
+        envelope.m_headers.type() != SENTRY_VALUE_TYPE_OBJECT) {
+        return false;
+    }
+
+    EnvelopeItemView view;
+    while (reader.next(&view)) {
+        envelope.add_item(EnvelopeItem(view));
+    }
+    if (reader.failed()) {
+        return false;
+    }
+
+    *envelope_out = envelope;
+    return true;
+}
+
 void Envelope::set_header(const char *key, sentry::Value value) {
     m_headers.set_by_key(key, value);
 }
@@ -161,11 +222,147 @@ Value Envelope::get_event() const {
     return sentry::Value();
 }
 
+RequestBody::RequestBody()
+    : m_size(0), m_segment(0), m_segment_offset(0), m_file(nullptr) {
+}
+
+RequestBody::RequestBody(RequestBody &&other) : RequestBody() {
+    *this = std::move(other);
+}
+
+RequestBody &RequestBody::operator=(RequestBody &&other) {
+    if (this != &other) {
+        close_file();
+        m_segments = std::move(other.m_segments);
+        m_size = other.m_size;
+        m_segment = other.m_segment;
+        m_segment_offset = other.m_segment_offset;
+        m_file = other.m_file;
+        other.m_segments.clear();
+        other.m_size = 0;
+        other.m_segment = 0;
+        other.m_segment_offset = 0;
+        other.m_file = nullptr;
+    }
+    return *this;
+}
+
+RequestBody::~RequestBody() {
+    close_file();
+}
+
+void RequestBody::append(std::string data) {
+    Segment segment;
+    segment.len = data.size();
+    segment.owned = std::move(data);
+    segment.ref = nullptr;
+    segment.is_file = false;
+    m_size += segment.len;
+    m_segments.push_back(std::move(segment));
+}
+
+void RequestBody::append_ref(const char *buf, size_t len) {
+    Segment segment;
+    segment.ref = buf;
+    segment.is_file = false;
+    segment.len = len;
+    m_size += len;
+    m_segments.push_back(std::move(segment));
+}
+
+void RequestBody::append_file(const sentry::Path &path,
+                              size_t offset,
+                              size_t len) {
+    Segment segment;
+    segment.ref = nullptr;
+    segment.is_file = true;
+    segment.path = path;
+    segment.file_offset = offset;
+    segment.len = len;
+    m_size += len;
+    m_segments.push_back(std::move(segment));
+}
+
+void RequestBody::append_body(RequestBody &&other) {
+    for (Segment &segment : other.m_segments) {
+        m_size += segment.len;
+        m_segments.push_back(std::move(segment));
+    }
+    other = RequestBody();
+}
+
+void RequestBody::close_file() {
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+size_t RequestBody::read_file(const Segment &segment, char *buf, size_t len) {
+    if (!m_file) {
+        m_file = segment.path.open("rb");
+        if (m_file && fseek(m_file,
+                            (long)(segment.file_offset + m_segment_offset),
+                            SEEK_SET) != 0) {
+            close_file();
+        }
+    }
+
+    size_t read = m_file ? fread(buf, 1, len, m_file) : 0;
+    // the envelope promised a certain length, so if the file shrunk or
+    // went away in the meantime we pad the rest.
+    if (read < len) {
+        memset(buf + read, 0, len - read);
+    }
+    return len;
+}
+
+size_t RequestBody::read(char *buf, size_t len) {
+    size_t written = 0;
+    while (written < len && m_segment < m_segments.size()) {
+        const Segment &segment = m_segments[m_segment];
+        size_t to_copy =
+            std::min(segment.len - m_segment_offset, len - written);
+        if (segment.is_file) {
+            read_file(segment, buf + written, to_copy);
+        } else {
+            memcpy(buf + written, segment.data() + m_segment_offset, to_copy);
+        }
+        written += to_copy;
+        m_segment_offset += to_copy;
+        if (m_segment_offset == segment.len) {
+            close_file();
+            m_segment++;
+            m_segment_offset = 0;
+        }
+    }
+    return written;
+}
+
+bool RequestBody::seek(size_t offset) {
+    if (offset > m_size) {
+        return false;
+    }
+    close_file();
+    m_segment = 0;
+    m_segment_offset = 0;
+    while (m_segment < m_segments.size() &&
+           offset >= m_segments[m_segment].len) {
+        offset -= m_segments[m_segment].len;
+        m_segment++;
+    }
+    m_segment_offset = offset;
+    return true;
+}
+
+PreparedHttpRequest::PreparedHttpRequest() : method("POST") {
+}
+
 PreparedHttpRequest::PreparedHttpRequest(const sentry_uuid_t *event_id,
                                          EndpointType endpoint_type,
                                          const char *content_type,
-                                         const std::string &payload)
-    : method("POST"), payload(payload) {
+                                         RequestBody &&body)
+    : method("POST"), body(std::move(body)) {
     const sentry_options_t *options = sentry_get_options();
 
     if (!options->dsn.disabled()) {
@@ -174,7 +371,7 @@ PreparedHttpRequest::PreparedHttpRequest(const sentry_uuid_t *event_id,
     }
     headers.push_back(std::string("content-type:") + content_type);
     headers.push_back(std::string("content-length:") +
-                      std::to_string(payload.size()));
+                      std::to_string(this->body.size()));
 
     switch (endpoint_type) {
         case ENDPOINT_TYPE_STORE:
@@ -190,18 +387,70 @@ PreparedHttpRequest::PreparedHttpRequest(const sentry_uuid_t *event_id,
     }
 }
 
+RequestBody PreparedHttpRequest::into_record() {
+    std::string meta = url;
+    for (const std::string &header : headers) {
+        meta.push_back('\n');
+        meta.append(header);
+    }
+
+    uint32_t meta_len = (uint32_t)meta.size();
+    RequestBody record;
+    record.append(std::string((const char *)&meta_len, sizeof(meta_len)));
+    record.append(std::move(meta));
+    record.append_body(std::move(body));
+    return record;
+}
+
+bool PreparedHttpRequest::read_record(const sentry::Path &path,
+                                      size_t offset,
+                                      size_t len) {
+    FILE *f = path.open("rb");
+    if (!f) {
+        return false;
+    }
+
+    uint32_t meta_len = 0;
+    std::string meta;
+    bool ok = len >= sizeof(meta_len) &&
+              fseek(f, (long)offset, SEEK_SET) == 0 &&
+              fread(&meta_len, sizeof(meta_len), 1, f) == 1 &&
+              meta_len <= len - sizeof(meta_len);
+    if (ok && meta_len) {
+        meta.resize(meta_len);
+        ok = fread(&meta[0], 1, meta_len, f) == meta_len;
+    }
+    fclose(f);
+    if (!ok) {
+        return false;
+    }
+
+    std::istringstream iss(meta);
+    std::getline(iss, url);
+    headers.clear();
+    for (std::string header; std::getline(iss, header);) {
+        headers.push_back(header);
+    }
+
+    size_t body_offset = offset + sizeof(meta_len) + meta_len;
+    body = RequestBody();
+    body.append_file(path, body_offset, len - sizeof(meta_len) - meta_len);
+    return true;
+}
+
 void Envelope::for_each_request(
     std::function<bool(PreparedHttpRequest &&)> func) const {
-    // this is super inefficient
     sentry_uuid_t event_id = this->event_id();
     std::vector<const EnvelopeItem *> attachments;
     const EnvelopeItem *minidump = nullptr;
 
     for (auto iter = m_items.begin(); iter != m_items.end(); ++iter) {
         if (iter->is_event()) {
-            if (!func(std::move(
-                    PreparedHttpRequest(&event_id, ENDPOINT_TYPE_STORE,
-                                        "application/json", iter->bytes())))) {
+            RequestBody body;
+            iter->append_payload_to(body);
+            if (!func(PreparedHttpRequest(&event_id, ENDPOINT_TYPE_STORE,
+                                          "application/json",
+                                          std::move(body)))) {
                 return;
             }
         } else if (iter->is_attachment()) {
@@ -226,24 +475,27 @@ void Envelope::for_each_request(
     sentry_uuid_as_string(&boundary_id, boundary);
     strcat(boundary, "-boundary-");
 
-    std::stringstream payload_ss;
-
+    // the multipart body only consists of the small boundary and header
+    // segments plus references to the item payloads.
+    RequestBody body;
     for (auto iter = attachments.begin(); iter != attachments.end(); ++iter) {
-        payload_ss << "--" << boundary << "\r\n";
-        payload_ss << "content-type:" << (**iter).content_type() << "\r\n";
-        payload_ss << "content-disposition:form-data;name=\"" << (**iter).name()
-                   << "\";filename=\"" << (**iter).filename() << "\"\r\n\r\n";
-        payload_ss << (**iter).bytes() << "\r\n";
+        std::stringstream part_ss;
+        part_ss << "--" << boundary << "\r\n";
+        part_ss << "content-type:" << (**iter).content_type() << "\r\n";
+        part_ss << "content-disposition:form-data;name=\"" << (**iter).name()
+                << "\";filename=\"" << (**iter).filename() << "\"\r\n\r\n";
+        body.append(part_ss.str());
+        (**iter).append_payload_to(body);
+        body.append("\r\n");
     }
-    payload_ss << "--" << boundary << "--";
+    body.append(std::string("--") + boundary + "--");
 
     std::stringstream content_type_ss;
     content_type_ss << "multipart/form-data;boundary=\"" << boundary << "\"";
     std::string content_type = content_type_ss.str();
-    std::string payload = payload_ss.str();
 
-    func(std::move(PreparedHttpRequest(&event_id, ENDPOINT_TYPE_STORE,
-                                       content_type.c_str(), payload)));
+    func(PreparedHttpRequest(&event_id, endpoint_type, content_type.c_str(),
+                             std::move(body)));
 }
 
 char *Envelope::serialize(size_t *size_out) const {
@@ -252,3 +504,157 @@ char *Envelope::serialize(size_t *size_out) const {
     *size_out = writer.len();
     return writer.take();
 }
+
+const char *EnvelopeItemView::type() const {
+    const char *type = headers.get_by_key("type").as_cstr();
+    return type ? type : "";
+}
+
+bool EnvelopeItemView::parse_payload(Value *value_out) const {
+    return Value::from_json(payload, payload_len, value_out);
+}
+
+EnvelopeReader::EnvelopeReader() : m_mapping(nullptr), m_mapping_size(0) {
+#ifdef _WIN32
+    m_mapping_handle = nullptr;
+#endif
+    reset("", 0);
+}
+
+EnvelopeReader::EnvelopeReader(const char *buf, size_t len)
+    : EnvelopeReader() {
+    reset(buf, len);
+}
+
+EnvelopeReader::~EnvelopeReader() {
+    unmap();
+}
+
+void EnvelopeReader::reset(const char *buf, size_t len) {
+    m_buf = buf;
+    m_len = len;
+    const char *newline = (const char *)memchr(buf, '\n', len);
+    m_headers_len = newline ? newline - buf : len;
+    m_pos = newline ? m_headers_len + 1 : len;
+    m_failed = false;
+}
+
+bool EnvelopeReader::open_file(const sentry::Path &path) {
+    unmap();
+    reset("", 0);
+
+    size_t size;
+    if (!path.get_size(&size)) {
+        return false;
+    }
+    if (size == 0) {
+        return true;
+    }
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.as_osstr(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    m_mapping_handle =
+        CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!m_mapping_handle) {
+        return false;
+    }
+    m_mapping = MapViewOfFile(m_mapping_handle, FILE_MAP_READ, 0, 0, size);
+    if (!m_mapping) {
+        CloseHandle(m_mapping_handle);
+        m_mapping_handle = nullptr;
+        return false;
+    }
+#else
+    int fd = open(path.as_osstr(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    m_mapping = mapping;
+#endif
+
+    m_mapping_size = size;
+    reset((const char *)m_mapping, size);
+    return true;
+}
+
+void EnvelopeReader::unmap() {
+    if (!m_mapping) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(m_mapping);
+    CloseHandle(m_mapping_handle);
+    m_mapping_handle = nullptr;
+#else
+    munmap(m_mapping, m_mapping_size);
+#endif
+    m_mapping = nullptr;
+}
+
+bool EnvelopeReader::read_headers(Value *headers_out) const {
+    if (m_headers_len == 0) {
+        *headers_out = Value::new_object();
+        return true;
+    }
+    return Value::from_json(m_buf, m_headers_len, headers_out);
+}
+
+bool EnvelopeReader::next(EnvelopeItemView *item_out) {
+    if (m_failed || m_pos >= m_len) {
+        return false;
+    }
+
+    const char *start = m_buf + m_pos;
+    size_t remaining = m_len - m_pos;
+    const char *newline = (const char *)memchr(start, '\n', remaining);
+    size_t header_len = newline ? newline - start : remaining;
+    if (header_len == 0) {
+        // trailing newlines at the end of the envelope
+        m_pos = m_len;
+        return false;
+    }
+
+    Value headers;
+    if (!Value::from_json(start, header_len, &headers) ||
+        headers.type() != SENTRY_VALUE_TYPE_OBJECT) {
+        m_failed = true;
+        return false;
+    }
+
+    size_t payload_pos = m_pos + header_len + (newline ? 1 : 0);
+    size_t payload_len;
+    Value length = headers.get_by_key("length");
+    if (length.type() == SENTRY_VALUE_TYPE_INT32) {
+        payload_len = (size_t)length.as_int32();
+        if (length.as_int32() < 0 || payload_len > m_len - payload_pos) {
+            m_failed = true;
+            return false;
+        }
+    } else {
+        // without a length the payload extends to the end of the line
+        const char *end = (const char *)memchr(m_buf + payload_pos, '\n',
+                                               m_len - payload_pos);
+        payload_len = end ? end - (m_buf + payload_pos) : m_len - payload_pos;
+    }
+
+    item_out->headers = headers;
+    item_out->payload = m_buf + payload_pos;
+    item_out->payload_len = payload_len;
+
+    m_pos = payload_pos + payload_len;
+    if (m_pos < m_len && m_buf[m_pos] == '\n') {
+        m_pos++;
+    }
+    return true;
+}
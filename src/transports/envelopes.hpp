@@ -19,23 +19,155 @@ enum EndpointType {
     ENDPOINT_TYPE_ATTACHMENT,
 };
 
+/* a request body made up of segments.
+
+   Segments either own small pieces of data (like multipart boundaries),
+   reference buffers owned by the envelope or refer to a range of a file
+   that is only read while the body is consumed.  Large payloads are thus
+   never copied into the body.  The body must not outlive the envelope it
+   was created from. */
+class RequestBody {
+   public:
+    RequestBody();
+    RequestBody(RequestBody &&other);
+    RequestBody &operator=(RequestBody &&other);
+    ~RequestBody();
+
+    void append(std::string data);
+    void append_ref(const char *buf, size_t len);
+    void append_ref(const std::string &data) {
+        append_ref(data.c_str(), data.size());
+    }
+    void append_file(const sentry::Path &path, size_t offset, size_t len);
+    void append_body(RequestBody &&other);
+
+    size_t size() const {
+        return m_size;
+    }
+
+    /* copies up to `len` bytes from the current read position into `buf`
+       and returns the number of bytes copied.  0 means the end was hit. */
+    size_t read(char *buf, size_t len);
+    bool seek(size_t offset);
+
+   private:
+    RequestBody(const RequestBody &) = delete;
+    RequestBody &operator=(const RequestBody &) = delete;
+
+    struct Segment {
+        std::string owned;
+        const char *ref;
+        bool is_file;
+        sentry::Path path;
+        size_t file_offset;
+        size_t len;
+
+        const char *data() const {
+            return ref ? ref : owned.c_str();
+        }
+    };
+
+    size_t read_file(const Segment &segment, char *buf, size_t len);
+    void close_file();
+
+    std::vector<Segment> m_segments;
+    size_t m_size;
+    size_t m_segment;
+    size_t m_segment_offset;
+    FILE *m_file;
+};
+
 /* type of the payload envelope */
 struct PreparedHttpRequest {
     std::string url;
     const char *method;
     std::vector<std::string> headers;
-    std::string payload;
+    RequestBody body;
 
+    PreparedHttpRequest();
     PreparedHttpRequest(const sentry_uuid_t *event_id,
                         EndpointType endpoint_type,
                         const char *content_type,
-                        const std::string &payload);
+                        RequestBody &&body);
+
+    // converts the request into a self-contained record that can be
+    // persisted.  The body is moved into the record.
+    RequestBody into_record();
+
+    // restores a request from a record stored at `offset` in a file.  The
+    // body is read from the file when it is consumed.
+    bool read_record(const sentry::Path &path, size_t offset, size_t len);
+};
+
+// a view of an item inside of a serialized envelope.  The payload points
+// into the buffer the envelope is read from.
+struct EnvelopeItemView {
+    sentry::Value headers;
+    const char *payload;
+    size_t payload_len;
+
+    const char *type() const;
+    // parses the payload as JSON, which is how event items are stored.
+    bool parse_payload(sentry::Value *value_out) const;
+};
+
+// reads serialized envelopes without copying them.
+//
+// Items are handed out one at a time as views into the input, which is
+// either a buffer owned by the caller or a file that is mapped into memory.
+// Only the small header lines are parsed while reading, payloads are left
+// alone until they are explicitly asked for.
+class EnvelopeReader {
+   public:
+    EnvelopeReader();
+    EnvelopeReader(const char *buf, size_t len);
+    ~EnvelopeReader();
+
+    bool open_file(const sentry::Path &path);
+
+    // parses the envelope headers.
+    bool read_headers(sentry::Value *headers_out) const;
+    // returns the next item.  Once this returns `false`, `failed` tells
+    // whether the end of the envelope was reached or it was malformed.
+    bool next(EnvelopeItemView *item_out);
+    bool failed() const {
+        return m_failed;
+    }
+
+   private:
+    EnvelopeReader(const EnvelopeReader &) = delete;
+    EnvelopeReader &operator=(const EnvelopeReader &) = delete;
+
+    void reset(const char *buf, size_t len);
+    void unmap();
+
+    const char *m_buf;
+    size_t m_len;
+    size_t m_headers_len;
+    size_t m_pos;
+    bool m_failed;
+    void *m_mapping;
+    size_t m_mapping_size;
+#ifdef _WIN32
+    HANDLE m_mapping_handle;
+#endif
 };
 
 class EnvelopeItem {
    public:
     EnvelopeItem(sentry::Value event);
-    EnvelopeItem(const sentry::Path &path, const char *type = "attachment");
+    // copies an item out of a serialized envelope.  Event payloads are only
+    // parsed once the event is requested.
+    EnvelopeItem(const EnvelopeItemView &view);
+
+    /* creates an item backed by a file.
+
+       Only the size of the file is recorded here, the contents are read
+       when the envelope is serialized or uploaded.  If `max_size` is not 0
+       and the file is larger, only the last `max_size` bytes are sent. */
+    EnvelopeItem(const sentry::Path &path,
+                 const char *type = "attachment",
+                 size_t max_size = 0);
     EnvelopeItem(const char *bytes,
                  size_t length,
                  const char *type = "attachment");
@@ -50,10 +182,14 @@ class EnvelopeItem {
     const char *content_type() const;
     sentry::Value get_event() const;
     size_t length() const;
+    bool is_file() const {
+        return m_is_file;
+    }
     const std::string &bytes() const {
         return m_bytes;
     }
 
+    void append_payload_to(RequestBody &body) const;
     void serialize_into(IoWriter &writer) const;
 
    protected:
@@ -61,8 +197,11 @@ class EnvelopeItem {
 
     sentry::Value m_headers;
     bool m_is_event;
-    sentry::Value m_event;
+    mutable sentry::Value m_event;
+    bool m_is_file;
     sentry::Path m_path;
+    size_t m_file_offset;
+    size_t m_file_len;
     std::string m_bytes;
 };
 
@@ -70,6 +209,11 @@ class Envelope {
    public:
     Envelope();
     Envelope(sentry::Value event);
+
+    // reads a serialized envelope.  Payloads are copied so that the
+    // envelope does not depend on the reader's input.
+    static bool deserialize(EnvelopeReader &reader, Envelope *envelope_out);
+
     sentry::Value get_event() const;
 
     void set_header(const char *key, sentry::Value value);
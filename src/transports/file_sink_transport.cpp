@@ -0,0 +1,318 @@
+#include <stdio.h>
+
+#include "../sampling.hpp"
+#include "../stats.hpp"
+
+#include "file_sink_transport.hpp"
+
+using namespace sentry;
+using namespace transports;
+
+static const char *PART_SUFFIX = ".part";
+static const char *LOCK_SUFFIX = ".lock";
+static const size_t LOCK_ATTEMPTS = 4;
+
+// whether `name` is a file of the writer whose files start with `prefix`.
+template <typename Char>
+static bool has_writer_prefix(const Char *name, const Char *prefix) {
+    for (; *prefix; name++, prefix++) {
+        if (*name != *prefix) {
+            return false;
+        }
+    }
+    return *name == '-';
+}
+
+FileSinkTransport::FileSinkTransport(const Path &directory,
+                                     const FileSinkPolicy &policy)
+    : m_directory(directory),
+      m_policy(policy),
+      m_running(false),
+      m_stopping(false),
+      m_files_written(0),
+      m_writer_id(0),
+      m_file_size(0),
+      m_file_counter(0) {
+}
+
+FileSinkTransport::~FileSinkTransport() {
+    shutdown();
+}
+
+void FileSinkTransport::start() {
+    if (m_running) {
+        return;
+    }
+    if (!m_directory.create_directories()) {
+        SENTRY_LOG("failed to create file sink directory");
+    }
+    if (!lock_writer()) {
+        SENTRY_LOG("failed to lock file sink writer");
+    }
+    finish_leftover_files();
+    m_running = true;
+    m_stopping = false;
+    m_thread = std::thread([this]() { run(); });
+}
+
+void FileSinkTransport::shutdown() {
+    if (!m_running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> _blck(m_lock);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+    if (m_writer_lock.is_locked()) {
+        m_writer_lock.unlock();
+        m_lock_path.remove();
+    }
+    m_running = false;
+}
+
+bool FileSinkTransport::lock_writer() {
+    // the writer id keeps the names of concurrent writers to the same
+    // directory apart.
+    for (size_t i = 0; i < LOCK_ATTEMPTS; i++) {
+        m_writer_id = (uint32_t)fast_random();
+        char name[32];
+        snprintf(name, sizeof(name), "%08x%s", m_writer_id, LOCK_SUFFIX);
+        m_lock_path = m_directory.join(name);
+        if (m_writer_lock.try_lock(m_lock_path)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void FileSinkTransport::send_envelope(Envelope envelope) {
+    QueuedEnvelope queued;
+    {
+        MemoryIoWriter writer;
+        envelope.serialize_into(writer);
+        queued.data.assign(writer.buf(), writer.len());
+    }
+    sentry_uuid_t event_id = envelope.event_id();
+    char event_id_str[40];
+    sentry_uuid_as_string(&event_id, event_id_str);
+    queued.event_id = event_id_str;
+
+    {
+        std::lock_guard<std::mutex> _blck(m_lock);
+        if (m_queue.size() >= m_policy.max_queued) {
+            stat_add(STAT_EVENTS_DROPPED);
+            return;
+        }
+        m_queue.push_back(std::move(queued));
+    }
+    m_wake.notify_one();
+}
+
+void FileSinkTransport::report_stats(Value &stats) {
+    size_t queued;
+    {
+        std::lock_guard<std::mutex> _blck(m_lock);
+        queued = m_queue.size();
+    }
+    stats.set_by_key("queue_depth", Value::new_double((double)queued));
+    stats.set_by_key("files_written",
+                     Value::new_double((double)m_files_written.load()));
+}
+
+void FileSinkTransport::run() {
+    std::vector<QueuedEnvelope> batch;
+    for (;;) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            auto ready = [this]() { return m_stopping || !m_queue.empty(); };
+            if (m_data.is_closed()) {
+                m_wake.wait(lock, ready);
+            } else {
+                m_wake.wait_until(lock, m_opened_at + m_policy.max_file_age,
+                                  ready);
+            }
+            batch.swap(m_queue);
+            stopping = m_stopping;
+        }
+
+        if (!batch.empty()) {
+            write_batch(batch);
+            batch.clear();
+        }
+        if (!m_data.is_closed() &&
+            Clock::now() >= m_opened_at + m_policy.max_file_age) {
+            finish_file();
+        }
+        if (stopping) {
+            break;
+        }
+    }
+    finish_file();
+}
+
+void FileSinkTransport::write_batch(std::vector<QueuedEnvelope> &batch) {
+    size_t start = 0;
+    while (start < batch.size()) {
+        if (m_data.is_closed() && !open_file()) {
+            SENTRY_LOG("failed to open file sink, dropping envelopes");
+            stat_add(STAT_EVENTS_DROPPED, batch.size() - start);
+            return;
+        }
+
+        // take as many envelopes as fit into the current file.  A file
+        // always takes at least one envelope, even if it is oversized.
+        size_t end = start;
+        size_t size = m_file_size;
+        while (end < batch.size() &&
+               (size == 0 ||
+                size + batch[end].data.size() <= m_policy.max_file_size)) {
+            size += batch[end].data.size();
+            end++;
+        }
+
+        size_t written = write_envelopes(batch, start, end);
+        if (written < end - start) {
+            // the file may end in a partial write, which the next one must
+            // not be appended to.
+            SENTRY_LOG("failed to write to file sink, dropping envelopes");
+            stat_add(STAT_EVENTS_DROPPED, end - start - written);
+            finish_file();
+        }
+        start = end;
+        if (start < batch.size()) {
+            finish_file();
+        }
+    }
+}
+
+size_t FileSinkTransport::write_envelopes(
+    const std::vector<QueuedEnvelope> &batch,
+    size_t start,
+    size_t end) {
+    ScopedStatTimer timer(STAT_TIMER_REQUEST);
+    bool per_envelope = m_policy.sync == SENTRY_FILE_SINK_SYNC_ENVELOPE;
+
+    std::vector<IoSlice> slices;
+    std::string index;
+    size_t pending_size = m_file_size;
+    size_t written = 0;
+    size_t written_bytes = 0;
+    for (size_t i = start; i < end; i++) {
+        const QueuedEnvelope &queued = batch[i];
+        IoSlice slice = {queued.data.data(), queued.data.size()};
+        slices.push_back(slice);
+
+        char line[100];
+        snprintf(line, sizeof(line), "%llu %llu %s\n",
+                 (unsigned long long)pending_size,
+                 (unsigned long long)queued.data.size(),
+                 queued.event_id.c_str());
+        index += line;
+        pending_size += queued.data.size();
+
+        if (per_envelope || i + 1 == end) {
+            bool ok = m_data.write_slices(slices.data(), slices.size());
+            if (ok && m_policy.sync != SENTRY_FILE_SINK_SYNC_NONE) {
+                ok = m_data.sync();
+            }
+            if (!ok) {
+                // the index only ever points at data that was written
+                break;
+            }
+            m_index.write(index.c_str(), index.size());
+            m_index.flush();
+            written_bytes += pending_size - m_file_size;
+            written = i + 1 - start;
+            m_file_size = pending_size;
+            slices.clear();
+            index.clear();
+        }
+    }
+
+    stat_add(STAT_REQUESTS_SENT);
+    stat_add(STAT_BYTES_SENT, written_bytes);
+    return written;
+}
+
+bool FileSinkTransport::open_file() {
+    char name[64];
+    snprintf(name, sizeof(name), "%08x-%llu-%08x", m_writer_id,
+             (unsigned long long)std::chrono::duration_cast<
+                 std::chrono::milliseconds>(
+                 std::chrono::system_clock::now().time_since_epoch())
+                 .count(),
+             m_file_counter++);
+    std::string data_name = std::string(name) + ".envelopes" + PART_SUFFIX;
+    std::string index_name = std::string(name) + ".index" + PART_SUFFIX;
+
+    m_data_path = m_directory.join(data_name.c_str());
+    m_index_path = m_directory.join(index_name.c_str());
+    if (!m_data.open(m_data_path, "wb") || !m_index.open(m_index_path, "wb")) {
+        m_data.close();
+        m_index.close();
+        return false;
+    }
+    m_file_size = 0;
+    m_opened_at = Clock::now();
+    return true;
+}
+
+void FileSinkTransport::finish_file() {
+    if (m_data.is_closed()) {
+        return;
+    }
+    if (m_policy.sync != SENTRY_FILE_SINK_SYNC_NONE) {
+        m_index.sync();
+    }
+    m_data.close();
+    m_index.close();
+    m_data_path.rename_to(m_data_path.strip_suffix(PART_SUFFIX));
+    m_index_path.rename_to(m_index_path.strip_suffix(PART_SUFFIX));
+    m_file_size = 0;
+    m_files_written++;
+}
+
+void FileSinkTransport::finish_leftover_files() {
+    // writers whose lock cannot be taken are still running.  The lock files
+    // of the others are left over from runs that did not shut down cleanly.
+    std::vector<Path> live_writers;
+    std::vector<Path> stale_locks;
+    PathIterator iter = m_directory.iter_directory();
+    while (iter.next()) {
+        const Path &path = *iter.path();
+        if (!path.ends_with(LOCK_SUFFIX)) {
+            continue;
+        }
+        FileLock lock;
+        if (lock.try_lock(path)) {
+            stale_locks.push_back(path);
+        } else {
+            live_writers.push_back(path.strip_suffix(LOCK_SUFFIX));
+        }
+    }
+
+    // the index of a leftover file only covers envelopes that were written
+    // completely.
+    PathIterator parts = m_directory.iter_directory();
+    while (parts.next()) {
+        const Path &path = *parts.path();
+        if (!path.ends_with(PART_SUFFIX)) {
+            continue;
+        }
+        bool live = false;
+        for (const Path &writer : live_writers) {
+            live = live ||
+                   has_writer_prefix(path.as_osstr(), writer.as_osstr());
+        }
+        if (!live) {
+            path.rename_to(path.strip_suffix(PART_SUFFIX));
+        }
+    }
+
+    for (const Path &path : stale_locks) {
+        path.remove();
+    }
+}
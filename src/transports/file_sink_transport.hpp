@@ -0,0 +1,99 @@
+#ifndef SENTRY_TRANSPORTS_FILE_SINK_HPP_INCLUDED
+#define SENTRY_TRANSPORTS_FILE_SINK_HPP_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../io.hpp"
+#include "../path.hpp"
+#include "base_transport.hpp"
+
+namespace sentry {
+namespace transports {
+
+struct FileSinkPolicy {
+    FileSinkPolicy()
+        : max_file_size(SENTRY_FILE_SINK_FILE_SIZE),
+          max_file_age(SENTRY_FILE_SINK_FILE_AGE_MS),
+          sync(SENTRY_FILE_SINK_SYNC_NONE),
+          max_queued(SENTRY_FILE_SINK_QUEUE_MAX) {
+    }
+
+    size_t max_file_size;
+    std::chrono::milliseconds max_file_age;
+    sentry_file_sink_sync_t sync;
+    size_t max_queued;
+};
+
+// appends serialized envelopes to size and time rotated files.
+//
+// Envelopes are serialized on the calling thread and queued.  A single
+// writer thread takes everything queued at once and appends it with one
+// gathered write.  Files are written as `<name>.envelopes.part` together
+// with an index of `<offset> <length> <event_id>` lines in
+// `<name>.index.part`.  Once a file is rotated both lose their `.part`
+// suffix and can be shipped.  If the queue is full envelopes are dropped.
+//
+// Every transport names its files after a writer id and holds a lock on
+// `<writer>.lock` while it runs.  Only `.part` files of writers whose lock
+// is free are finished on start, the others still belong to a live writer.
+class FileSinkTransport : public Transport {
+   public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit FileSinkTransport(const Path &directory,
+                               const FileSinkPolicy &policy = FileSinkPolicy());
+    ~FileSinkTransport();
+    void start();
+    void shutdown();
+    void send_envelope(Envelope envelope);
+    void report_stats(Value &stats);
+
+   private:
+    struct QueuedEnvelope {
+        std::string data;
+        std::string event_id;
+    };
+
+    void run();
+    void write_batch(std::vector<QueuedEnvelope> &batch);
+    size_t write_envelopes(const std::vector<QueuedEnvelope> &batch,
+                           size_t start,
+                           size_t end);
+    bool open_file();
+    void finish_file();
+    void finish_leftover_files();
+    bool lock_writer();
+
+    Path m_directory;
+    FileSinkPolicy m_policy;
+    std::thread m_thread;
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::vector<QueuedEnvelope> m_queue;
+    bool m_running;
+    bool m_stopping;
+    std::atomic<uint64_t> m_files_written;
+    uint32_t m_writer_id;
+    Path m_lock_path;
+    FileLock m_writer_lock;
+
+    // only used by the writer thread
+    FileIoWriter m_data;
+    FileIoWriter m_index;
+    Path m_data_path;
+    Path m_index_path;
+    size_t m_file_size;
+    Clock::time_point m_opened_at;
+    uint32_t m_file_counter;
+};
+
+}  // namespace transports
+}  // namespace sentry
+
+#endif
@@ -3,39 +3,92 @@
 #include <cctype>
 
 #include "../options.hpp"
+#include "../stats.hpp"
 
 #include "libcurl_transport.hpp"
 
 using namespace sentry;
 using namespace transports;
 
-LibcurlTransport::LibcurlTransport() {
+LibcurlTransport::LibcurlTransport(const RetryPolicy &policy)
+    : m_retries(policy),
+      m_drain_scheduled(false),
+      m_linger(0),
+      m_batch_max_bytes(SENTRY_BATCH_BYTES_MAX),
+      m_batch_bytes(0),
+      m_linger_scheduled(false),
+      m_urgent_sends(0) {
     static bool curl_initialized = false;
     if (!curl_initialized) {
         curl_global_init(CURL_GLOBAL_ALL);
     }
 
     m_curl = curl_easy_init();
-    m_disabled_until = std::chrono::system_clock::now();
+    m_urgent_curl = curl_easy_init();
+    m_multi = curl_multi_init();
+    // a batch shares a single connection.  HTTP/2 multiplexes the requests
+    // on it, with HTTP/1.1 they are sent one after the other but the
+    // connection is kept alive.
+    curl_multi_setopt(m_multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(m_multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)1);
 }
 
 LibcurlTransport::~LibcurlTransport() {
     curl_easy_cleanup(m_curl);
+    curl_easy_cleanup(m_urgent_curl);
+    for (CURL *handle : m_batch_handles) {
+        curl_easy_cleanup(handle);
+    }
+    curl_multi_cleanup(m_multi);
     m_worker.kill();
 }
 
 void LibcurlTransport::start() {
+    const sentry_options_t *opts = sentry_get_options();
+    if (!m_outbox.open(opts->database_path.join(SENTRY_PENDING_FOLDER))) {
+        SENTRY_LOG("failed to open outbox, pending events are not persisted");
+    }
+    m_linger = std::chrono::milliseconds(opts->batch_linger);
+    if (opts->batch_max_bytes) {
+        m_batch_max_bytes = opts->batch_max_bytes;
+    }
     m_worker.start();
+
+    // deliver whatever was left over from a previous run, together with
+    // the first batch if batching is enabled.
+    if (m_linger.count()) {
+        schedule_linger();
+    } else {
+        schedule_drain();
+    }
 }
 
 void LibcurlTransport::shutdown() {
+    // a lingering batch is a delayed task, which the worker would discard
+    if (m_linger_scheduled) {
+        m_worker.submit_task([this]() { drain_outbox(); }, true);
+    }
     m_worker.shutdown();
+    m_outbox.close();
 }
 
 size_t swallow_data(void *buffer, size_t size, size_t nmemb, void *userp) {
     return size * nmemb;
 }
 
+static size_t read_body(char *buffer, size_t size, size_t nitems, void *userp) {
+    RequestBody *body = (RequestBody *)userp;
+    return body->read(buffer, size * nitems);
+}
+
+static int seek_body(void *userp, curl_off_t offset, int origin) {
+    RequestBody *body = (RequestBody *)userp;
+    if (origin != SEEK_SET || !body->seek((size_t)offset)) {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+    return CURL_SEEKFUNC_OK;
+}
+
 struct HeaderInfo {
     int retry_after;
 };
@@ -62,63 +115,552 @@ size_t header_callback(char *buffer,
 }
 
 void LibcurlTransport::send_envelope(Envelope envelope) {
-    this->m_worker.submit_task([this, envelope]() {
-        envelope.for_each_request([this](PreparedHttpRequest prepared_request) {
-            const sentry_options_t *opts = sentry_get_options();
-            if (opts->dsn.disabled()) {
-                return false;
+    TaskPriority priority = task_priority_for_event(envelope.get_event());
+    // a fatal event is likely the last thing this process sends.  If it
+    // would have to wait behind other requests it is sent right here.
+    bool urgent = priority == TASK_PRIORITY_FATAL &&
+                  !sentry_get_options()->dsn.disabled() && has_backlog();
+
+    if (!m_outbox.is_open()) {
+        if (urgent) {
+            envelope.for_each_request(
+                [this](PreparedHttpRequest &&prepared_request) {
+                    send_urgent(prepared_request);
+                    return true;
+                });
+            return;
+        }
+        this->m_worker.submit_task(
+            [this, envelope]() {
+                envelope.for_each_request(
+                    [this](PreparedHttpRequest &&prepared_request) {
+                        if (sentry_get_options()->dsn.disabled()) {
+                            return false;
+                        }
+                        send_request(prepared_request);
+                        return true;
+                    });
+            },
+            false, priority);
+        return;
+    }
+
+    if (priority != TASK_PRIORITY_FATAL) {
+        // appending reads every attachment and flushes the outbox, which is
+        // left to the worker rather than the capturing thread.
+        m_worker.submit_task(
+            [this, envelope, priority]() {
+                persist_envelope(envelope, priority);
+            },
+            false, priority);
+        return;
+    }
+
+    // fatal events are persisted right away so that they survive the crash
+    // or shutdown that is likely to follow.  Urgent records are counted
+    // before they are appended, the worker leaves them alone until the
+    // count drops again.
+    if (urgent) {
+        m_urgent_sends++;
+    }
+    uint32_t tag = record_tag(priority, urgent);
+    std::vector<uint64_t> urgent_records;
+    envelope.for_each_request(
+        [this, urgent, tag,
+         &urgent_records](PreparedHttpRequest &&prepared_request) {
+            RequestBody record = prepared_request.into_record();
+            uint64_t seq;
+            if (!m_outbox.append(record, &seq, tag)) {
+                SENTRY_LOG("failed to persist request, dropping it");
+            } else if (urgent) {
+                urgent_records.push_back(seq);
             }
+            return true;
+        });
+
+    if (urgent) {
+        send_urgent_records(urgent_records);
+        m_urgent_sends--;
+    }
+    schedule_drain();
+}
 
-            struct curl_slist *headers = nullptr;
-            headers = curl_slist_append(headers, "expect:");
-            for (auto iter = prepared_request.headers.begin();
-                 iter != prepared_request.headers.end(); ++iter) {
-                headers = curl_slist_append(headers, iter->c_str());
+void LibcurlTransport::persist_envelope(const Envelope &envelope,
+                                        TaskPriority priority) {
+    size_t bytes = 0;
+    uint32_t tag = record_tag(priority, false);
+    envelope.for_each_request(
+        [this, &bytes, tag](PreparedHttpRequest &&prepared_request) {
+            RequestBody record = prepared_request.into_record();
+            bytes += record.size();
+            if (!m_outbox.append(record, nullptr, tag)) {
+                SENTRY_LOG("failed to persist request, dropping it");
             }
+            return true;
+        });
 
-            curl_easy_reset(this->m_curl);
-            curl_easy_setopt(this->m_curl, CURLOPT_URL,
-                             prepared_request.url.c_str());
-            curl_easy_setopt(this->m_curl, CURLOPT_POST, (long)1);
-            curl_easy_setopt(this->m_curl, CURLOPT_HTTPHEADER, headers);
-            curl_easy_setopt(this->m_curl, CURLOPT_POSTFIELDS,
-                             prepared_request.payload.c_str());
-            curl_easy_setopt(this->m_curl, CURLOPT_POSTFIELDSIZE,
-                             (long)prepared_request.payload.size());
-            curl_easy_setopt(this->m_curl, CURLOPT_USERAGENT,
-                             SENTRY_SDK_USER_AGENT);
-            curl_easy_setopt(this->m_curl, CURLOPT_WRITEFUNCTION, swallow_data);
-
-            HeaderInfo info = {0};
-            curl_easy_setopt(this->m_curl, CURLOPT_HEADERDATA, (void *)&info);
-            curl_easy_setopt(this->m_curl, CURLOPT_HEADERFUNCTION,
-                             header_callback);
-
-            if (!opts->http_proxy.empty()) {
-                curl_easy_setopt(this->m_curl, CURLOPT_PROXY,
-                                 opts->http_proxy.c_str());
+    if (m_linger.count() == 0 ||
+        (m_batch_bytes += bytes) >= m_batch_max_bytes) {
+        schedule_drain();
+    } else {
+        schedule_linger();
+    }
+}
+
+bool LibcurlTransport::has_backlog() {
+    // the envelope itself is not persisted yet
+    return m_worker.queue_depth() > 0 ||
+           (m_outbox.is_open() && m_outbox.pending() > 0);
+}
+
+void LibcurlTransport::send_urgent_records(const std::vector<uint64_t> &seqs) {
+    for (uint64_t seq : seqs) {
+        OutboxRecord record;
+        if (m_outbox.get(seq, &record) && m_outbox.pin(record)) {
+            PreparedHttpRequest prepared_request;
+            bool sent = prepared_request.read_record(record.path,
+                                                     record.offset,
+                                                     record.len) &&
+                        send_urgent(prepared_request) == SEND_RESULT_DONE;
+            m_outbox.unpin(record);
+            if (sent) {
+                m_outbox.ack(seq);
             }
-            if (!opts->ca_certs.empty()) {
-                curl_easy_setopt(this->m_curl, CURLOPT_CAPATH,
-                                 opts->ca_certs.c_str());
+        }
+        // anything that did not go through is left to the worker
+    }
+}
+
+uint32_t LibcurlTransport::record_tag(TaskPriority priority, bool urgent) {
+    // records from before lanes were stored carry a zero tag, which stands
+    // for the default lane.
+    uint32_t tag = priority == TASK_PRIORITY_DEFAULT ? 0 : priority + 1;
+    return urgent ? tag | RECORD_TAG_URGENT : tag;
+}
+
+TaskPriority LibcurlTransport::record_lane(const OutboxRecord &record) {
+    uint32_t lane = record.tag & ~RECORD_TAG_URGENT;
+    if (lane == 0 || lane > TASK_PRIORITY_DEFAULT) {
+        return TASK_PRIORITY_DEFAULT;
+    }
+    return (TaskPriority)(lane - 1);
+}
+
+bool LibcurlTransport::is_urgent(const OutboxRecord &record) {
+    return (record.tag & RECORD_TAG_URGENT) && m_urgent_sends > 0;
+}
+
+void LibcurlTransport::report_stats(Value &stats) {
+    stats.set_by_key("queue_depth",
+                     Value::new_double((double)m_worker.queue_depth()));
+    stats.set_by_key("outbox_pending",
+                     Value::new_double((double)m_outbox.pending()));
+    stats.set_by_key("outbox_dropped",
+                     Value::new_double((double)m_outbox.dropped()));
+}
+
+void LibcurlTransport::schedule_drain() {
+    // a single pending drain task picks up everything appended before it
+    // runs, so there is no need to queue one per envelope.
+    if (!m_drain_scheduled.exchange(true)) {
+        m_worker.submit_task([this]() {
+            m_drain_scheduled = false;
+            drain_outbox();
+        });
+    }
+}
+
+void LibcurlTransport::schedule_linger() {
+    // the first record of a batch starts the linger window, everything
+    // appended until it closes goes out together.
+    if (!m_linger_scheduled.exchange(true)) {
+        m_worker.submit_delayed_task(
+            [this]() {
+                m_linger_scheduled = false;
+                drain_outbox();
+            },
+            m_linger);
+    }
+}
+
+void LibcurlTransport::drain_outbox() {
+    RetryScheduler::Clock::time_point now = RetryScheduler::Clock::now();
+    m_batch_bytes = 0;
+
+    // the retries that are due are taken all at once, so that one which is
+    // deferred again while draining is not picked up a second time.
+    std::vector<uint64_t> due;
+    uint64_t seq;
+    while (m_retries.pop_due(now, &seq)) {
+        due.push_back(seq);
+    }
+
+    // new records go first so that they never wait behind old ones that
+    // are backing off, and within them the lanes are kept in order.  The
+    // records of retries are held back in the outbox, including the due
+    // ones until this drain is done with them.
+    std::vector<OutboxRecord> fresh;
+    m_outbox.ready(&fresh);
+    fresh.erase(std::remove_if(fresh.begin(), fresh.end(),
+                               [this](const OutboxRecord &record) {
+                                   return is_urgent(record);
+                               }),
+                fresh.end());
+    std::stable_sort(fresh.begin(), fresh.end(),
+                     [](const OutboxRecord &a, const OutboxRecord &b) {
+                         return record_lane(a) < record_lane(b);
+                     });
+
+    RequestBatch batch;
+    bool paused = false;
+    for (size_t i = 0; !paused && i < fresh.size(); i++) {
+        paused = !collect_record(fresh[i], now, batch);
+    }
+
+    OutboxRecord record;
+    for (uint64_t retry_seq : due) {
+        if (paused) {
+            // stays due for the drain after the pause
+            defer_record(retry_seq, std::max(now, m_disabled_until));
+        } else if (m_outbox.get(retry_seq, &record)) {
+            paused = !collect_record(record, now, batch);
+        } else {
+            m_retries.forget(retry_seq);
+        }
+    }
+
+    if (paused) {
+        abandon_batch(batch);
+    } else {
+        send_batch(batch, now);
+    }
+
+    // due records that were neither sent nor scheduled again are picked up
+    // as new ones by the next drain
+    for (uint64_t retry_seq : due) {
+        if (!m_retries.is_scheduled(retry_seq)) {
+            m_outbox.release(retry_seq);
+        }
+    }
+    schedule_wakeup(now);
+}
+
+void LibcurlTransport::defer_record(uint64_t seq,
+                                    RetryScheduler::Clock::time_point due) {
+    m_outbox.hold(seq);
+    m_retries.defer(seq, due);
+}
+
+bool LibcurlTransport::collect_record(const OutboxRecord &record,
+                                      RetryScheduler::Clock::time_point now,
+                                      RequestBatch &batch) {
+    std::unique_ptr<PendingRequest> pending(new PendingRequest());
+    switch (prepare_record(record, now, pending.get())) {
+        case RECORD_PAUSED:
+            return false;
+        case RECORD_SKIPPED:
+            return true;
+        case RECORD_SEND:
+        default:
+            break;
+    }
+
+    batch.push_back(std::move(pending));
+    size_t max_requests = m_linger.count() ? SENTRY_BATCH_REQUESTS_MAX : 1;
+    if (batch.size() < max_requests) {
+        return true;
+    }
+    return send_batch(batch, now);
+}
+
+LibcurlTransport::RecordState LibcurlTransport::prepare_record(
+    const OutboxRecord &record,
+    RetryScheduler::Clock::time_point now,
+    PendingRequest *pending_out) {
+    if (sentry_get_options()->dsn.disabled() || now < m_disabled_until) {
+        // the records stay in the outbox until the next drain
+        return RECORD_PAUSED;
+    }
+
+    // the body is read lazily while sending, so the segment has to stay
+    // around until the record is finished.
+    if (!m_outbox.pin(record)) {
+        m_retries.forget(record.seq);
+        return RECORD_SKIPPED;
+    }
+    if (!pending_out->request.read_record(record.path, record.offset,
+                                          record.len)) {
+        SENTRY_LOG("dropping unreadable outbox record");
+        m_outbox.unpin(record);
+        m_retries.forget(record.seq);
+        m_outbox.ack(record.seq);
+        return RECORD_SKIPPED;
+    }
+
+    std::string endpoint = endpoint_for_url(pending_out->request.url);
+    RetryScheduler::Clock::time_point retry_at;
+    if (!m_retries.allow_request(endpoint, now, &retry_at)) {
+        m_outbox.unpin(record);
+        defer_record(record.seq, retry_at);
+        return RECORD_SKIPPED;
+    }
+
+    pending_out->record = record;
+    pending_out->endpoint = endpoint;
+    return RECORD_SEND;
+}
+
+bool LibcurlTransport::finish_record(const PendingRequest &pending,
+                                     SendResult result,
+                                     RetryScheduler::Clock::time_point now) {
+    const OutboxRecord &record = pending.record;
+    m_outbox.unpin(record);
+    switch (result) {
+        case SEND_RESULT_DONE:
+            m_retries.record_success(pending.endpoint);
+            m_retries.forget(record.seq);
+            m_outbox.ack(record.seq);
+            return true;
+        case SEND_RESULT_RATE_LIMITED:
+            // does not count as an attempt, the whole transport waits
+            m_retries.release_probe(pending.endpoint);
+            defer_record(record.seq, m_disabled_until);
+            return false;
+        case SEND_RESULT_FAILED:
+        default:
+            m_retries.record_failure(pending.endpoint, now);
+            m_outbox.hold(record.seq);
+            if (!m_retries.schedule_retry(record.seq, now)) {
+                SENTRY_LOG("giving up on request after too many attempts");
+                m_outbox.ack(record.seq);
             }
+            return true;
+    }
+}
 
-            CURLcode rv = curl_easy_perform(this->m_curl);
+bool LibcurlTransport::send_batch(RequestBatch &batch,
+                                  RetryScheduler::Clock::time_point now) {
+    std::vector<SendResult> results(batch.size(), SEND_RESULT_FAILED);
+    if (batch.size() == 1) {
+        results[0] = send_request(batch[0]->request);
+    } else if (batch.size() > 1) {
+        send_multiplexed(batch, results);
+    }
 
-            if (rv == CURLE_OK) {
-                long response_code;
-                curl_easy_getinfo(this->m_curl, CURLINFO_RESPONSE_CODE,
-                                  &response_code);
-                if (response_code == 429) {
-                    m_disabled_until = std::chrono::system_clock::now() +
-                                       std::chrono::seconds(info.retry_after);
-                }
+    bool proceed = true;
+    for (size_t i = 0; i < batch.size(); i++) {
+        proceed = finish_record(*batch[i], results[i], now) && proceed;
+    }
+    batch.clear();
+    return proceed;
+}
+
+void LibcurlTransport::abandon_batch(RequestBatch &batch) {
+    // the records are picked up again by the next drain
+    for (const std::unique_ptr<PendingRequest> &pending : batch) {
+        m_outbox.unpin(pending->record);
+        m_retries.release_probe(pending->endpoint);
+    }
+    batch.clear();
+}
+
+void LibcurlTransport::schedule_wakeup(RetryScheduler::Clock::time_point now) {
+    RetryScheduler::Clock::time_point due;
+    bool wake = m_retries.next_due(&due);
+    if (now < m_disabled_until && m_outbox.pending() > 0) {
+        due = m_disabled_until;
+        wake = true;
+    }
+
+    // an already scheduled wakeup that comes first will reschedule
+    if (!wake || (m_wakeup_at > now && m_wakeup_at <= due)) {
+        return;
+    }
+
+    m_wakeup_at = due;
+    m_worker.submit_delayed_task(
+        [this]() {
+            m_wakeup_at = RetryScheduler::Clock::time_point();
+            drain_outbox();
+        },
+        std::chrono::duration_cast<std::chrono::milliseconds>(due - now) +
+            std::chrono::milliseconds(1));
+}
+
+static struct curl_slist *setup_request(CURL *curl,
+                                        PreparedHttpRequest &prepared_request,
+                                        HeaderInfo *info) {
+    const sentry_options_t *opts = sentry_get_options();
+
+    struct curl_slist *headers = nullptr;
+    headers = curl_slist_append(headers, "expect:");
+    for (auto iter = prepared_request.headers.begin();
+         iter != prepared_request.headers.end(); ++iter) {
+        headers = curl_slist_append(headers, iter->c_str());
+    }
+
+    curl_easy_reset(curl);
+    curl_easy_setopt(curl, CURLOPT_URL, prepared_request.url.c_str());
+    curl_easy_setopt(curl, CURLOPT_POST, (long)1);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    // the body is streamed from the envelope so that large attachments are
+    // not copied into a contiguous buffer.
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_body);
+    curl_easy_setopt(curl, CURLOPT_READDATA, (void *)&prepared_request.body);
+    curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, seek_body);
+    curl_easy_setopt(curl, CURLOPT_SEEKDATA, (void *)&prepared_request.body);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE,
+                     (curl_off_t)prepared_request.body.size());
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, SENTRY_SDK_USER_AGENT);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, swallow_data);
+
+    info->retry_after = 0;
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void *)info);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
+
+    if (!opts->http_proxy.empty()) {
+        curl_easy_setopt(curl, CURLOPT_PROXY, opts->http_proxy.c_str());
+    }
+    if (!opts->ca_certs.empty()) {
+        curl_easy_setopt(curl, CURLOPT_CAPATH, opts->ca_certs.c_str());
+    }
+    return headers;
+}
+
+LibcurlTransport::SendResult LibcurlTransport::send_request(
+    PreparedHttpRequest &prepared_request) {
+    HeaderInfo info;
+    struct curl_slist *headers =
+        setup_request(this->m_curl, prepared_request, &info);
+
+    CURLcode rv;
+    {
+        ScopedStatTimer timer(STAT_TIMER_REQUEST);
+        rv = curl_easy_perform(this->m_curl);
+    }
+    SendResult result = finish_request(this->m_curl, rv, prepared_request);
+    if (result == SEND_RESULT_RATE_LIMITED) {
+        rate_limit(info.retry_after);
+    }
+
+    curl_slist_free_all(headers);
+    return result;
+}
+
+LibcurlTransport::SendResult LibcurlTransport::send_urgent(
+    PreparedHttpRequest &prepared_request) {
+    std::lock_guard<std::mutex> _lock(m_urgent_curl_lock);
+    HeaderInfo info;
+    struct curl_slist *headers =
+        setup_request(m_urgent_curl, prepared_request, &info);
+    // the calling thread may be about to crash, it must not hang here
+    curl_easy_setopt(m_urgent_curl, CURLOPT_TIMEOUT_MS,
+                     (long)SENTRY_URGENT_SEND_TIMEOUT_MS);
+
+    CURLcode rv;
+    {
+        ScopedStatTimer timer(STAT_TIMER_REQUEST);
+        rv = curl_easy_perform(m_urgent_curl);
+    }
+    // a rate limit is left to the worker, which runs into it on its own
+    SendResult result = finish_request(m_urgent_curl, rv, prepared_request);
+
+    curl_slist_free_all(headers);
+    return result;
+}
+
+void LibcurlTransport::rate_limit(int retry_after) {
+    m_disabled_until =
+        RetryScheduler::Clock::now() +
+        std::chrono::seconds(retry_after > 0 ? retry_after : 60);
+}
+
+void LibcurlTransport::send_multiplexed(RequestBatch &batch,
+                                        std::vector<SendResult> &results) {
+    struct Transfer {
+        size_t index;
+        HeaderInfo info;
+        struct curl_slist *headers;
+    };
+
+    while (m_batch_handles.size() < batch.size()) {
+        m_batch_handles.push_back(curl_easy_init());
+    }
+    std::vector<Transfer> transfers(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        CURL *handle = m_batch_handles[i];
+        Transfer &transfer = transfers[i];
+        transfer.index = i;
+        transfer.headers =
+            setup_request(handle, batch[i]->request, &transfer.info);
+        // wait for the shared connection instead of opening another one
+        curl_easy_setopt(handle, CURLOPT_PIPEWAIT, (long)1);
+        curl_easy_setopt(handle, CURLOPT_PRIVATE, (void *)&transfer);
+        curl_multi_add_handle(m_multi, handle);
+    }
+
+    {
+        // the timer covers the whole batch, not every single request
+        ScopedStatTimer timer(STAT_TIMER_REQUEST);
+        int running = 0;
+        do {
+            if (curl_multi_perform(m_multi, &running) != CURLM_OK) {
+                break;
             }
+            if (running) {
+                curl_multi_wait(m_multi, nullptr, 0, 1000, nullptr);
+            }
+        } while (running);
+    }
 
-            curl_slist_free_all(headers);
-            return true;
-        });
-    });
+    CURLMsg *msg;
+    int left;
+    while ((msg = curl_multi_info_read(m_multi, &left))) {
+        if (msg->msg != CURLMSG_DONE) {
+            continue;
+        }
+        Transfer *transfer = nullptr;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE,
+                          (char **)&transfer);
+        SendResult result =
+            finish_request(msg->easy_handle, msg->data.result,
+                           batch[transfer->index]->request);
+        if (result == SEND_RESULT_RATE_LIMITED) {
+            rate_limit(transfer->info.retry_after);
+        }
+        results[transfer->index] = result;
+    }
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        curl_multi_remove_handle(m_multi, m_batch_handles[i]);
+        curl_slist_free_all(transfers[i].headers);
+    }
+}
+
+LibcurlTransport::SendResult LibcurlTransport::finish_request(
+    CURL *curl,
+    CURLcode rv,
+    const PreparedHttpRequest &prepared_request) {
+    SendResult result = SEND_RESULT_FAILED;
+    stat_add(STAT_REQUESTS_SENT);
+
+    if (rv == CURLE_OK) {
+        long response_code;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+        stat_add(STAT_BYTES_SENT, prepared_request.body.size());
+        stat_record_http_status(response_code);
+        if (response_code == 429) {
+            stat_add(STAT_REQUESTS_RATE_LIMITED);
+            result = SEND_RESULT_RATE_LIMITED;
+        } else if (response_code < 500) {
+            // client errors will not go away by retrying
+            result = SEND_RESULT_DONE;
+        }
+    } else {
+        stat_add(STAT_REQUESTS_FAILED);
+        SENTRY_LOGF("request failed: %s", curl_easy_strerror(rv));
+    }
+    return result;
 }
 
 #endif
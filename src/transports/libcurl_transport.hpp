@@ -4,25 +4,105 @@
 
 #include <curl/curl.h>
 #include <curl/easy.h>
+#include <atomic>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
 
+#include "../outbox.hpp"
 #include "../worker.hpp"
 #include "base_transport.hpp"
+#include "retry.hpp"
 
 namespace sentry {
 namespace transports {
 class LibcurlTransport : public Transport {
    public:
-    LibcurlTransport();
+    explicit LibcurlTransport(const RetryPolicy &policy = RetryPolicy());
     ~LibcurlTransport();
     void start();
     void shutdown();
     void send_envelope(Envelope envelope);
+    void report_stats(Value &stats);
 
    private:
+    enum SendResult {
+        SEND_RESULT_DONE,
+        SEND_RESULT_FAILED,
+        SEND_RESULT_RATE_LIMITED,
+    };
+
+    enum RecordState {
+        RECORD_SEND,
+        RECORD_SKIPPED,
+        RECORD_PAUSED,
+    };
+
+    // an outbox record that is about to be sent.
+    struct PendingRequest {
+        OutboxRecord record;
+        std::string endpoint;
+        PreparedHttpRequest request;
+    };
+    typedef std::vector<std::unique_ptr<PendingRequest>> RequestBatch;
+
+    SendResult send_request(PreparedHttpRequest &request);
+    SendResult send_urgent(PreparedHttpRequest &request);
+    static SendResult finish_request(CURL *curl,
+                                     CURLcode rv,
+                                     const PreparedHttpRequest &request);
+    void rate_limit(int retry_after);
+    void persist_envelope(const Envelope &envelope, TaskPriority priority);
+    bool has_backlog();
+    void send_urgent_records(const std::vector<uint64_t> &seqs);
+    static uint32_t record_tag(TaskPriority priority, bool urgent);
+    static TaskPriority record_lane(const OutboxRecord &record);
+    bool is_urgent(const OutboxRecord &record);
+    void send_multiplexed(RequestBatch &batch,
+                          std::vector<SendResult> &results);
+    RecordState prepare_record(const OutboxRecord &record,
+                               RetryScheduler::Clock::time_point now,
+                               PendingRequest *pending_out);
+    bool finish_record(const PendingRequest &pending,
+                       SendResult result,
+                       RetryScheduler::Clock::time_point now);
+    bool collect_record(const OutboxRecord &record,
+                        RetryScheduler::Clock::time_point now,
+                        RequestBatch &batch);
+    bool send_batch(RequestBatch &batch, RetryScheduler::Clock::time_point now);
+    void abandon_batch(RequestBatch &batch);
+    void defer_record(uint64_t seq, RetryScheduler::Clock::time_point due);
+    void drain_outbox();
+    void schedule_drain();
+    void schedule_linger();
+    void schedule_wakeup(RetryScheduler::Clock::time_point now);
+
     BackgroundWorker m_worker;
+    Outbox m_outbox;
+    RetryScheduler m_retries;
+    std::atomic<bool> m_drain_scheduled;
+    RetryScheduler::Clock::time_point m_wakeup_at;
     CURL *m_curl;
-    std::chrono::system_clock::time_point m_disabled_until;
+    RetryScheduler::Clock::time_point m_disabled_until;
+
+    // batching: new records wait up to `m_linger` for more to arrive, unless
+    // `m_batch_max_bytes` are pending.  Batches are sent through `m_multi`
+    // which keeps its connection alive between batches.
+    std::chrono::milliseconds m_linger;
+    size_t m_batch_max_bytes;
+    std::atomic<size_t> m_batch_bytes;
+    std::atomic<bool> m_linger_scheduled;
+    CURLM *m_multi;
+    std::vector<CURL *> m_batch_handles;
+
+    // fatal events that would have to wait behind a backlog are sent right
+    // away on the calling thread, using a handle of their own.  Their outbox
+    // records are tagged and skipped by the worker while that happens.
+    static const uint32_t RECORD_TAG_URGENT = 0x100;
+    std::atomic<size_t> m_urgent_sends;
+    std::mutex m_urgent_curl_lock;
+    CURL *m_urgent_curl;
 };
 }  // namespace transports
 }  // namespace sentry
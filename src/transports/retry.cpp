@@ -0,0 +1,147 @@
+#include <algorithm>
+
+#include "retry.hpp"
+
+using namespace sentry;
+using namespace transports;
+
+RetryPolicy::RetryPolicy()
+    : initial_backoff(1000),
+      max_backoff(5 * 60 * 1000),
+      max_attempts(SENTRY_OUTBOX_ATTEMPTS_MAX),
+      breaker_threshold(5),
+      breaker_cooldown(30 * 1000) {
+}
+
+RetryScheduler::RetryScheduler(const RetryPolicy &policy)
+    : m_policy(policy),
+      m_rng((std::minstd_rand::result_type)Clock::now()
+                .time_since_epoch()
+                .count()) {
+}
+
+std::chrono::milliseconds RetryScheduler::backoff(int attempt) {
+    std::chrono::milliseconds::rep delay = m_policy.initial_backoff.count();
+    for (int i = 1; i < attempt && delay < m_policy.max_backoff.count(); i++) {
+        delay *= 2;
+    }
+    delay = std::min(delay, m_policy.max_backoff.count());
+
+    // equal jitter: half of the delay is fixed, the other half random, so
+    // that clients which failed together do not retry in lockstep.
+    std::uniform_int_distribution<std::chrono::milliseconds::rep> jitter(
+        0, delay / 2);
+    return std::chrono::milliseconds(delay - delay / 2 + jitter(m_rng));
+}
+
+bool RetryScheduler::schedule_retry(uint64_t id, Clock::time_point now) {
+    int attempt = ++m_attempts[id];
+    if (attempt >= m_policy.max_attempts) {
+        forget(id);
+        return false;
+    }
+    defer(id, now + backoff(attempt));
+    return true;
+}
+
+void RetryScheduler::defer(uint64_t id, Clock::time_point due) {
+    // a request is only in the heap once.  Rescheduling leaves a stale
+    // entry behind that is skipped when it comes up.
+    m_scheduled[id] = due;
+    PendingRetry retry;
+    retry.due = due;
+    retry.id = id;
+    m_heap.push(retry);
+}
+
+bool RetryScheduler::is_scheduled(uint64_t id) const {
+    return m_scheduled.find(id) != m_scheduled.end();
+}
+
+bool RetryScheduler::pop_due(Clock::time_point now, uint64_t *id_out) {
+    while (!m_heap.empty() && m_heap.top().due <= now) {
+        PendingRetry retry = m_heap.top();
+        m_heap.pop();
+        auto iter = m_scheduled.find(retry.id);
+        if (iter != m_scheduled.end() && iter->second == retry.due) {
+            m_scheduled.erase(iter);
+            *id_out = retry.id;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RetryScheduler::next_due(Clock::time_point *due_out) const {
+    if (m_scheduled.empty()) {
+        return false;
+    }
+    Clock::time_point due = m_scheduled.begin()->second;
+    for (auto &scheduled : m_scheduled) {
+        due = std::min(due, scheduled.second);
+    }
+    *due_out = due;
+    return true;
+}
+
+void RetryScheduler::forget(uint64_t id) {
+    m_attempts.erase(id);
+    m_scheduled.erase(id);
+}
+
+bool RetryScheduler::allow_request(const std::string &endpoint,
+                                   Clock::time_point now,
+                                   Clock::time_point *retry_at_out) {
+    auto iter = m_breakers.find(endpoint);
+    if (iter == m_breakers.end() ||
+        iter->second.failures < m_policy.breaker_threshold) {
+        return true;
+    }
+
+    Breaker &breaker = iter->second;
+    if (now < breaker.open_until || breaker.probing) {
+        // requests held back by a probe wait for another cooldown.  They
+        // must not be due right away or the drain picks them up again.
+        if (retry_at_out) {
+            *retry_at_out = breaker.probing ? now + m_policy.breaker_cooldown
+                                            : breaker.open_until;
+        }
+        return false;
+    }
+
+    // half open: let a single request through to probe the endpoint
+    breaker.probing = true;
+    return true;
+}
+
+void RetryScheduler::record_success(const std::string &endpoint) {
+    m_breakers.erase(endpoint);
+}
+
+void RetryScheduler::release_probe(const std::string &endpoint) {
+    auto iter = m_breakers.find(endpoint);
+    if (iter != m_breakers.end()) {
+        iter->second.probing = false;
+    }
+}
+
+void RetryScheduler::record_failure(const std::string &endpoint,
+                                    Clock::time_point now) {
+    Breaker &breaker = m_breakers[endpoint];
+    breaker.failures++;
+    breaker.probing = false;
+    if (breaker.failures >= m_policy.breaker_threshold) {
+        if (breaker.failures == m_policy.breaker_threshold) {
+            SENTRY_LOGF("too many failures, pausing requests to %s",
+                        endpoint.c_str());
+        }
+        breaker.open_until = now + m_policy.breaker_cooldown;
+    }
+}
+
+std::string sentry::transports::endpoint_for_url(const std::string &url) {
+    size_t scheme_end = url.find("://");
+    size_t path_start =
+        url.find('/', scheme_end == std::string::npos ? 0 : scheme_end + 3);
+    return path_start == std::string::npos ? url : url.substr(0, path_start);
+}
@@ -0,0 +1,114 @@
+#ifndef SENTRY_TRANSPORTS_RETRY_HPP_INCLUDED
+#define SENTRY_TRANSPORTS_RETRY_HPP_INCLUDED
+
+#include <chrono>
+#include <map>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../internal.hpp"
+
+namespace sentry {
+namespace transports {
+
+struct RetryPolicy {
+    RetryPolicy();
+
+    // the delay before the first retry, doubled for every further attempt
+    // up to `max_backoff`.
+    std::chrono::milliseconds initial_backoff;
+    std::chrono::milliseconds max_backoff;
+    int max_attempts;
+
+    // an endpoint is skipped for `breaker_cooldown` after
+    // `breaker_threshold` consecutive failures.
+    int breaker_threshold;
+    std::chrono::milliseconds breaker_cooldown;
+};
+
+// decides when failed requests are attempted again.
+//
+// Pending retries are kept in a heap ordered by their due time, so new
+// requests never have to wait behind old ones that are still backing off.
+// Every endpoint has a circuit breaker: after too many consecutive failures
+// requests to it are held back until a cooldown has passed, after which a
+// single request is let through to probe whether it recovered.
+class RetryScheduler {
+   public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit RetryScheduler(const RetryPolicy &policy = RetryPolicy());
+
+    // records a failed attempt of request `id` and schedules the next one.
+    // Returns `false` if the request ran out of attempts instead.
+    bool schedule_retry(uint64_t id, Clock::time_point now);
+
+    // schedules request `id` at `due` without counting an attempt.
+    void defer(uint64_t id, Clock::time_point due);
+
+    // whether `id` currently waits for a retry.
+    bool is_scheduled(uint64_t id) const;
+
+    // pops the next retry that is due at `now`.
+    bool pop_due(Clock::time_point now, uint64_t *id_out);
+
+    // returns the time the next retry is due.
+    bool next_due(Clock::time_point *due_out) const;
+
+    // forgets all state about request `id` once it is done.
+    void forget(uint64_t id);
+
+    // circuit breaker for `endpoint`.  If the request is not allowed,
+    // `retry_at_out` is set to the time the endpoint may be tried again,
+    // which is always later than `now`.
+    bool allow_request(const std::string &endpoint,
+                       Clock::time_point now,
+                       Clock::time_point *retry_at_out = nullptr);
+    void record_success(const std::string &endpoint);
+    void record_failure(const std::string &endpoint, Clock::time_point now);
+    // ends a probe that neither succeeded nor failed, such as a rate limited
+    // or an unsent one.  The next request probes the endpoint again.
+    void release_probe(const std::string &endpoint);
+
+    std::chrono::milliseconds backoff(int attempt);
+
+   private:
+    struct PendingRetry {
+        Clock::time_point due;
+        uint64_t id;
+
+        bool operator>(const PendingRetry &other) const {
+            return due > other.due;
+        }
+    };
+
+    struct Breaker {
+        Breaker() : failures(0), probing(false) {
+        }
+
+        int failures;
+        bool probing;
+        Clock::time_point open_until;
+    };
+
+    RetryPolicy m_policy;
+    std::priority_queue<PendingRetry,
+                        std::vector<PendingRetry>,
+                        std::greater<PendingRetry>>
+        m_heap;
+    std::map<uint64_t, int> m_attempts;
+    std::map<uint64_t, Clock::time_point> m_scheduled;
+    std::map<std::string, Breaker> m_breakers;
+    std::minstd_rand m_rng;
+};
+
+// returns the part of `url` that identifies an endpoint for the circuit
+// breaker, which is everything up to the path.
+std::string endpoint_for_url(const std::string &url);
+
+}  // namespace transports
+}  // namespace sentry
+
+#endif
@@ -0,0 +1,42 @@
+#if !defined(_WIN32) && !defined(__ANDROID__)
+#include "../options.hpp"
+#include "../stats.hpp"
+
+#include "shared_ring_transport.hpp"
+
+using namespace sentry;
+using namespace transports;
+
+SharedRingTransport::SharedRingTransport(const char *name, size_t capacity)
+    : m_name(name), m_capacity(capacity) {
+}
+
+void SharedRingTransport::start() {
+    if (!m_ring.open(m_name.c_str(), m_capacity)) {
+        SENTRY_LOGF("failed to open shared memory ring %s", m_name.c_str());
+    }
+}
+
+void SharedRingTransport::shutdown() {
+    m_ring.close();
+}
+
+void SharedRingTransport::send_envelope(Envelope envelope) {
+    MemoryIoWriter writer;
+    envelope.serialize_into(writer);
+    if (!m_ring.push(writer.buf(), writer.len())) {
+        SENTRY_LOG("shared memory ring is full, dropping envelope");
+        stat_add(STAT_EVENTS_DROPPED);
+        return;
+    }
+    stat_add(STAT_BYTES_SENT, writer.len());
+}
+
+void SharedRingTransport::report_stats(Value &stats) {
+    stats.set_by_key("ring_capacity",
+                     Value::new_double((double)m_ring.capacity()));
+    stats.set_by_key("ring_dropped",
+                     Value::new_double((double)m_ring.dropped()));
+}
+
+#endif
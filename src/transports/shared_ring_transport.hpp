@@ -0,0 +1,37 @@
+#ifndef SENTRY_TRANSPORTS_SHARED_RING_HPP_INCLUDED
+#define SENTRY_TRANSPORTS_SHARED_RING_HPP_INCLUDED
+#if !defined(_WIN32) && !defined(__ANDROID__)
+
+#include <string>
+
+#include "../shmring.hpp"
+#include "base_transport.hpp"
+
+namespace sentry {
+namespace transports {
+
+// pushes serialized envelopes into a shared memory ring that a single
+// uploader process drains with `sentry_drain_shared_ring`.
+//
+// Envelopes are serialized and pushed on the calling thread; there is no
+// background thread and nothing ever blocks.  If the ring is full the
+// envelope is dropped.
+class SharedRingTransport : public Transport {
+   public:
+    SharedRingTransport(const char *name, size_t capacity);
+    void start();
+    void shutdown();
+    void send_envelope(Envelope envelope);
+    void report_stats(Value &stats);
+
+   private:
+    std::string m_name;
+    size_t m_capacity;
+    SharedRing m_ring;
+};
+
+}  // namespace transports
+}  // namespace sentry
+
+#endif
+#endif
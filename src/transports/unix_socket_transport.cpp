@@ -0,0 +1,258 @@
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "../options.hpp"
+#include "../stats.hpp"
+
+#include "unix_socket_transport.hpp"
+
+using namespace sentry;
+using namespace transports;
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+static void encode_frame_length(uint32_t len, char *buf) {
+    buf[0] = (char)(len >> 24);
+    buf[1] = (char)(len >> 16);
+    buf[2] = (char)(len >> 8);
+    buf[3] = (char)len;
+}
+
+UnixSocketTransport::UnixSocketTransport(const char *socket_path)
+    : m_socket_path(socket_path),
+      m_fd(-1),
+      m_reconnect_delay(SENTRY_RELAY_RECONNECT_MIN_MS),
+      m_flush_scheduled(false) {
+}
+
+UnixSocketTransport::~UnixSocketTransport() {
+    m_worker.kill();
+    disconnect();
+}
+
+void UnixSocketTransport::start() {
+    const sentry_options_t *opts = sentry_get_options();
+    if (!m_spill.open(opts->database_path.join(SENTRY_RELAY_SPILL_FOLDER))) {
+        SENTRY_LOG("failed to open relay spill, events are dropped while the "
+                   "relay is unreachable");
+    }
+    m_worker.start();
+
+    // replay whatever was spilled during a previous run
+    m_worker.submit_task([this]() {
+        if (!flush_spill()) {
+            schedule_flush();
+        }
+    });
+}
+
+void UnixSocketTransport::shutdown() {
+    m_worker.shutdown();
+    disconnect();
+    m_spill.close();
+}
+
+void UnixSocketTransport::send_envelope(Envelope envelope) {
+    m_worker.submit_task([this, envelope]() {
+        MemoryIoWriter writer;
+        envelope.serialize_into(writer);
+        deliver(writer.buf(), writer.len());
+    });
+}
+
+void UnixSocketTransport::report_stats(Value &stats) {
+    stats.set_by_key("queue_depth",
+                     Value::new_double((double)m_worker.queue_depth()));
+    stats.set_by_key("spill_pending",
+                     Value::new_double((double)m_spill.pending()));
+    stats.set_by_key("spill_dropped",
+                     Value::new_double((double)m_spill.dropped()));
+}
+
+void UnixSocketTransport::deliver(const char *buf, size_t len) {
+    // spilled envelopes go first so that the relay sees them in order
+    if (!flush_spill()) {
+        spill(buf, len);
+        return;
+    }
+
+    char header[4];
+    encode_frame_length((uint32_t)len, header);
+    RequestBody body;
+    body.append_ref(header, sizeof(header));
+    body.append_ref(buf, len);
+    if (!ensure_connected() || !write_frame(body)) {
+        spill(buf, len);
+    }
+}
+
+bool UnixSocketTransport::flush_spill() {
+    OutboxRecord record;
+    while (m_spill.front(&record)) {
+        if (!ensure_connected()) {
+            return false;
+        }
+        char header[4];
+        encode_frame_length((uint32_t)record.len, header);
+        RequestBody body;
+        body.append_ref(header, sizeof(header));
+        body.append_file(record.path, record.offset, record.len);
+        if (!write_frame(body)) {
+            return false;
+        }
+        m_spill.ack(record.seq);
+    }
+    return true;
+}
+
+void UnixSocketTransport::spill(const char *buf, size_t len) {
+    if (!m_spill.is_open() || !m_spill.append(buf, len)) {
+        SENTRY_LOG("relay is unreachable, dropping envelope");
+        stat_add(STAT_REQUESTS_FAILED);
+        return;
+    }
+    schedule_flush();
+}
+
+void UnixSocketTransport::schedule_flush() {
+    if (m_flush_scheduled || m_spill.pending() == 0) {
+        return;
+    }
+    m_flush_scheduled = true;
+    Clock::time_point now = Clock::now();
+    std::chrono::milliseconds delay(1);
+    if (m_reconnect_at > now) {
+        delay += std::chrono::duration_cast<std::chrono::milliseconds>(
+            m_reconnect_at - now);
+    }
+    m_worker.submit_delayed_task(
+        [this]() {
+            m_flush_scheduled = false;
+            if (!flush_spill()) {
+                schedule_flush();
+            }
+        },
+        delay);
+}
+
+bool UnixSocketTransport::ensure_connected() {
+    if (m_fd >= 0) {
+        return true;
+    }
+    Clock::time_point now = Clock::now();
+    if (now < m_reconnect_at) {
+        return false;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (m_socket_path.size() >= sizeof(addr.sun_path)) {
+        SENTRY_LOG("relay socket path is too long");
+        m_reconnect_at = Clock::time_point::max();
+        return false;
+    }
+    memcpy(addr.sun_path, m_socket_path.c_str(), m_socket_path.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        int rv;
+        EINTR_RETRY(connect(fd, (struct sockaddr *)&addr, sizeof(addr)), &rv);
+        if (rv != 0 && errno == EINPROGRESS) {
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            int error = 0;
+            socklen_t error_len = sizeof(error);
+            if (poll(&pfd, 1, SENTRY_RELAY_WRITE_TIMEOUT_MS) == 1 &&
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len) == 0 &&
+                error == 0) {
+                rv = 0;
+            }
+        }
+        if (rv != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    if (fd < 0) {
+        m_reconnect_at = now + m_reconnect_delay;
+        m_reconnect_delay = std::min(
+            m_reconnect_delay * 2,
+            std::chrono::milliseconds(SENTRY_RELAY_RECONNECT_MAX_MS));
+        return false;
+    }
+
+    SENTRY_LOGF("connected to relay at %s", m_socket_path.c_str());
+    m_fd = fd;
+    m_reconnect_delay = std::chrono::milliseconds(SENTRY_RELAY_RECONNECT_MIN_MS);
+    return true;
+}
+
+void UnixSocketTransport::disconnect() {
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool UnixSocketTransport::write_frame(RequestBody &body) {
+    ScopedStatTimer timer(STAT_TIMER_REQUEST);
+    stat_add(STAT_REQUESTS_SENT);
+
+    char chunk[65536];
+    size_t len;
+    while ((len = body.read(chunk, sizeof(chunk))) > 0) {
+        if (!write_all(chunk, len)) {
+            // the relay drops a partially written frame together with the
+            // connection, so the whole frame is sent again later.
+            SENTRY_LOG("lost connection to relay");
+            stat_add(STAT_REQUESTS_FAILED);
+            disconnect();
+            m_reconnect_at = Clock::now() + m_reconnect_delay;
+            return false;
+        }
+    }
+    stat_add(STAT_BYTES_SENT, body.size());
+    return true;
+}
+
+bool UnixSocketTransport::write_all(const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t rv = send(m_fd, buf, len, SEND_FLAGS);
+        if (rv > 0) {
+            buf += rv;
+            len -= (size_t)rv;
+        } else if (rv < 0 && errno == EINTR) {
+            continue;
+        } else if (rv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd pfd = {m_fd, POLLOUT, 0};
+            int ready;
+            EINTR_RETRY(poll(&pfd, 1, SENTRY_RELAY_WRITE_TIMEOUT_MS), &ready);
+            if (ready != 1 || (pfd.revents & (POLLERR | POLLHUP))) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
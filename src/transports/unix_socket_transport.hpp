@@ -0,0 +1,58 @@
+#ifndef SENTRY_TRANSPORTS_UNIX_SOCKET_HPP_INCLUDED
+#define SENTRY_TRANSPORTS_UNIX_SOCKET_HPP_INCLUDED
+#ifndef _WIN32
+
+#include <chrono>
+#include <string>
+
+#include "../outbox.hpp"
+#include "../worker.hpp"
+#include "base_transport.hpp"
+
+namespace sentry {
+namespace transports {
+
+// hands envelopes to a local relay over a unix domain stream socket.
+//
+// Every envelope is written in its serialized form, prefixed with its
+// length as a 32 bit big endian integer.  The socket is kept open and is
+// non-blocking; writes that do not make progress within a timeout give up
+// the connection.  While the relay is unreachable envelopes are spilled to
+// an outbox below the database path and replayed in order once a new
+// connection could be established.
+class UnixSocketTransport : public Transport {
+   public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit UnixSocketTransport(const char *socket_path);
+    ~UnixSocketTransport();
+    void start();
+    void shutdown();
+    void send_envelope(Envelope envelope);
+    void report_stats(Value &stats);
+
+   private:
+    void deliver(const char *buf, size_t len);
+    bool flush_spill();
+    void spill(const char *buf, size_t len);
+    void schedule_flush();
+
+    bool ensure_connected();
+    void disconnect();
+    bool write_frame(RequestBody &body);
+    bool write_all(const char *buf, size_t len);
+
+    std::string m_socket_path;
+    BackgroundWorker m_worker;
+    Outbox m_spill;
+    int m_fd;
+    Clock::time_point m_reconnect_at;
+    std::chrono::milliseconds m_reconnect_delay;
+    bool m_flush_scheduled;
+};
+
+}  // namespace transports
+}  // namespace sentry
+
+#endif
+#endif
@@ -4,6 +4,7 @@
 #include <locale>
 
 #include "../options.hpp"
+#include "../stats.hpp"
 
 #include "winhttp_transport.hpp"
 
@@ -49,117 +50,150 @@ static void parse_http_proxy(const char *proxy, std::wstring *proxy_out) {
     }
 }
 
+void WinHttpTransport::report_stats(Value &stats) {
+    stats.set_by_key("queue_depth",
+                     Value::new_double((double)m_worker.queue_depth()));
+}
+
 void WinHttpTransport::send_envelope(Envelope envelope) {
-    this->m_worker.submit_task([this, envelope]() {
-        envelope.for_each_request([this](PreparedHttpRequest prepared_request) {
-            const sentry_options_t *opts = sentry_get_options();
-            if (opts->dsn.disabled()) {
-                return false;
-            }
-
-            ULONGLONG now = GetTickCount64();
-            if (now < m_disabled_until) {
-                return false;
-            }
-
-            if (!m_session) {
-                std::wstring user_agent;
-                const char *ptr = SENTRY_SDK_USER_AGENT;
-                while (*ptr) {
-                    user_agent.push_back(*ptr++);
+    TaskPriority priority = task_priority_for_event(envelope.get_event());
+    this->m_worker.submit_task(
+        [this, envelope]() {
+            envelope.for_each_request([this](PreparedHttpRequest &&
+                                                 prepared_request) {
+                const sentry_options_t *opts = sentry_get_options();
+                if (opts->dsn.disabled()) {
+                    return false;
                 }
 
-                std::wstring proxy;
-                if (!opts->http_proxy.empty()) {
-                    parse_http_proxy(opts->http_proxy.c_str(), &proxy);
+                ULONGLONG now = GetTickCount64();
+                if (now < m_disabled_until) {
+                    return false;
                 }
-                if (!proxy.empty()) {
-                    m_session = WinHttpOpen(
-                        user_agent.c_str(), WINHTTP_ACCESS_TYPE_NAMED_PROXY,
-                        proxy.c_str(), WINHTTP_NO_PROXY_BYPASS, 0);
-                } else {
-                    m_session = WinHttpOpen(
-                        user_agent.c_str(), WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY,
-                        WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
-                    // On windows 7, WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY does not work
-                    // on error we fallback to WINHTTP_ACCESS_TYPE_NO_PROXY
-                    if (!m_session) {
+
+                if (!m_session) {
+                    std::wstring user_agent;
+                    const char *ptr = SENTRY_SDK_USER_AGENT;
+                    while (*ptr) {
+                        user_agent.push_back(*ptr++);
+                    }
+
+                    std::wstring proxy;
+                    if (!opts->http_proxy.empty()) {
+                        parse_http_proxy(opts->http_proxy.c_str(), &proxy);
+                    }
+                    if (!proxy.empty()) {
+                        m_session = WinHttpOpen(
+                            user_agent.c_str(), WINHTTP_ACCESS_TYPE_NAMED_PROXY,
+                            proxy.c_str(), WINHTTP_NO_PROXY_BYPASS, 0);
+                    } else {
                         m_session = WinHttpOpen(
-                            user_agent.c_str(), WINHTTP_ACCESS_TYPE_NO_PROXY,
+                            user_agent.c_str(),
+                            WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY,
                             WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+                        // On windows 7, WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY
+                        // does not work on error we fallback to
+                        // WINHTTP_ACCESS_TYPE_NO_PROXY
+                        if (!m_session) {
+                            m_session = WinHttpOpen(
+                                user_agent.c_str(),
+                                WINHTTP_ACCESS_TYPE_NO_PROXY,
+                                WINHTTP_NO_PROXY_NAME,
+                                WINHTTP_NO_PROXY_BYPASS, 0);
+                        }
                     }
                 }
-            }
-
-            std::wstring store_url =
-                std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t>{}
-                    .from_bytes(opts->dsn.get_store_url());
-
-            URL_COMPONENTS url_components;
-            wchar_t hostname[128];
-            wchar_t url_path[4096];
-            memset(&url_components, 0, sizeof(URL_COMPONENTS));
-            url_components.dwStructSize = sizeof(URL_COMPONENTS);
-            url_components.lpszHostName = hostname;
-            url_components.dwHostNameLength = 128;
-            url_components.lpszUrlPath = url_path;
-            url_components.dwUrlPathLength = 1024;
-
-            WinHttpCrackUrl(store_url.c_str(), 0, 0, &url_components);
-            if (!m_connect) {
-                m_connect = WinHttpConnect(
-                    m_session,
-                    std::wstring(url_components.lpszHostName,
-                                 url_components.lpszHostName +
-                                     url_components.dwHostNameLength)
-                        .c_str(),
-                    url_components.nPort, 0);
-            }
-
-            HINTERNET request = WinHttpOpenRequest(
-                m_connect, L"POST", url_components.lpszUrlPath, nullptr,
-                WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
-                opts->dsn.is_secure() ? WINHTTP_FLAG_SECURE : 0);
-
-            std::wstringstream h;
-            for (auto iter = prepared_request.headers.begin();
-                 iter != prepared_request.headers.end(); ++iter) {
-                h << iter->c_str() << "\r\n";
-            }
-            std::wstring headers = h.str();
-
-            if (WinHttpSendRequest(request, headers.c_str(), headers.size(),
-                                   (LPVOID)prepared_request.payload.c_str(),
-                                   prepared_request.payload.size(),
-                                   prepared_request.payload.size(), 0)) {
-                DWORD status_code = 0;
-                DWORD status_code_size = sizeof(DWORD);
-
-                WinHttpQueryHeaders(
-                    request,
-                    WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
-                    WINHTTP_HEADER_NAME_BY_INDEX, &status_code,
-                    &status_code_size, WINHTTP_NO_HEADER_INDEX);
-
-                if (status_code == 429) {
-                    DWORD retry_after = 0;
-                    DWORD retry_after_size = sizeof(DWORD);
-                    if (WinHttpQueryHeaders(request,
-                                            WINHTTP_QUERY_RETRY_AFTER |
-                                                WINHTTP_QUERY_FLAG_NUMBER,
-                                            WINHTTP_HEADER_NAME_BY_INDEX,
-                                            &retry_after, &retry_after_size,
-                                            WINHTTP_NO_HEADER_INDEX)) {
-                        m_disabled_until =
-                            GetTickCount64() + retry_after * 1000;
+
+                std::wstring store_url =
+                    std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t>{}
+                        .from_bytes(opts->dsn.get_store_url());
+
+                URL_COMPONENTS url_components;
+                wchar_t hostname[128];
+                wchar_t url_path[4096];
+                memset(&url_components, 0, sizeof(URL_COMPONENTS));
+                url_components.dwStructSize = sizeof(URL_COMPONENTS);
+                url_components.lpszHostName = hostname;
+                url_components.dwHostNameLength = 128;
+                url_components.lpszUrlPath = url_path;
+                url_components.dwUrlPathLength = 1024;
+
+                WinHttpCrackUrl(store_url.c_str(), 0, 0, &url_components);
+                if (!m_connect) {
+                    m_connect = WinHttpConnect(
+                        m_session,
+                        std::wstring(url_components.lpszHostName,
+                                     url_components.lpszHostName +
+                                         url_components.dwHostNameLength)
+                            .c_str(),
+                        url_components.nPort, 0);
+                }
+
+                HINTERNET request = WinHttpOpenRequest(
+                    m_connect, L"POST", url_components.lpszUrlPath, nullptr,
+                    WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
+                    opts->dsn.is_secure() ? WINHTTP_FLAG_SECURE : 0);
+
+                std::wstringstream h;
+                for (auto iter = prepared_request.headers.begin();
+                     iter != prepared_request.headers.end(); ++iter) {
+                    h << iter->c_str() << "\r\n";
+                }
+                std::wstring headers = h.str();
+
+                // the body is streamed in chunks so that large attachments are
+                // never copied into one contiguous buffer.
+                ScopedStatTimer timer(STAT_TIMER_REQUEST);
+                stat_add(STAT_REQUESTS_SENT);
+                DWORD body_size = (DWORD)prepared_request.body.size();
+                bool sent = WinHttpSendRequest(
+                    request, headers.c_str(), headers.size(),
+                    WINHTTP_NO_REQUEST_DATA, 0, body_size, 0);
+                char chunk[65536];
+                while (sent) {
+                    size_t chunk_len =
+                        prepared_request.body.read(chunk, sizeof(chunk));
+                    if (!chunk_len) {
+                        break;
                     }
+                    DWORD written = 0;
+                    sent = WinHttpWriteData(request, chunk, (DWORD)chunk_len,
+                                            &written);
                 }
 
-                WinHttpReceiveResponse(request, nullptr);
-            }
-            WinHttpCloseHandle(request);
-            return true;
-        });
-    });
+                if (sent && WinHttpReceiveResponse(request, nullptr)) {
+                    DWORD status_code = 0;
+                    DWORD status_code_size = sizeof(DWORD);
+
+                    WinHttpQueryHeaders(
+                        request,
+                        WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                        WINHTTP_HEADER_NAME_BY_INDEX, &status_code,
+                        &status_code_size, WINHTTP_NO_HEADER_INDEX);
+                    stat_add(STAT_BYTES_SENT, body_size);
+                    stat_record_http_status(status_code);
+
+                    if (status_code == 429) {
+                        stat_add(STAT_REQUESTS_RATE_LIMITED);
+                        DWORD retry_after = 0;
+                        DWORD retry_after_size = sizeof(DWORD);
+                        if (WinHttpQueryHeaders(request,
+                                                WINHTTP_QUERY_RETRY_AFTER |
+                                                    WINHTTP_QUERY_FLAG_NUMBER,
+                                                WINHTTP_HEADER_NAME_BY_INDEX,
+                                                &retry_after, &retry_after_size,
+                                                WINHTTP_NO_HEADER_INDEX)) {
+                            m_disabled_until =
+                                GetTickCount64() + retry_after * 1000;
+                        }
+                    }
+                } else {
+                    stat_add(STAT_REQUESTS_FAILED);
+                }
+                WinHttpCloseHandle(request);
+                return true;
+            });
+        },
+        false, priority);
 }
 #endif
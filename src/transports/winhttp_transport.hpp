@@ -16,6 +16,7 @@ class WinHttpTransport : public Transport {
     void start();
     void shutdown();
     void send_envelope(Envelope envelope);
+    void report_stats(Value &stats);
 
    private:
     BackgroundWorker m_worker;
@@ -1,7 +1,10 @@
 #include <inttypes.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <cctype>
 #include <cmath>
 #include <codecvt>
+#include <cstring>
 #include <ctime>
 #include <locale>
 #include <sstream>
@@ -13,7 +16,7 @@
 
 using namespace sentry;
 
-static const char *level_as_string(sentry_level_t level) {
+const char *Value::level_name(sentry_level_t level) {
     switch (level) {
         case SENTRY_LEVEL_DEBUG:
             return "debug";
@@ -61,7 +64,7 @@ Value Value::clone() const {
             }
             case THING_TYPE_OBJECT: {
                 const Object *obj = (const Object *)as_thing()->ptr();
-                clone = Value::new_list();
+                clone = Value::new_object();
                 for (Object::const_iterator iter = obj->begin();
                      iter != obj->end(); ++iter) {
                     clone.set_by_key(iter->first.c_str(), iter->second.clone());
@@ -78,9 +81,41 @@ Value Value::clone() const {
     }
 }
 
-void Value::freeze() {
+Value Value::clone_shallow() const {
     ThingPtr thing = as_thing();
     if (!thing) {
+        return *this;
+    }
+    Value clone;
+    switch (thing->type()) {
+        case THING_TYPE_LIST: {
+            const List *list = (const List *)thing->ptr();
+            clone = Value::new_list();
+            for (List::const_iterator iter = list->begin();
+                 iter != list->end(); ++iter) {
+                clone.append(*iter);
+            }
+            break;
+        }
+        case THING_TYPE_OBJECT: {
+            const Object *obj = (const Object *)thing->ptr();
+            clone = Value::new_object();
+            for (Object::const_iterator iter = obj->begin();
+                 iter != obj->end(); ++iter) {
+                clone.set_by_key(iter->first.c_str(), iter->second);
+            }
+            break;
+        }
+        default:
+            clone = *this;
+    }
+    return clone;
+}
+
+void Value::freeze() {
+    // a frozen thing cannot gain children, so they were all frozen with it
+    ThingPtr thing = as_thing();
+    if (!thing || thing->is_frozen()) {
         return;
     }
     thing->freeze();
@@ -168,7 +203,52 @@ void Value::to_json(IoWriter &writer) const {
     to_json(jw);
 }
 
+uint32_t Value::json_depth() const {
+    uint32_t rv = 0;
+    switch (type()) {
+        case SENTRY_VALUE_TYPE_LIST: {
+            const List *list = (const List *)as_thing()->ptr();
+            for (List::const_iterator iter = list->begin(); iter != list->end();
+                 ++iter) {
+                rv = std::max(rv, iter->json_depth());
+            }
+            break;
+        }
+        case SENTRY_VALUE_TYPE_OBJECT: {
+            const Object *object = (const Object *)as_thing()->ptr();
+            for (Object::const_iterator iter = object->begin();
+                 iter != object->end(); ++iter) {
+                rv = std::max(rv, iter->second.json_depth());
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return rv + 1;
+}
+
+void Value::freeze_json() {
+    freeze();
+    ThingPtr thing = as_thing();
+    if (!thing) {
+        return;
+    }
+    MemoryIoWriter writer;
+    JsonWriter jw(writer);
+    to_json(jw);
+    thing->set_json(new std::string(writer.buf(), writer.len()),
+                    json_depth());
+}
+
 void Value::to_json(JsonWriter &jw) const {
+    {
+        ThingPtr thing = as_thing();
+        if (thing && thing->json() && jw.fits_depth(thing->json_depth())) {
+            jw.write_raw(*thing->json());
+            return;
+        }
+    }
     switch (this->type()) {
         case SENTRY_VALUE_TYPE_NULL:
             jw.write_null();
@@ -217,6 +297,387 @@ char *Value::to_json() const {
     return writer.take();
 }
 
+namespace {
+class JsonParser {
+   public:
+    JsonParser(const char *buf, size_t len)
+        : m_ptr(buf), m_end(buf + len), m_depth(0) {
+    }
+
+    bool parse_document(Value *value_out) {
+        skip_whitespace();
+        if (!parse_value(value_out)) {
+            return false;
+        }
+        skip_whitespace();
+        return m_ptr == m_end;
+    }
+
+   private:
+    void skip_whitespace() {
+        while (m_ptr < m_end && (*m_ptr == ' ' || *m_ptr == '\t' ||
+                                 *m_ptr == '\n' || *m_ptr == '\r')) {
+            m_ptr++;
+        }
+    }
+
+    bool consume_literal(const char *literal) {
+        size_t len = strlen(literal);
+        if ((size_t)(m_end - m_ptr) < len || memcmp(m_ptr, literal, len)) {
+            return false;
+        }
+        m_ptr += len;
+        return true;
+    }
+
+    bool parse_value(Value *value_out) {
+        if (m_ptr >= m_end) {
+            return false;
+        }
+        switch (*m_ptr) {
+            case '{':
+                return parse_object(value_out);
+            case '[':
+                return parse_list(value_out);
+            case '"': {
+                std::string s;
+                if (!parse_string(s)) {
+                    return false;
+                }
+                *value_out = Value::new_string(s.c_str(), s.size());
+                return true;
+            }
+            case 't':
+                *value_out = Value::new_bool(true);
+                return consume_literal("true");
+            case 'f':
+                *value_out = Value::new_bool(false);
+                return consume_literal("false");
+            case 'n':
+                *value_out = Value::new_null();
+                return consume_literal("null");
+            default:
+                return parse_number(value_out);
+        }
+    }
+
+    bool parse_object(Value *value_out) {
+        if (++m_depth > 64) {
+            return false;
+        }
+        m_ptr++;
+        Value object = Value::new_object();
+        skip_whitespace();
+        if (m_ptr < m_end && *m_ptr == '}') {
+            m_ptr++;
+        } else {
+            while (true) {
+                std::string key;
+                Value value;
+                skip_whitespace();
+                if (m_ptr >= m_end || *m_ptr != '"' || !parse_string(key)) {
+                    return false;
+                }
+                skip_whitespace();
+                if (m_ptr >= m_end || *m_ptr++ != ':') {
+                    return false;
+                }
+                skip_whitespace();
+                if (!parse_value(&value)) {
+                    return false;
+                }
+                object.set_by_key(key.c_str(), value);
+                skip_whitespace();
+                if (m_ptr >= m_end) {
+                    return false;
+                } else if (*m_ptr == '}') {
+                    m_ptr++;
+                    break;
+                } else if (*m_ptr++ != ',') {
+                    return false;
+                }
+            }
+        }
+        m_depth--;
+        *value_out = object;
+        return true;
+    }
+
+    bool parse_list(Value *value_out) {
+        if (++m_depth > 64) {
+            return false;
+        }
+        m_ptr++;
+        Value list = Value::new_list();
+        skip_whitespace();
+        if (m_ptr < m_end && *m_ptr == ']') {
+            m_ptr++;
+        } else {
+            while (true) {
+                Value value;
+                skip_whitespace();
+                if (!parse_value(&value)) {
+                    return false;
+                }
+                list.append(value);
+                skip_whitespace();
+                if (m_ptr >= m_end) {
+                    return false;
+                } else if (*m_ptr == ']') {
+                    m_ptr++;
+                    break;
+                } else if (*m_ptr++ != ',') {
+                    return false;
+                }
+            }
+        }
+        m_depth--;
+        *value_out = list;
+        return true;
+    }
+
+    bool parse_hex4(uint32_t *out) {
+        if (m_end - m_ptr < 4) {
+            return false;
+        }
+        uint32_t rv = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = *m_ptr++;
+            rv <<= 4;
+            if (c >= '0' && c <= '9') {
+                rv |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                rv |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                rv |= c - 'A' + 10;
+            } else {
+                return false;
+            }
+        }
+        *out = rv;
+        return true;
+    }
+
+    static void append_utf8(std::string &s, uint32_t cp) {
+        if (cp < 0x80) {
+            s.push_back((char)cp);
+        } else if (cp < 0x800) {
+            s.push_back((char)(0xc0 | (cp >> 6)));
+            s.push_back((char)(0x80 | (cp & 0x3f)));
+        } else if (cp < 0x10000) {
+            s.push_back((char)(0xe0 | (cp >> 12)));
+            s.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+            s.push_back((char)(0x80 | (cp & 0x3f)));
+        } else {
+            s.push_back((char)(0xf0 | (cp >> 18)));
+            s.push_back((char)(0x80 | ((cp >> 12) & 0x3f)));
+            s.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+            s.push_back((char)(0x80 | (cp & 0x3f)));
+        }
+    }
+
+    bool parse_string(std::string &out) {
+        m_ptr++;
+        while (m_ptr < m_end) {
+            // copy unescaped runs in one go
+            const char *start = m_ptr;
+            while (m_ptr < m_end && *m_ptr != '"' && *m_ptr != '\\') {
+                m_ptr++;
+            }
+            out.append(start, m_ptr - start);
+            if (m_ptr >= m_end) {
+                return false;
+            } else if (*m_ptr == '"') {
+                m_ptr++;
+                return true;
+            }
+
+            m_ptr++;
+            if (m_ptr >= m_end) {
+                return false;
+            }
+            switch (*m_ptr++) {
+                case '"':
+                    out.push_back('"');
+                    break;
+                case '\\':
+                    out.push_back('\\');
+                    break;
+                case '/':
+                    out.push_back('/');
+                    break;
+                case 'b':
+                    out.push_back('\b');
+                    break;
+                case 'f':
+                    out.push_back('\f');
+                    break;
+                case 'n':
+                    out.push_back('\n');
+                    break;
+                case 'r':
+                    out.push_back('\r');
+                    break;
+                case 't':
+                    out.push_back('\t');
+                    break;
+                case 'u': {
+                    uint32_t cp;
+                    if (!parse_hex4(&cp)) {
+                        return false;
+                    }
+                    if (cp >= 0xd800 && cp < 0xdc00) {
+                        uint32_t low;
+                        if (!consume_literal("\\u") || !parse_hex4(&low) ||
+                            low < 0xdc00 || low >= 0xe000) {
+                            return false;
+                        }
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    append_utf8(out, cp);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return false;
+    }
+
+    bool parse_number(Value *value_out) {
+        const char *start = m_ptr;
+        bool is_integer = true;
+        if (m_ptr < m_end && *m_ptr == '-') {
+            m_ptr++;
+        }
+        while (m_ptr < m_end &&
+               (isdigit((unsigned char)*m_ptr) || *m_ptr == '.' ||
+                *m_ptr == 'e' || *m_ptr == 'E' || *m_ptr == '+' ||
+                *m_ptr == '-')) {
+            if (!isdigit((unsigned char)*m_ptr)) {
+                is_integer = false;
+            }
+            m_ptr++;
+        }
+        if (m_ptr == start) {
+            return false;
+        }
+
+        // the buffer is not necessarily null terminated
+        std::string number(start, m_ptr - start);
+        char *end;
+        double val = strtod(number.c_str(), &end);
+        if (*end) {
+            return false;
+        }
+        if (is_integer && val >= INT32_MIN && val <= INT32_MAX) {
+            *value_out = Value::new_int32((int32_t)val);
+        } else {
+            *value_out = Value::new_double(val);
+        }
+        return true;
+    }
+
+    const char *m_ptr;
+    const char *m_end;
+    int m_depth;
+};
+}  // namespace
+
+bool Value::from_json(const char *buf, size_t len, Value *value_out) {
+    JsonParser parser(buf, len);
+    Value rv;
+    if (!parser.parse_document(&rv)) {
+        return false;
+    }
+    *value_out = rv;
+    return true;
+}
+
+static Value read_msgpack_value(mpack_reader_t *reader, int depth) {
+    mpack_tag_t tag = mpack_read_tag(reader);
+    if (mpack_reader_error(reader) != mpack_ok) {
+        return Value();
+    }
+    switch (mpack_tag_type(&tag)) {
+        case mpack_type_nil:
+            return Value::new_null();
+        case mpack_type_bool:
+            return Value::new_bool(mpack_tag_bool_value(&tag));
+        case mpack_type_int: {
+            int64_t val = mpack_tag_int_value(&tag);
+            return val >= INT32_MIN && val <= INT32_MAX
+                       ? Value::new_int32((int32_t)val)
+                       : Value::new_double((double)val);
+        }
+        case mpack_type_uint: {
+            uint64_t val = mpack_tag_uint_value(&tag);
+            return val <= INT32_MAX ? Value::new_int32((int32_t)val)
+                                    : Value::new_double((double)val);
+        }
+        case mpack_type_float:
+            return Value::new_double(mpack_tag_float_value(&tag));
+        case mpack_type_double:
+            return Value::new_double(mpack_tag_double_value(&tag));
+        case mpack_type_str: {
+            uint32_t len = mpack_tag_str_length(&tag);
+            const char *data = mpack_read_bytes_inplace(reader, len);
+            mpack_done_str(reader);
+            if (mpack_reader_error(reader) != mpack_ok) {
+                return Value();
+            }
+            return Value::new_string(data, len);
+        }
+        case mpack_type_array: {
+            if (depth > 64) {
+                mpack_reader_flag_error(reader, mpack_error_too_big);
+                return Value();
+            }
+            uint32_t count = mpack_tag_array_count(&tag);
+            Value list = Value::new_list();
+            for (uint32_t i = 0; i < count; i++) {
+                list.append(read_msgpack_value(reader, depth + 1));
+            }
+            mpack_done_array(reader);
+            return list;
+        }
+        case mpack_type_map: {
+            if (depth > 64) {
+                mpack_reader_flag_error(reader, mpack_error_too_big);
+                return Value();
+            }
+            uint32_t count = mpack_tag_map_count(&tag);
+            Value object = Value::new_object();
+            for (uint32_t i = 0; i < count; i++) {
+                Value key = read_msgpack_value(reader, depth + 1);
+                Value value = read_msgpack_value(reader, depth + 1);
+                if (key.type() != SENTRY_VALUE_TYPE_STRING) {
+                    mpack_reader_flag_error(reader, mpack_error_type);
+                    return Value();
+                }
+                object.set_by_key(key.as_cstr(), value);
+            }
+            mpack_done_map(reader);
+            return object;
+        }
+        default:
+            mpack_reader_flag_error(reader, mpack_error_unsupported);
+            return Value();
+    }
+}
+
+bool Value::from_msgpack(const char *buf, size_t len, Value *value_out) {
+    mpack_reader_t reader;
+    mpack_reader_init_data(&reader, buf, len);
+    Value rv = read_msgpack_value(&reader, 0);
+    size_t remaining = mpack_reader_remaining(&reader, nullptr);
+    if (mpack_reader_destroy(&reader) != mpack_ok || remaining != 0) {
+        return false;
+    }
+    *value_out = rv;
+    return true;
+}
+
 #ifdef _WIN32
 Value Value::new_string(const wchar_t *s) {
     std::string str =
@@ -232,7 +693,7 @@ Value Value::new_uuid(const sentry_uuid_t *uuid) {
 }
 
 Value Value::new_level(sentry_level_t level) {
-    return Value::new_string(level_as_string(level));
+    return Value::new_string(level_name(level));
 }
 
 Value Value::new_hexstring(const char *bytes, size_t len) {
@@ -348,6 +809,22 @@ bool Value::merge_key(const char *key, Value value) {
     return true;
 }
 
+bool Value::merge_key_copy(const char *key, Value value) {
+    if (value.type() != SENTRY_VALUE_TYPE_OBJECT) {
+        return merge_key(key, value);
+    }
+    Value copy = Value::new_object();
+    {
+        ThingPtr thing = value.as_thing();
+        const Object *obj = (const Object *)thing->ptr();
+        for (Object::const_iterator iter = obj->begin(); iter != obj->end();
+             ++iter) {
+            copy.set_by_key(iter->first.c_str(), iter->second.clone_shallow());
+        }
+    }
+    return merge_key(key, copy);
+}
+
 uint64_t Value::as_addr() const {
     if (type() == SENTRY_VALUE_TYPE_INT32) {
         return (uint64_t)as_int32();
@@ -35,10 +35,13 @@ class Thing {
         : m_payload(ptr),
           m_type(type),
           m_refcount(1),
-          m_frozen(type == THING_TYPE_STRING) {
+          m_frozen(type == THING_TYPE_STRING),
+          m_json(nullptr),
+          m_json_depth(0) {
     }
 
     ~Thing() {
+        delete m_json;
         switch (m_type) {
             case THING_TYPE_STRING:
                 delete (std::string *)m_payload;
@@ -74,6 +77,22 @@ class Thing {
         return m_frozen;
     }
 
+    // the serialized json of a frozen thing, which is written as is instead
+    // of walking the thing again.  `depth` is how deeply it is nested.
+    const std::string *json() const {
+        return m_json;
+    }
+
+    uint32_t json_depth() const {
+        return m_json_depth;
+    }
+
+    void set_json(std::string *json, uint32_t depth) {
+        delete m_json;
+        m_json = json;
+        m_json_depth = depth;
+    }
+
     ThingType type() const {
         return m_type;
     }
@@ -110,6 +129,8 @@ class Thing {
     void *m_payload;
     ThingType m_type;
     bool m_frozen;
+    std::string *m_json;
+    uint32_t m_json_depth;
     std::atomic_size_t m_refcount;
     std::recursive_mutex m_lock;
 };
@@ -215,6 +236,9 @@ class Value {
         m_repr._bits = (((uint64_t) new Thing(ptr, type)) >> 2) | TAG_THING;
     }
 
+    // how many levels of json nesting writing this value takes
+    uint32_t json_depth() const;
+
    public:
     Value() {
         set_null_unsafe();
@@ -284,6 +308,10 @@ class Value {
 
     void freeze();
 
+    // freezes the value and keeps its serialized json around, so that
+    // values which are shared by many events are only serialized once.
+    void freeze_json();
+
     size_t refcount() const {
         ThingPtr thing = as_thing();
         if (thing) {
@@ -295,6 +323,9 @@ class Value {
 
     Value clone() const;
 
+    // copies a list or object without copying the values inside of it.
+    Value clone_shallow() const;
+
     static Value new_double(double val) {
         // if we are a nan value we want to become the max double value which
         // is a NAN.
@@ -347,6 +378,8 @@ class Value {
 
     static Value new_uuid(const sentry_uuid_t *uuid);
     static Value new_level(sentry_level_t level);
+    // the name `new_level` uses for `level`.
+    static const char *level_name(sentry_level_t level);
     static Value new_hexstring(const char *bytes, size_t len);
     static Value new_addr(uint64_t addr);
     static Value new_event();
@@ -434,6 +467,10 @@ class Value {
 
     bool merge_key(const char *key, Value value);
 
+    // like `merge_key`, but the items of an object are merged in as shallow
+    // copies, which can be modified even if the originals are frozen.
+    bool merge_key_copy(const char *key, Value value);
+
     bool append_bounded(Value value, size_t maxItems) {
         ThingPtr thing = as_unfrozen_thing();
         if (thing && thing->type() == THING_TYPE_LIST) {
@@ -555,6 +592,14 @@ class Value {
     void to_json(sentry::JsonWriter &out) const;
     char *to_json() const;
 
+    // parses a JSON document.  Integers that fit are stored as int32, all
+    // other numbers as doubles.
+    static bool from_json(const char *buf, size_t len, Value *value_out);
+
+    // decodes a single msgpack value as written by `to_msgpack`.  Binary
+    // data and extension types are not supported.
+    static bool from_msgpack(const char *buf, size_t len, Value *value_out);
+
     sentry_value_t lower() {
         sentry_value_t rv;
         rv._bits = m_repr._bits;
@@ -1,10 +1,32 @@
 #include <chrono>
+#include <cstring>
 
 #include "worker.hpp"
 
 using namespace sentry;
 
-BackgroundWorker::BackgroundWorker() : m_running(false) {
+TaskPriority sentry::task_priority_for_event(const Value &event) {
+    Value level = event.get_by_key("level");
+    if (level.type() != SENTRY_VALUE_TYPE_STRING) {
+        return TASK_PRIORITY_DEFAULT;
+    }
+    if (strcmp(level.as_cstr(), "fatal") == 0) {
+        return TASK_PRIORITY_FATAL;
+    }
+    if (strcmp(level.as_cstr(), "error") == 0) {
+        return TASK_PRIORITY_ERROR;
+    }
+    return TASK_PRIORITY_DEFAULT;
+}
+
+BackgroundWorker::BackgroundWorker(size_t max_tasks)
+    : m_max_tasks(max_tasks), m_running(false), m_stopping(false) {
+}
+
+BackgroundWorker::~BackgroundWorker() {
+    if (m_thread.joinable()) {
+        m_thread.detach();
+    }
 }
 
 void BackgroundWorker::start() {
@@ -17,72 +39,146 @@ void BackgroundWorker::start() {
     m_thread = std::thread([this]() {
         while (m_running) {
             std::function<void()> *task = nullptr;
-            bool got_task = false;
             {
-                std::lock_guard<std::mutex> _lock(m_task_lock);
-                if (!m_tasks.empty()) {
-                    task = m_tasks.front();
-                    m_tasks.pop_front();
-                    got_task = true;
+                std::unique_lock<std::mutex> lock(m_task_lock);
+                promote_delayed_tasks_locked();
+                if (!pop_task_locked(&task)) {
+                    if (m_delayed_tasks.empty()) {
+                        m_wake.wait_for(lock, std::chrono::seconds(5));
+                    } else {
+                        m_wake.wait_until(lock, m_delayed_tasks.begin()->first);
+                    }
+                    continue;
                 }
             }
 
-            if (!got_task) {
-                std::unique_lock<std::mutex> lock(m_wake_lock);
-                m_wake.wait_for(lock, std::chrono::seconds(5));
-            } else if (task) {
+            m_space.notify_all();
+            if (task) {
                 (*task)();
+                delete task;
             } else {
                 m_running = false;
-                m_wake.notify_one();
             }
         }
+
+        {
+            std::lock_guard<std::mutex> _lock(m_task_lock);
+            for (auto &delayed : m_delayed_tasks) {
+                delete delayed.second;
+            }
+            m_delayed_tasks.clear();
+            m_stopping = false;
+        }
         SENTRY_LOG("background worker shut down");
     });
-    m_thread.detach();
 }
 
 void BackgroundWorker::kill() {
     SENTRY_LOG("killing background worker");
     {
         std::lock_guard<std::mutex> _lock(m_task_lock);
-        m_tasks.push_back(nullptr);
+        m_tasks[TASK_PRIORITY_DEFAULT].push_back(nullptr);
+        m_stopping = true;
     }
     m_wake.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.detach();
+    }
 }
 
-void BackgroundWorker::shutdown() {
+void BackgroundWorker::shutdown(bool join) {
     SENTRY_LOG("shutting down background worker");
     {
         std::lock_guard<std::mutex> _lock(m_task_lock);
-        m_tasks.push_back(nullptr);
+        m_tasks[TASK_PRIORITY_DEFAULT].push_back(nullptr);
+        m_stopping = true;
     }
     m_wake.notify_all();
 
-    std::chrono::system_clock::time_point started =
-        std::chrono::system_clock::now();
-    while (true) {
-        {
-            std::lock_guard<std::mutex> _lock(m_task_lock);
-            if (m_tasks.empty()) {
-                break;
-            }
+    bool drained = join;
+    if (!join) {
+        std::unique_lock<std::mutex> lock(m_task_lock);
+        drained =
+            m_space.wait_for(lock, std::chrono::seconds(5),
+                             [this]() { return queue_depth_locked() == 0; });
+    }
+
+    // once the shutdown marker was picked up the thread is about to exit, so
+    // we can wait for it.  Otherwise we leave it running in the background.
+    if (m_thread.joinable()) {
+        if (drained) {
+            m_thread.join();
+        } else {
+            m_thread.detach();
         }
-        std::unique_lock<std::mutex> lock(m_wake_lock);
-        m_wake.wait_for(lock, std::chrono::seconds(1));
+    }
+}
 
-        std::chrono::duration<double> diff =
-            std::chrono::system_clock::now() - started;
-        if (diff.count() >= 5.0) {
-            break;
+bool BackgroundWorker::submit_task(std::function<void()> task,
+                                   bool wait,
+                                   TaskPriority priority) {
+    {
+        std::unique_lock<std::mutex> lock(m_task_lock);
+        while (m_max_tasks && priority != TASK_PRIORITY_FATAL &&
+               queue_depth_locked() >= m_max_tasks) {
+            if (!wait) {
+                return false;
+            }
+            m_space.wait_for(lock, std::chrono::milliseconds(100));
         }
+        m_tasks[priority].push_back(new std::function<void()>(task));
     }
+    m_wake.notify_one();
+    return true;
 }
 
-void BackgroundWorker::submit_task(std::function<void()> task) {
+void BackgroundWorker::submit_delayed_task(std::function<void()> task,
+                                           std::chrono::milliseconds delay) {
     {
         std::lock_guard<std::mutex> _lock(m_task_lock);
-        m_tasks.push_back(new std::function<void()>(task));
+        m_delayed_tasks.emplace(std::chrono::steady_clock::now() + delay,
+                                new std::function<void()>(task));
     }
+    // wakes up the worker so it sleeps until the new deadline if it is
+    // earlier than the one it currently waits for
     m_wake.notify_one();
 }
+
+size_t BackgroundWorker::queue_depth() {
+    std::lock_guard<std::mutex> _lock(m_task_lock);
+    return queue_depth_locked();
+}
+
+size_t BackgroundWorker::queue_depth_locked() const {
+    size_t rv = 0;
+    for (size_t i = 0; i < TASK_PRIORITY_COUNT; i++) {
+        rv += m_tasks[i].size();
+    }
+    return rv;
+}
+
+bool BackgroundWorker::pop_task_locked(std::function<void()> **task_out) {
+    for (size_t i = 0; i < TASK_PRIORITY_COUNT; i++) {
+        if (!m_tasks[i].empty()) {
+            *task_out = m_tasks[i].front();
+            m_tasks[i].pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void BackgroundWorker::promote_delayed_tasks_locked() {
+    // nothing may be queued behind the shutdown marker
+    if (m_stopping) {
+        return;
+    }
+
+    std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    while (!m_delayed_tasks.empty() && m_delayed_tasks.begin()->first <= now) {
+        m_tasks[TASK_PRIORITY_DEFAULT].push_back(
+            m_delayed_tasks.begin()->second);
+        m_delayed_tasks.erase(m_delayed_tasks.begin());
+    }
+}
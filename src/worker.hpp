@@ -1,9 +1,11 @@
 #ifndef SENTRY_WORKER_HPP_INCLUDED
 #define SENTRY_WORKER_HPP_INCLUDED
 
+#include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <functional>
+#include <map>
 #include <mutex>
 #include <thread>
 
@@ -11,21 +13,64 @@
 
 namespace sentry {
 
+// the lanes of the worker queue.  A task only runs once all lanes before
+// its own are empty, so fatal events never wait behind a backlog.
+enum TaskPriority {
+    TASK_PRIORITY_FATAL,
+    TASK_PRIORITY_ERROR,
+    TASK_PRIORITY_DEFAULT,
+    TASK_PRIORITY_COUNT,
+};
+
+// returns the lane for an event based on its level.
+TaskPriority task_priority_for_event(const Value &event);
+
 class BackgroundWorker {
    public:
-    BackgroundWorker();
+    // a `max_tasks` of 0 means the queue is unbounded.
+    explicit BackgroundWorker(size_t max_tasks = 0);
+    ~BackgroundWorker();
     void start();
     void kill();
-    void shutdown();
-    void submit_task(std::function<void()> task);
+
+    // runs the queued tasks and stops the worker.  If the queue does not
+    // drain within a few seconds the thread is left running in the
+    // background, unless `join` is set: owners whose tasks refer back to
+    // them must not go away before the thread has exited.
+    void shutdown(bool join = false);
+
+    // submits a task to the worker.  If the queue is bounded and full this
+    // either returns `false` or, if `wait` is set, blocks until there is
+    // room again.  Fatal tasks are always accepted.
+    bool submit_task(std::function<void()> task,
+                     bool wait = false,
+                     TaskPriority priority = TASK_PRIORITY_DEFAULT);
+
+    // submits a task that becomes runnable once `delay` has passed.  Delayed
+    // tasks do not count against the queue bound and are discarded if the
+    // worker shuts down before they are due.
+    void submit_delayed_task(std::function<void()> task,
+                             std::chrono::milliseconds delay);
+
+    // returns the number of tasks waiting to run, not counting delayed ones.
+    size_t queue_depth();
 
    private:
+    void promote_delayed_tasks_locked();
+    size_t queue_depth_locked() const;
+    bool pop_task_locked(std::function<void()> **task_out);
+
     std::condition_variable m_wake;
-    std::mutex m_wake_lock;
+    std::condition_variable m_space;
     std::mutex m_task_lock;
-    std::deque<std::function<void()> *> m_tasks;
+    std::deque<std::function<void()> *> m_tasks[TASK_PRIORITY_COUNT];
+    std::multimap<std::chrono::steady_clock::time_point,
+                  std::function<void()> *>
+        m_delayed_tasks;
     std::thread m_thread;
+    size_t m_max_tasks;
     bool m_running;
+    bool m_stopping;
 };
 
 }  // namespace sentry
@@ -0,0 +1,394 @@
+// measures throughput and latency of the libcurl transport against the
+// loopback stand-in server.
+//
+//     bench_transport [scenario] [events]
+//
+// Without a scenario all of them are run.  The `relay` scenario sends to the
+// reference relay receiver over a unix domain socket instead and the
+// `file_sink` scenario writes to rotating files.  For every scenario this
+// reports the events per second until the last event was accepted, the p50
+// and p99 latency from `sentry_capture_event` to the server accepting the
+// event and the number of bytes the server received.  The file sink has no
+// per event acknowledgement and only reports its throughput.
+#include <sentry.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef SENTRY_WITH_LIBCURL_TRANSPORT
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <options.hpp>
+#include <transports/libcurl_transport.hpp>
+#include "../relayreceiver.hpp"
+#include "../testserver.hpp"
+
+using namespace sentry::transports;
+typedef std::chrono::steady_clock Clock;
+
+struct Scenario {
+    const char *name;
+    size_t default_events;
+    void (*configure)(TestServer &server, size_t events);
+    // batches envelopes for this long if not 0
+    uint64_t batch_linger_ms;
+};
+
+static void configure_ok(TestServer &server, size_t events) {
+}
+
+static void configure_latency(TestServer &server, size_t events) {
+    TestResponse response;
+    response.latency = std::chrono::milliseconds(5);
+    server.set_default_response(response);
+}
+
+static void configure_rate_limited(TestServer &server, size_t events) {
+    for (size_t i = 0; i < events / 2; i++) {
+        server.push_response(TestResponse());
+    }
+    TestResponse response(429);
+    response.retry_after = 1;
+    server.push_response(response);
+}
+
+static void configure_errors(TestServer &server, size_t events) {
+    // every fourth request fails
+    for (size_t i = 0; i < events; i++) {
+        server.push_response(TestResponse(i % 4 == 3 ? 500 : 200));
+    }
+}
+
+static void configure_slow_reads(TestServer &server, size_t events) {
+    TestResponse response;
+    response.read_delay = std::chrono::milliseconds(1);
+    server.set_default_response(response);
+}
+
+static void configure_resets(TestServer &server, size_t events) {
+    // every tenth connection is reset
+    for (size_t i = 0; i < events; i++) {
+        TestResponse response;
+        response.reset = i % 10 == 9;
+        server.push_response(response);
+    }
+}
+
+static const Scenario SCENARIOS[] = {
+    {"ok", 2000, configure_ok, 0},
+    {"latency", 500, configure_latency, 0},
+    {"rate_limited", 1000, configure_rate_limited, 0},
+    {"errors", 1000, configure_errors, 0},
+    {"slow_reads", 200, configure_slow_reads, 0},
+    {"resets", 1000, configure_resets, 0},
+    {"batched", 2000, configure_ok, 20},
+};
+
+static std::string extract_event_id(const std::string &body) {
+    const char *key = "\"event_id\":\"";
+    size_t start = body.find(key);
+    if (start == std::string::npos) {
+        return std::string();
+    }
+    start += strlen(key);
+    return body.substr(start, body.find('"', start) - start);
+}
+
+static double percentile(std::vector<double> &values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+static bool run_scenario(const Scenario &scenario, size_t events) {
+    sentry::Path database("sentry-bench-database");
+    database.remove_all();
+
+    TestServer server;
+    if (!server.start()) {
+        fprintf(stderr, "failed to start server\n");
+        return false;
+    }
+    scenario.configure(server, events);
+
+    RetryPolicy policy;
+    policy.initial_backoff = std::chrono::milliseconds(10);
+    policy.max_backoff = std::chrono::milliseconds(100);
+    // the scripted failures may hit the same event repeatedly
+    policy.max_attempts = 20;
+    policy.breaker_threshold = 1000;
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, server.dsn().c_str());
+    sentry_options_set_database_path(options, database.as_osstr());
+    delete options->transport;
+    options->transport = new LibcurlTransport(policy);
+    sentry_options_set_batching(options, scenario.batch_linger_ms, 0);
+    sentry_init(options);
+
+    std::map<std::string, Clock::time_point> submitted;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < events; i++) {
+        sentry_value_t event = sentry_value_new_event();
+        sentry_value_set_by_key(event, "message",
+                                sentry_value_new_string("benchmark event"));
+        Clock::time_point submitted_at = Clock::now();
+        sentry_uuid_t uuid = sentry_capture_event(event);
+        char uuid_str[40];
+        sentry_uuid_as_string(&uuid, uuid_str);
+        submitted[uuid_str] = submitted_at;
+    }
+    Clock::time_point submitted_all = Clock::now();
+
+    // stops waiting once the server did not see a request for a while
+    std::map<std::string, Clock::time_point> accepted;
+    for (size_t seen = 0;;) {
+        std::vector<TestRequest> requests = server.requests();
+        for (; seen < requests.size(); seen++) {
+            if (requests[seen].status == 200) {
+                accepted.emplace(extract_event_id(requests[seen].body),
+                                 requests[seen].received_at);
+            }
+        }
+        if (accepted.size() >= events ||
+            !server.wait_for_requests(seen + 1, std::chrono::seconds(5))) {
+            break;
+        }
+    }
+    Clock::time_point end = Clock::now();
+    sentry_shutdown();
+
+    std::vector<double> latencies;
+    for (auto &item : accepted) {
+        auto iter = submitted.find(item.first);
+        if (iter != submitted.end()) {
+            latencies.push_back(
+                std::chrono::duration<double, std::milli>(item.second -
+                                                          iter->second)
+                    .count());
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(end - start).count();
+    double submit_time =
+        std::chrono::duration<double, std::milli>(submitted_all - start)
+            .count();
+    printf(
+        "%-14s %6zu events %6zu accepted %9.1f events/s  submit %8.1fms  "
+        "p50 %8.1fms  p99 %8.1fms  %9zu bytes  %6zu requests\n",
+        scenario.name, events, accepted.size(), accepted.size() / elapsed,
+        submit_time, percentile(latencies, 0.5), percentile(latencies, 0.99),
+        server.bytes_received(), server.request_count());
+
+    server.stop();
+    database.remove_all();
+    return accepted.size() == events;
+}
+
+static bool run_relay(size_t events) {
+    sentry::Path database("sentry-bench-database");
+    database.remove_all();
+    const char *socket_path = "sentry-bench-relay.sock";
+
+    RelayReceiver receiver;
+    if (!receiver.start(socket_path)) {
+        fprintf(stderr, "failed to start relay receiver\n");
+        return false;
+    }
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/42");
+    sentry_options_set_database_path(options, database.as_osstr());
+    sentry_options_set_relay_socket(options, socket_path);
+    sentry_init(options);
+
+    std::vector<Clock::time_point> submitted;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < events; i++) {
+        sentry_value_t event = sentry_value_new_event();
+        sentry_value_set_by_key(event, "message",
+                                sentry_value_new_string("benchmark event"));
+        submitted.push_back(Clock::now());
+        sentry_capture_event(event);
+    }
+    Clock::time_point submitted_all = Clock::now();
+    receiver.wait_for_frames(events, std::chrono::seconds(30));
+    Clock::time_point end = Clock::now();
+    sentry_shutdown();
+
+    // the transport preserves the order of envelopes
+    std::vector<RelayFrame> frames = receiver.frames();
+    std::vector<double> latencies;
+    for (size_t i = 0; i < frames.size() && i < submitted.size(); i++) {
+        latencies.push_back(std::chrono::duration<double, std::milli>(
+                                frames[i].received_at - submitted[i])
+                                .count());
+    }
+
+    double elapsed = std::chrono::duration<double>(end - start).count();
+    double submit_time =
+        std::chrono::duration<double, std::milli>(submitted_all - start)
+            .count();
+    printf(
+        "%-14s %6zu events %6zu accepted %9.1f events/s  submit %8.1fms  "
+        "p50 %8.1fms  p99 %8.1fms  %9zu bytes\n",
+        "relay", events, frames.size(), frames.size() / elapsed, submit_time,
+        percentile(latencies, 0.5), percentile(latencies, 0.99),
+        receiver.bytes_received());
+
+    receiver.stop();
+    database.remove_all();
+    return frames.size() == events;
+}
+
+static bool run_file_sink(size_t events) {
+    sentry::Path directory("sentry-bench-file-sink");
+    directory.remove_all();
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/42");
+    sentry_options_set_file_sink(options, directory.as_osstr(), 1024 * 1024, 0,
+                                 SENTRY_FILE_SINK_SYNC_BATCH);
+    sentry_init(options);
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < events; i++) {
+        sentry_value_t event = sentry_value_new_event();
+        sentry_value_set_by_key(event, "message",
+                                sentry_value_new_string("benchmark event"));
+        sentry_capture_event(event);
+    }
+    Clock::time_point submitted_all = Clock::now();
+    // shutting down waits until everything is on disk
+    sentry_shutdown();
+    Clock::time_point end = Clock::now();
+
+    size_t written = 0;
+    size_t bytes = 0;
+    sentry::PathIterator iter = directory.iter_directory();
+    while (iter.next()) {
+        size_t size = 0;
+        iter.path()->get_size(&size);
+        if (iter.path()->ends_with(".index")) {
+            FILE *f = iter.path()->open("rb");
+            int c;
+            while (f && (c = fgetc(f)) != EOF) {
+                written += c == '\n';
+            }
+            if (f) {
+                fclose(f);
+            }
+        } else {
+            bytes += size;
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(end - start).count();
+    double submit_time =
+        std::chrono::duration<double, std::milli>(submitted_all - start)
+            .count();
+    printf(
+        "%-14s %6zu events %6zu written  %9.1f events/s  submit %8.1fms  "
+        "%9zu bytes\n",
+        "file_sink", events, written, written / elapsed, submit_time, bytes);
+
+    directory.remove_all();
+    return written == events;
+}
+
+int main(int argc, char **argv) {
+    const char *only = argc > 1 ? argv[1] : nullptr;
+    size_t events = argc > 2 ? strtoul(argv[2], nullptr, 10) : 0;
+    bool ok = true;
+    bool found = false;
+
+    for (const Scenario &scenario : SCENARIOS) {
+        if (only && strcmp(only, scenario.name) != 0) {
+            continue;
+        }
+        found = true;
+        ok = run_scenario(scenario, events ? events : scenario.default_events) &&
+             ok;
+    }
+    if (!only || strcmp(only, "relay") == 0) {
+        found = true;
+        ok = run_relay(events ? events : 2000) && ok;
+    }
+    if (!only || strcmp(only, "file_sink") == 0) {
+        found = true;
+        ok = run_file_sink(events ? events : 50000) && ok;
+    }
+
+    if (!found) {
+        fprintf(stderr, "unknown scenario %s\n", only);
+        return 2;
+    }
+    return ok ? 0 : 1;
+}
+#else
+static bool run_file_sink(size_t events) {
+    sentry::Path directory("sentry-bench-file-sink");
+    directory.remove_all();
+
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/42");
+    sentry_options_set_file_sink(options, directory.as_osstr(), 1024 * 1024, 0,
+                                 SENTRY_FILE_SINK_SYNC_BATCH);
+    sentry_init(options);
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < events; i++) {
+        sentry_value_t event = sentry_value_new_event();
+        sentry_value_set_by_key(event, "message",
+                                sentry_value_new_string("benchmark event"));
+        sentry_capture_event(event);
+    }
+    Clock::time_point submitted_all = Clock::now();
+    // shutting down waits until everything is on disk
+    sentry_shutdown();
+    Clock::time_point end = Clock::now();
+
+    size_t written = 0;
+    size_t bytes = 0;
+    sentry::PathIterator iter = directory.iter_directory();
+    while (iter.next()) {
+        size_t size = 0;
+        iter.path()->get_size(&size);
+        if (iter.path()->ends_with(".index")) {
+            FILE *f = iter.path()->open("rb");
+            int c;
+            while (f && (c = fgetc(f)) != EOF) {
+                written += c == '\n';
+            }
+            if (f) {
+                fclose(f);
+            }
+        } else {
+            bytes += size;
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(end - start).count();
+    double submit_time =
+        std::chrono::duration<double, std::milli>(submitted_all - start)
+            .count();
+    printf(
+        "%-14s %6zu events %6zu written  %9.1f events/s  submit %8.1fms  "
+        "%9zu bytes\n",
+        "file_sink", events, written, written / elapsed, submit_time, bytes);
+
+    directory.remove_all();
+    return written == events;
+}
+
+int main(int argc, char **argv) {
+    fprintf(stderr, "the transport benchmark requires libcurl\n");
+    return 1;
+}
+#endif
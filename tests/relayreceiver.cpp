@@ -0,0 +1,143 @@
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+
+#include "relayreceiver.hpp"
+
+RelayReceiver::RelayReceiver()
+    : m_listen_fd(-1), m_running(false), m_bytes_received(0) {
+}
+
+RelayReceiver::~RelayReceiver() {
+    stop();
+}
+
+bool RelayReceiver::start(const std::string &path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size());
+
+    unlink(path.c_str());
+    m_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listen_fd < 0) {
+        return false;
+    }
+    if (bind(m_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(m_listen_fd, 16) != 0) {
+        close(m_listen_fd);
+        m_listen_fd = -1;
+        return false;
+    }
+
+    m_path = path;
+    m_running = true;
+    m_thread = std::thread([this]() { serve(); });
+    return true;
+}
+
+void RelayReceiver::stop() {
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+    m_thread.join();
+    for (std::thread &connection : m_connections) {
+        connection.join();
+    }
+    m_connections.clear();
+    close(m_listen_fd);
+    m_listen_fd = -1;
+    unlink(m_path.c_str());
+}
+
+std::vector<RelayFrame> RelayReceiver::frames() const {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    return m_frames;
+}
+
+size_t RelayReceiver::frame_count() const {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    return m_frames.size();
+}
+
+size_t RelayReceiver::bytes_received() const {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    return m_bytes_received;
+}
+
+bool RelayReceiver::wait_for_frames(size_t count,
+                                    std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_lock);
+    return m_frame_received.wait_for(
+        lock, timeout, [this, count]() { return m_frames.size() >= count; });
+}
+
+static bool wait_readable(int fd, const std::atomic<bool> &running) {
+    while (running) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        int rv = poll(&pfd, 1, 50);
+        if (rv > 0) {
+            return true;
+        } else if (rv < 0) {
+            return false;
+        }
+    }
+    return false;
+}
+
+void RelayReceiver::serve() {
+    while (wait_readable(m_listen_fd, m_running)) {
+        int fd = accept(m_listen_fd, nullptr, nullptr);
+        if (fd >= 0) {
+            m_connections.push_back(std::thread([this, fd]() {
+                handle_connection(fd);
+                close(fd);
+            }));
+        }
+    }
+}
+
+void RelayReceiver::handle_connection(int fd) {
+    std::string buf;
+    char chunk[65536];
+    while (wait_readable(fd, m_running)) {
+        ssize_t len = recv(fd, chunk, sizeof(chunk), 0);
+        if (len <= 0) {
+            return;
+        }
+        buf.append(chunk, (size_t)len);
+
+        size_t offset = 0;
+        while (buf.size() - offset >= 4) {
+            const unsigned char *header =
+                (const unsigned char *)buf.data() + offset;
+            size_t frame_len = ((size_t)header[0] << 24) |
+                               ((size_t)header[1] << 16) |
+                               ((size_t)header[2] << 8) | (size_t)header[3];
+            if (buf.size() - offset - 4 < frame_len) {
+                break;
+            }
+            RelayFrame frame;
+            frame.envelope = buf.substr(offset + 4, frame_len);
+            frame.received_at = std::chrono::steady_clock::now();
+            offset += 4 + frame_len;
+
+            std::lock_guard<std::mutex> _lock(m_lock);
+            m_frames.push_back(frame);
+            m_bytes_received += 4 + frame_len;
+            m_frame_received.notify_all();
+        }
+        buf.erase(0, offset);
+    }
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SENTRY_TESTS_RELAYRECEIVER_HPP_INCLUDED
+#define SENTRY_TESTS_RELAYRECEIVER_HPP_INCLUDED
+#ifndef _WIN32
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct RelayFrame {
+    std::string envelope;
+    std::chrono::steady_clock::time_point received_at;
+};
+
+// a reference receiver for the unix socket transport.  It accepts
+// connections on a unix domain socket and reads length prefixed envelopes
+// from them.  A partial frame at the end of a connection is discarded.
+class RelayReceiver {
+   public:
+    RelayReceiver();
+    ~RelayReceiver();
+
+    bool start(const std::string &path);
+    void stop();
+
+    std::vector<RelayFrame> frames() const;
+    size_t frame_count() const;
+    size_t bytes_received() const;
+    bool wait_for_frames(size_t count, std::chrono::milliseconds timeout);
+
+   private:
+    void serve();
+    void handle_connection(int fd);
+
+    std::string m_path;
+    int m_listen_fd;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+    std::vector<std::thread> m_connections;
+    mutable std::mutex m_lock;
+    std::condition_variable m_frame_received;
+    std::vector<RelayFrame> m_frames;
+    size_t m_bytes_received;
+};
+
+#endif
+#endif
@@ -1,5 +1,14 @@
 #include <sentry.h>
+#include <signal.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+#include <atomic>
+#include <breadcrumbs.hpp>
+#include <scope.hpp>
 #include <string>
+#include <thread>
 #include <value.hpp>
 #include <vector>
 #include <vendor/catch.hpp>
@@ -105,6 +114,117 @@ TEST_CASE("send event with before_send callback", "[api]") {
     }
 }
 
+static sentry_value_t scrub_before_send(sentry_value_t event,
+                                        void *hint,
+                                        void *data) {
+    sentry_value_t user = sentry_value_get_by_key(event, "user");
+    *(int *)data += sentry_value_set_by_key(user, "email",
+                                            sentry_value_new_string("x"));
+    sentry_value_t os = sentry_value_get_by_key(
+        sentry_value_get_by_key(event, "contexts"), "os");
+    *(int *)data +=
+        sentry_value_set_by_key(os, "name", sentry_value_new_string("x"));
+    return event;
+}
+
+TEST_CASE("before_send can modify values from the scope", "[api]") {
+    int failures = 0;
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/1");
+    sentry_options_set_before_send(options, scrub_before_send, &failures);
+
+    WITH_MOCK_TRANSPORT(options) {
+        sentry_value_t user = sentry_value_new_object();
+        sentry_value_set_by_key(user, "email",
+                                sentry_value_new_string("me@example.com"));
+        sentry_set_user(user);
+        sentry_value_t os = sentry_value_new_object();
+        sentry_value_set_by_key(os, "name", sentry_value_new_string("linux"));
+        sentry_set_context("os", os);
+
+        sentry_capture_event(sentry_value_new_event());
+        sentry_capture_event(sentry_value_new_event());
+
+        REQUIRE(failures == 0);
+        REQUIRE(mock_transport.events.size() == 2);
+        sentry::Value event_out = mock_transport.events[1];
+        REQUIRE(event_out.navigate("user.email").as_cstr() ==
+                std::string("x"));
+        REQUIRE(event_out.navigate("contexts.os.name").as_cstr() ==
+                std::string("x"));
+
+        // the scope itself is left alone
+        sentry::Scope::with_scope([](const sentry::Scope &scope) {
+            REQUIRE(scope.user.get_by_key("email").as_cstr() ==
+                    std::string("me@example.com"));
+        });
+        sentry_remove_user();
+    }
+}
+
+static sentry_value_t record_phase(sentry_value_t event,
+                                   void *hint,
+                                   void *data) {
+    sentry::Value event_value(event);
+    sentry::Value phases = event_value.get_by_key("extra").get_by_key("phases");
+    if (phases.is_null()) {
+        phases = sentry::Value::new_list();
+        sentry::Value extra = sentry::Value::new_object();
+        extra.set_by_key("phases", phases);
+        event_value.set_by_key("extra", extra);
+    }
+    // the sdk info is only there once the event was enriched
+    std::string phase = (const char *)data;
+    if (!event_value.get_by_key("sdk").is_null()) {
+        phase += "+sdk";
+    }
+    phases.append(sentry::Value::new_string(phase.c_str()));
+    return event;
+}
+
+static sentry_value_t drop_warnings(sentry_value_t event,
+                                    void *hint,
+                                    void *data) {
+    sentry::Value level = sentry::Value(event).get_by_key("level");
+    if (level.type() == SENTRY_VALUE_TYPE_STRING &&
+        level.as_cstr() == std::string("warning")) {
+        sentry_value_decref(event);
+        return sentry_value_new_null();
+    }
+    return event;
+}
+
+TEST_CASE("send event through event processors", "[api]") {
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/1");
+    sentry_options_add_event_processor(options,
+                                       SENTRY_EVENT_PHASE_PRE_SERIALIZATION,
+                                       record_phase, (void *)"serialize");
+    sentry_options_add_event_processor(
+        options, SENTRY_EVENT_PHASE_PRE_ENRICHMENT, drop_warnings, nullptr);
+    sentry_options_add_event_processor(options,
+                                       SENTRY_EVENT_PHASE_PRE_ENRICHMENT,
+                                       record_phase, (void *)"pre");
+    sentry_options_add_event_processor(options,
+                                       SENTRY_EVENT_PHASE_POST_ENRICHMENT,
+                                       record_phase, (void *)"post");
+
+    WITH_MOCK_TRANSPORT(options) {
+        sentry_capture_event(sentry_value_new_message_event(
+            SENTRY_LEVEL_WARNING, nullptr, "dropped"));
+        sentry_capture_event(sentry_value_new_event());
+
+        REQUIRE(mock_transport.events.size() == 1);
+        sentry::Value phases =
+            mock_transport.events[0].navigate("extra.phases");
+        REQUIRE(phases.length() == 3);
+        REQUIRE(phases.get_by_index(0).as_cstr() == std::string("pre"));
+        REQUIRE(phases.get_by_index(1).as_cstr() == std::string("post+sdk"));
+        REQUIRE(phases.get_by_index(2).as_cstr() ==
+                std::string("serialize+sdk"));
+    }
+}
+
 TEST_CASE("send message event", "[api]") {
     WITH_MOCK_TRANSPORT(nullptr) {
         sentry_value_t msg_event = sentry_value_new_message_event(
@@ -166,6 +286,45 @@ TEST_CASE("send event with breadcrumbs", "[api]") {
     }
 }
 
+static sentry_value_t drop_http_breadcrumbs(sentry_value_t breadcrumb,
+                                            void *hint,
+                                            void *data) {
+    sentry::Value type = sentry::Value(breadcrumb).get_by_key("type");
+    if (type.type() == SENTRY_VALUE_TYPE_STRING &&
+        type.as_cstr() == std::string("http")) {
+        sentry_value_decref(breadcrumb);
+        return sentry_value_new_null();
+    }
+    return breadcrumb;
+}
+
+TEST_CASE("send event with before_breadcrumb callback", "[api]") {
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/1");
+    sentry_options_set_before_breadcrumb(options, drop_http_breadcrumbs,
+                                         nullptr);
+
+    WITH_MOCK_TRANSPORT(options) {
+        sentry_add_breadcrumb(sentry_value_new_breadcrumb("default", "crumb1"));
+        sentry_add_breadcrumb(sentry_value_new_breadcrumb("http", "crumb2"));
+        sentry_record_breadcrumb("http", nullptr, SENTRY_LEVEL_INFO, "crumb3");
+        sentry_record_breadcrumb("ui", nullptr, SENTRY_LEVEL_INFO, "crumb4");
+
+        sentry_capture_event(sentry_value_new_event());
+
+        REQUIRE(mock_transport.events.size() == 1);
+        sentry::Value crumbs_out =
+            mock_transport.events[0].navigate("breadcrumbs");
+        REQUIRE(crumbs_out.length() >= 2);
+        REQUIRE(crumbs_out.get_by_index(crumbs_out.length() - 2)
+                    .get_by_key("message")
+                    .as_cstr() == std::string("crumb1"));
+        REQUIRE(crumbs_out.get_by_index(crumbs_out.length() - 1)
+                    .get_by_key("message")
+                    .as_cstr() == std::string("crumb4"));
+    }
+}
+
 TEST_CASE("send event with user", "[api]") {
     WITH_MOCK_TRANSPORT(nullptr) {
         sentry_value_t user = sentry_value_new_object();
@@ -197,6 +356,28 @@ TEST_CASE("send event with tag", "[api]") {
     }
 }
 
+TEST_CASE("send event with many tags", "[api]") {
+    WITH_MOCK_TRANSPORT(nullptr) {
+        const char *keys[] = {"route", "method", "status"};
+        const char *values[] = {"/users", "GET", "200"};
+        sentry_set_tags(keys, values, 3);
+        sentry_set_tags(nullptr, nullptr, 0);
+
+        sentry_value_t event = sentry_value_new_event();
+        sentry_capture_event(event);
+
+        REQUIRE(mock_transport.events.size() == 1);
+        sentry::Value event_out = mock_transport.events[0];
+
+        REQUIRE(event_out.navigate("tags.route") ==
+                sentry::Value::new_string("/users"));
+        REQUIRE(event_out.navigate("tags.method") ==
+                sentry::Value::new_string("GET"));
+        REQUIRE(event_out.navigate("tags.status") ==
+                sentry::Value::new_string("200"));
+    }
+}
+
 TEST_CASE("send event with extra", "[api]") {
     WITH_MOCK_TRANSPORT(nullptr) {
         sentry_set_extra("extra1", sentry_value_new_string("foo"));
@@ -347,3 +528,411 @@ TEST_CASE("send basic stacktrace (unwound)", "[api]") {
     }
 }
 #endif
+
+TEST_CASE("fatal events skip the background pipeline", "[api]") {
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/1");
+    sentry_options_set_background_capture(options, 1);
+
+    WITH_MOCK_TRANSPORT(options) {
+        sentry_capture_event(sentry_value_new_message_event(
+            SENTRY_LEVEL_FATAL, nullptr, "going down"));
+        // sent on the calling thread before capturing returns
+        REQUIRE(mock_transport.events.size() == 1);
+        REQUIRE(mock_transport.events[0].get_by_key("debug_meta").type() ==
+                SENTRY_VALUE_TYPE_OBJECT);
+    }
+}
+
+TEST_CASE("send events with background capture", "[api]") {
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/1");
+    sentry_options_set_background_capture(options, 1);
+
+    WITH_MOCK_TRANSPORT(options) {
+        sentry_set_tag("mytag", "myvalue");
+        sentry_add_breadcrumb(sentry_value_new_breadcrumb(nullptr, "before"));
+        for (int i = 0; i < 10; i++) {
+            sentry_capture_event(sentry_value_new_event());
+        }
+        // changes after capturing must not show up in queued events, even
+        // though their breadcrumbs are only collected in the background
+        sentry_set_tag("mytag", "changed");
+        sentry_add_breadcrumb(sentry_value_new_breadcrumb(nullptr, "after"));
+
+        sentry::Value stats = sentry::Value::consume(sentry_get_stats());
+        sentry::Value enrich = stats.navigate("pipeline.enrich");
+        REQUIRE(enrich.get_by_key("processed").type() ==
+                SENTRY_VALUE_TYPE_DOUBLE);
+        REQUIRE(enrich.get_by_key("avg_run_time_us").type() ==
+                SENTRY_VALUE_TYPE_DOUBLE);
+        REQUIRE(enrich.get_by_key("max_run_time_us").type() ==
+                SENTRY_VALUE_TYPE_DOUBLE);
+    }
+
+    REQUIRE(mock_transport.events.size() == 10);
+    for (size_t i = 0; i < mock_transport.events.size(); i++) {
+        sentry::Value event_out = mock_transport.events[i];
+        REQUIRE(event_out.navigate("tags.mytag") ==
+                sentry::Value::new_string("myvalue"));
+        REQUIRE(event_out.get_by_key("debug_meta").type() ==
+                SENTRY_VALUE_TYPE_OBJECT);
+        sentry::Value breadcrumbs = event_out.get_by_key("breadcrumbs");
+        REQUIRE(breadcrumbs.length() > 0);
+        REQUIRE(breadcrumbs.get_by_index(breadcrumbs.length() - 1)
+                    .get_by_key("message")
+                    .as_cstr() == std::string("before"));
+    }
+}
+
+TEST_CASE("events are sampled before capturing", "[api]") {
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/1");
+    sentry_options_set_sample_rate(options, 0.0);
+    REQUIRE(sentry_options_get_sample_rate(options) == 0.0);
+
+    WITH_MOCK_TRANSPORT(options) {
+        uint64_t sampled_out = sentry_get_sampled_out_count();
+        sentry_uuid_t uuid = sentry_capture_event(sentry_value_new_event());
+        char uuid_str[40];
+        sentry_uuid_as_string(&uuid, uuid_str);
+        REQUIRE(uuid_str ==
+                std::string("00000000-0000-0000-0000-000000000000"));
+        REQUIRE(!sentry_should_capture(SENTRY_LEVEL_ERROR));
+        REQUIRE(sentry_get_sampled_out_count() == sampled_out + 2);
+
+        // fatal events are never sampled
+        sentry_value_t event = sentry_value_new_event();
+        sentry_value_set_by_key(event, "level",
+                                sentry_value_new_string("fatal"));
+        sentry_capture_event(event);
+        REQUIRE(sentry_should_capture(SENTRY_LEVEL_FATAL));
+        // the decision only applies to an event of the same level
+        sentry_capture_event(sentry_value_new_event());
+        REQUIRE(mock_transport.events.size() == 1);
+        sentry_capture_event(sentry_value_new_event());
+        REQUIRE(mock_transport.events.size() == 1);
+    }
+
+    options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/1");
+    sentry_options_set_sample_rate(options, 0.5);
+
+    WITH_MOCK_TRANSPORT(options) {
+        for (int i = 0; i < 200; i++) {
+            sentry_capture_event(sentry_value_new_event());
+        }
+        REQUIRE(mock_transport.events.size() > 50);
+        REQUIRE(mock_transport.events.size() < 150);
+
+        // events that were decided on up front are not sampled again
+        size_t decided = 0;
+        mock_transport.events.clear();
+        for (int i = 0; i < 200; i++) {
+            if (sentry_should_capture(SENTRY_LEVEL_ERROR)) {
+                decided++;
+                sentry_capture_event(sentry_value_new_event());
+            }
+        }
+        REQUIRE(mock_transport.events.size() == decided);
+    }
+}
+
+TEST_CASE("duplicate events are suppressed", "[api]") {
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/1");
+    sentry_options_set_dedup_window(options, 60000);
+
+    WITH_MOCK_TRANSPORT(options) {
+        sentry_set_tag("round", "first");
+        for (int i = 0; i < 10; i++) {
+            sentry_capture_event(sentry_value_new_message_event(
+                SENTRY_LEVEL_ERROR, nullptr, "same old"));
+        }
+        sentry_set_tag("round", "second");
+        sentry_capture_event(sentry_value_new_message_event(
+            SENTRY_LEVEL_ERROR, nullptr, "something else"));
+        REQUIRE(mock_transport.events.size() == 2);
+    }
+
+    // the suppressed events are reported on shutdown
+    REQUIRE(mock_transport.events.size() == 3);
+    sentry::Value aggregate = mock_transport.events[2];
+    REQUIRE(aggregate.get_by_key("message").as_cstr() ==
+            std::string("same old"));
+    REQUIRE(aggregate.navigate("extra.duplicate_count").as_double() == 9);
+    REQUIRE(aggregate.get_by_key("event_id").type() ==
+            SENTRY_VALUE_TYPE_STRING);
+    // the aggregate keeps the scope of the first event
+    REQUIRE(aggregate.navigate("tags.round").as_cstr() ==
+            std::string("first"));
+}
+
+TEST_CASE("duplicate aggregates are flushed without new events", "[api]") {
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/1");
+    sentry_options_set_dedup_window(options, 50);
+
+    WITH_MOCK_TRANSPORT(options) {
+        sentry::Value before = sentry::Value::consume(sentry_get_stats());
+        double expected =
+            before.navigate("counters.events_captured").as_double() + 2;
+        for (int i = 0; i < 3; i++) {
+            sentry_capture_event(sentry_value_new_message_event(
+                SENTRY_LEVEL_ERROR, nullptr, "same old"));
+        }
+        double captured = 0;
+        for (int i = 0; i < 100 && captured < expected; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            sentry::Value stats = sentry::Value::consume(sentry_get_stats());
+            captured = stats.navigate("counters.events_captured").as_double();
+        }
+        REQUIRE(captured == expected);
+    }
+
+    REQUIRE(mock_transport.events.size() == 2);
+    REQUIRE(mock_transport.events[1]
+                .navigate("extra.duplicate_count")
+                .as_double() == 2);
+}
+
+static void count_stats_reports(sentry_value_t stats, void *data) {
+    if (sentry_value_get_type(sentry_value_get_by_key(stats, "counters")) ==
+        SENTRY_VALUE_TYPE_OBJECT) {
+        (*(std::atomic<int> *)data)++;
+    }
+}
+
+TEST_CASE("sdk statistics", "[api]") {
+    std::atomic<int> reports(0);
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/1");
+    sentry_options_set_stats_callback(options, count_stats_reports, 10,
+                                      &reports);
+
+    WITH_MOCK_TRANSPORT(options) {
+        sentry::Value before = sentry::Value::consume(sentry_get_stats());
+        for (int i = 0; i < 3; i++) {
+            sentry_capture_event(sentry_value_new_event());
+        }
+        sentry::Value after = sentry::Value::consume(sentry_get_stats());
+
+        REQUIRE(after.navigate("counters.events_captured").as_double() ==
+                before.navigate("counters.events_captured").as_double() + 3);
+        REQUIRE(after.navigate("timers.apply_scope.count").as_double() >=
+                before.navigate("timers.apply_scope.count").as_double() + 3);
+        REQUIRE(after.navigate("timers.serialize.count").as_double() >=
+                before.navigate("timers.serialize.count").as_double() + 3);
+        REQUIRE(after.navigate("timers.capture.buckets").length() ==
+                after.navigate("timers.serialize.buckets").length());
+        REQUIRE(after.navigate("timers.capture.p99_us").as_double() >=
+                after.navigate("timers.capture.p50_us").as_double());
+        REQUIRE(after.get_by_key("transport").type() ==
+                SENTRY_VALUE_TYPE_OBJECT);
+
+        for (int i = 0; i < 200 && reports < 2; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE(reports >= 2);
+    }
+}
+
+TEST_CASE("scope snapshots are immutable", "[api]") {
+    WITH_MOCK_TRANSPORT(nullptr) {
+        sentry_set_tag("snapshot", "before");
+        std::shared_ptr<const sentry::Scope> before = sentry::Scope::snapshot();
+        sentry_set_tag("snapshot", "after");
+
+        REQUIRE(before->tags.is_frozen());
+        REQUIRE(before->tags.get_by_key("snapshot").as_cstr() ==
+                std::string("before"));
+        sentry::Value current = sentry::Scope::snapshot()->tags;
+        REQUIRE(current.get_by_key("snapshot").as_cstr() ==
+                std::string("after"));
+
+        // readers apply snapshots while writers keep replacing them
+        std::atomic<int> oversized(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([t, &oversized]() {
+                for (int i = 0; i < 500; i++) {
+                    if (t % 2) {
+                        sentry_set_tag("thread", "value");
+                        sentry_add_breadcrumb(
+                            sentry_value_new_breadcrumb(nullptr, "crumb"));
+                        continue;
+                    }
+                    sentry::Value event = sentry::Value::new_event();
+                    sentry::Scope::snapshot()->apply_to_event(
+                        event, sentry::SENTRY_SCOPE_BREADCRUMBS);
+                    if (event.get_by_key("breadcrumbs").length() >
+                        SENTRY_BREADCRUMBS_MAX) {
+                        oversized++;
+                    }
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        REQUIRE(oversized == 0);
+        REQUIRE(sentry::collect_breadcrumbs(sentry::Value(),
+                                            SENTRY_BREADCRUMBS_MAX)
+                    .length() == SENTRY_BREADCRUMBS_MAX);
+    }
+}
+
+static void capture_in_scope(void *data) {
+    sentry_set_tag("layer", "inner");
+    sentry_capture_event(sentry_value_new_event());
+}
+
+TEST_CASE("pushed scopes are layered over the global scope", "[api]") {
+    WITH_MOCK_TRANSPORT(nullptr) {
+        sentry_set_tag("global", "yes");
+        sentry_set_tag("layer", "global");
+        sentry_set_level(SENTRY_LEVEL_WARNING);
+
+        sentry_push_scope();
+        sentry_set_tag("layer", "outer");
+        sentry_set_level(SENTRY_LEVEL_INFO);
+        sentry_add_breadcrumb(sentry_value_new_breadcrumb(nullptr, "pushed"));
+
+        // other threads only see the global scope
+        std::thread([]() {
+            sentry_capture_event(sentry_value_new_event());
+        }).join();
+        sentry_with_scope(capture_in_scope, nullptr);
+        sentry_capture_event(sentry_value_new_event());
+        sentry_pop_scope();
+        sentry_capture_event(sentry_value_new_event());
+
+        REQUIRE(mock_transport.events.size() == 4);
+        const char *expected_layers[] = {"global", "inner", "outer", "global"};
+        const char *expected_levels[] = {"warning", "info", "info", "warning"};
+        for (size_t i = 0; i < 4; i++) {
+            sentry::Value event = mock_transport.events[i];
+            REQUIRE(event.navigate("tags.global").as_cstr() ==
+                    std::string("yes"));
+            REQUIRE(event.navigate("tags.layer").as_cstr() ==
+                    std::string(expected_layers[i]));
+            REQUIRE(event.get_by_key("level").as_cstr() ==
+                    std::string(expected_levels[i]));
+        }
+        sentry::Value crumbs =
+            mock_transport.events[2].get_by_key("breadcrumbs");
+        REQUIRE(crumbs.get_by_index(crumbs.length() - 1)
+                    .get_by_key("message")
+                    .as_cstr() == std::string("pushed"));
+        crumbs = mock_transport.events[3].get_by_key("breadcrumbs");
+        REQUIRE(crumbs.get_by_index(crumbs.length() - 1)
+                    .get_by_key("message")
+                    .as_cstr() != std::string("pushed"));
+
+        sentry_remove_tag("layer");
+        sentry_set_level(SENTRY_LEVEL_ERROR);
+    }
+}
+
+#if !defined(_WIN32) && !defined(__ANDROID__)
+TEST_CASE("events are handed over through a shared ring", "[api]") {
+    const char *ring_name = "/sentry-test-api-ring";
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/1");
+    sentry_options_set_shared_ring(options, ring_name, 64 * 1024);
+    sentry_init(options);
+    for (int i = 0; i < 3; i++) {
+        sentry_value_t event = sentry_value_new_event();
+        sentry_value_set_by_key(event, "message",
+                                sentry_value_new_string("from the ring"));
+        sentry_capture_event(event);
+    }
+    sentry_shutdown();
+
+    // the uploader forwards them with its own transport
+    WITH_MOCK_TRANSPORT(nullptr) {
+        REQUIRE(sentry_drain_shared_ring(ring_name) == 3);
+        REQUIRE(sentry_drain_shared_ring(ring_name) == 0);
+        REQUIRE(mock_transport.events.size() == 3);
+        REQUIRE(mock_transport.events[0].get_by_key("message").as_cstr() ==
+                std::string("from the ring"));
+    }
+    shm_unlink(ring_name);
+}
+#endif
+
+TEST_CASE("breadcrumbs of all threads are merged in order", "[api]") {
+    WITH_MOCK_TRANSPORT(nullptr) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([t]() {
+                for (int i = 0; i < 50; i++) {
+                    std::string message =
+                        "thread-" + std::to_string(t) + "-" + std::to_string(i);
+                    sentry_add_breadcrumb(
+                        sentry_value_new_breadcrumb(nullptr, message.c_str()));
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        sentry_add_breadcrumb(sentry_value_new_breadcrumb(nullptr, "last"));
+        sentry_capture_event(sentry_value_new_event());
+
+        REQUIRE(mock_transport.events.size() == 1);
+        sentry::Value crumbs =
+            mock_transport.events[0].get_by_key("breadcrumbs");
+        REQUIRE(crumbs.length() == SENTRY_BREADCRUMBS_MAX);
+        REQUIRE(crumbs.get_by_index(SENTRY_BREADCRUMBS_MAX - 1)
+                    .get_by_key("message")
+                    .as_cstr() == std::string("last"));
+
+        // the crumbs of every thread are in order, and the most recent one of
+        // the threads is the last crumb of one of them.
+        int last_seen[4] = {-1, -1, -1, -1};
+        bool ordered = true;
+        for (size_t i = 0; i < SENTRY_BREADCRUMBS_MAX - 1; i++) {
+            int t, n;
+            const char *message =
+                crumbs.get_by_index(i).get_by_key("message").as_cstr();
+            REQUIRE(sscanf(message, "thread-%d-%d", &t, &n) == 2);
+            ordered = ordered && n > last_seen[t];
+            last_seen[t] = n;
+        }
+        REQUIRE(ordered);
+        REQUIRE(std::max(std::max(last_seen[0], last_seen[1]),
+                         std::max(last_seen[2], last_seen[3])) == 49);
+    }
+}
+
+#ifdef SENTRY_WITH_INPROC_BACKEND
+static void ignore_signal(int, siginfo_t *, void *) {
+}
+
+TEST_CASE("crash events carry breadcrumbs", "[api]") {
+    // the backend hands the signal on to this handler after reporting it
+    struct sigaction ignore, previous;
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_sigaction = ignore_signal;
+    ignore.sa_flags = SA_SIGINFO;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGTRAP, &ignore, &previous);
+
+    WITH_MOCK_TRANSPORT(nullptr) {
+        sentry_record_breadcrumb(nullptr, nullptr, SENTRY_LEVEL_INFO,
+                                 "before the crash");
+        raise(SIGTRAP);
+
+        REQUIRE(mock_transport.events.size() == 1);
+        sentry::Value event = mock_transport.events[0];
+        REQUIRE(event.get_by_key("level").as_cstr() == std::string("fatal"));
+        sentry::Value crumbs = event.get_by_key("breadcrumbs");
+        REQUIRE(crumbs.length() > 0);
+        REQUIRE(crumbs.get_by_index(crumbs.length() - 1)
+                    .get_by_key("message")
+                    .as_cstr() == std::string("before the crash"));
+    }
+    sigaction(SIGTRAP, &previous, nullptr);
+}
+#endif
@@ -0,0 +1,94 @@
+#ifndef _WIN32
+#include <outbox.hpp>
+#include <sentry.h>
+#include <string>
+#include <transports/envelopes.hpp>
+#include <vendor/catch.hpp>
+#include "relayreceiver.hpp"
+
+using namespace sentry::transports;
+
+static const char *RELAY_SOCKET = "sentry-test-relay.sock";
+
+static sentry_options_t *relay_options() {
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, "https://publickey@127.0.0.1/42");
+    sentry_options_set_database_path(options, "sentry-test-database");
+    sentry_options_set_relay_socket(options, RELAY_SOCKET);
+    return options;
+}
+
+static std::string frame_event_id(const RelayFrame &frame) {
+    EnvelopeReader reader(frame.envelope.data(), frame.envelope.size());
+    sentry::Value headers;
+    if (!reader.read_headers(&headers)) {
+        return std::string();
+    }
+    return headers.get_by_key("event_id").as_cstr();
+}
+
+TEST_CASE("relay transport writes framed envelopes", "[transport]") {
+    sentry::Path database("sentry-test-database");
+    database.remove_all();
+
+    RelayReceiver receiver;
+    REQUIRE(receiver.start(RELAY_SOCKET));
+    sentry_init(relay_options());
+
+    std::vector<std::string> event_ids;
+    for (int i = 0; i < 5; i++) {
+        sentry_uuid_t uuid = sentry_capture_event(sentry_value_new_event());
+        char uuid_str[40];
+        sentry_uuid_as_string(&uuid, uuid_str);
+        event_ids.push_back(uuid_str);
+    }
+
+    REQUIRE(receiver.wait_for_frames(5, std::chrono::seconds(5)));
+    sentry_shutdown();
+    receiver.stop();
+
+    std::vector<RelayFrame> frames = receiver.frames();
+    REQUIRE(frames.size() == 5);
+    for (size_t i = 0; i < frames.size(); i++) {
+        REQUIRE(frame_event_id(frames[i]) == event_ids[i]);
+    }
+    database.remove_all();
+}
+
+TEST_CASE("relay transport spills while the relay is down", "[transport]") {
+    sentry::Path database("sentry-test-database");
+    database.remove_all();
+
+    sentry_init(relay_options());
+    for (int i = 0; i < 3; i++) {
+        sentry_capture_event(sentry_value_new_event());
+    }
+
+    // the spilled envelopes are delivered once the relay comes up
+    RelayReceiver receiver;
+    REQUIRE(receiver.start(RELAY_SOCKET));
+    REQUIRE(receiver.wait_for_frames(3, std::chrono::seconds(5)));
+    sentry_capture_event(sentry_value_new_event());
+    REQUIRE(receiver.wait_for_frames(4, std::chrono::seconds(5)));
+    sentry_shutdown();
+
+    // the relay goes away, the envelope survives the restart
+    receiver.stop();
+    sentry_init(relay_options());
+    sentry_capture_event(sentry_value_new_event());
+    sentry_shutdown();
+
+    RelayReceiver restarted;
+    REQUIRE(restarted.start(RELAY_SOCKET));
+    sentry_init(relay_options());
+    REQUIRE(restarted.wait_for_frames(1, std::chrono::seconds(5)));
+    sentry_shutdown();
+    restarted.stop();
+
+    sentry::Outbox spill;
+    REQUIRE(spill.open(database.join("sentry-relay-spill")));
+    REQUIRE(spill.pending() == 0);
+    spill.close();
+    database.remove_all();
+}
+#endif
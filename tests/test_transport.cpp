@@ -0,0 +1,229 @@
+#ifdef SENTRY_WITH_LIBCURL_TRANSPORT
+#include <options.hpp>
+#include <outbox.hpp>
+#include <sentry.h>
+#include <string>
+#include <transports/libcurl_transport.hpp>
+#include <vendor/catch.hpp>
+#include "testserver.hpp"
+
+using namespace sentry::transports;
+
+static sentry_options_t *transport_options(const TestServer &server,
+                                           const RetryPolicy &policy) {
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_dsn(options, server.dsn().c_str());
+    sentry_options_set_database_path(options, "sentry-test-database");
+    delete options->transport;
+    options->transport = new LibcurlTransport(policy);
+    return options;
+}
+
+TEST_CASE("libcurl transport retries failed requests", "[transport]") {
+    sentry::Path database("sentry-test-database");
+    database.remove_all();
+
+    TestServer server;
+    REQUIRE(server.start());
+    server.push_response(TestResponse(500));
+    server.push_response(TestResponse(503));
+
+    RetryPolicy policy;
+    policy.initial_backoff = std::chrono::milliseconds(20);
+    sentry_init(transport_options(server, policy));
+    sentry_capture_event(sentry_value_new_event());
+    sentry_capture_event(sentry_value_new_event());
+
+    REQUIRE(server.wait_for_requests(4, std::chrono::seconds(5)));
+    sentry_shutdown();
+
+    std::vector<TestRequest> requests = server.requests();
+    REQUIRE(requests.size() == 4);
+    for (const TestRequest &request : requests) {
+        REQUIRE(request.path == "/api/42/store/");
+        REQUIRE(request.body.find("\"event_id\"") != std::string::npos);
+    }
+    // the second event is not held up by the first one backing off
+    REQUIRE(requests[0].body != requests[1].body);
+
+    sentry::Outbox outbox;
+    REQUIRE(outbox.open(database.join("sentry-pending")));
+    REQUIRE(outbox.pending() == 0);
+    outbox.close();
+    database.remove_all();
+}
+
+TEST_CASE("libcurl transport gives up after max attempts", "[transport]") {
+    sentry::Path database("sentry-test-database");
+    database.remove_all();
+
+    TestServer server;
+    REQUIRE(server.start());
+    for (int i = 0; i < 3; i++) {
+        server.push_response(TestResponse(500));
+    }
+
+    RetryPolicy policy;
+    policy.initial_backoff = std::chrono::milliseconds(10);
+    policy.max_attempts = 3;
+    sentry_init(transport_options(server, policy));
+    sentry_capture_event(sentry_value_new_event());
+
+    REQUIRE(server.wait_for_requests(3, std::chrono::seconds(5)));
+    REQUIRE(!server.wait_for_requests(4, std::chrono::milliseconds(200)));
+    sentry_shutdown();
+
+    sentry::Outbox outbox;
+    REQUIRE(outbox.open(database.join("sentry-pending")));
+    REQUIRE(outbox.pending() == 0);
+    outbox.close();
+    database.remove_all();
+}
+
+TEST_CASE("libcurl transport honors retry-after", "[transport]") {
+    sentry::Path database("sentry-test-database");
+    database.remove_all();
+
+    TestServer server;
+    REQUIRE(server.start());
+    TestResponse rate_limited(429);
+    rate_limited.retry_after = 1;
+    server.push_response(rate_limited);
+
+    sentry_init(transport_options(server, RetryPolicy()));
+    sentry_capture_event(sentry_value_new_event());
+
+    REQUIRE(server.wait_for_requests(2, std::chrono::seconds(5)));
+    sentry_shutdown();
+
+    std::vector<TestRequest> requests = server.requests();
+    REQUIRE(requests[0].status == 429);
+    REQUIRE(requests[1].status == 200);
+    REQUIRE(requests[1].received_at - requests[0].received_at >=
+            std::chrono::milliseconds(900));
+    database.remove_all();
+}
+
+TEST_CASE("libcurl transport survives connection resets", "[transport]") {
+    sentry::Path database("sentry-test-database");
+    database.remove_all();
+
+    TestServer server;
+    REQUIRE(server.start());
+    TestResponse reset;
+    reset.reset = true;
+    server.push_response(reset);
+    TestResponse slow;
+    slow.latency = std::chrono::milliseconds(50);
+    slow.read_delay = std::chrono::milliseconds(1);
+    server.push_response(slow);
+
+    RetryPolicy policy;
+    policy.initial_backoff = std::chrono::milliseconds(10);
+    sentry_init(transport_options(server, policy));
+    sentry_capture_event(sentry_value_new_event());
+
+    REQUIRE(server.wait_for_requests(2, std::chrono::seconds(5)));
+    sentry_shutdown();
+
+    std::vector<TestRequest> requests = server.requests();
+    REQUIRE(requests[0].status == 0);
+    REQUIRE(requests[1].status == 200);
+    REQUIRE(requests[1].body == requests[0].body);
+    REQUIRE(server.bytes_received() ==
+            requests[0].wire_size + requests[1].wire_size);
+    database.remove_all();
+}
+
+TEST_CASE("libcurl transport batches envelopes", "[transport]") {
+    sentry::Path database("sentry-test-database");
+    database.remove_all();
+
+    TestServer server;
+    REQUIRE(server.start());
+
+    sentry_options_t *options = transport_options(server, RetryPolicy());
+    sentry_options_set_batching(options, 300, 0);
+    sentry_init(options);
+    for (int i = 0; i < 5; i++) {
+        sentry_capture_event(sentry_value_new_event());
+    }
+
+    REQUIRE(!server.wait_for_requests(1, std::chrono::milliseconds(100)));
+    REQUIRE(server.wait_for_requests(5, std::chrono::seconds(5)));
+    sentry_shutdown();
+
+    std::vector<TestRequest> requests = server.requests();
+    REQUIRE(requests.size() == 5);
+    for (const TestRequest &request : requests) {
+        REQUIRE(request.status == 200);
+    }
+    database.remove_all();
+}
+
+TEST_CASE("libcurl transport flushes batches early", "[transport]") {
+    sentry::Path database("sentry-test-database");
+    database.remove_all();
+
+    TestServer server;
+    REQUIRE(server.start());
+
+    sentry_options_t *options = transport_options(server, RetryPolicy());
+    sentry_options_set_batching(options, 60000, 0);
+    sentry_init(options);
+
+    // fatal events do not linger
+    sentry_capture_event(sentry_value_new_event());
+    sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_FATAL, nullptr, "fatal"));
+    REQUIRE(server.wait_for_requests(2, std::chrono::seconds(5)));
+
+    // neither does anything left on shutdown
+    sentry_capture_event(sentry_value_new_event());
+    sentry_shutdown();
+    // the server records requests only after answering them
+    REQUIRE(server.wait_for_requests(3, std::chrono::seconds(1)));
+    REQUIRE(server.request_count() == 3);
+    database.remove_all();
+}
+
+TEST_CASE("libcurl transport sends fatal events past the backlog",
+          "[transport]") {
+    sentry::Path database("sentry-test-database");
+    database.remove_all();
+
+    TestServer server;
+    REQUIRE(server.start());
+    TestResponse slow;
+    slow.latency = std::chrono::milliseconds(20);
+    server.set_default_response(slow);
+
+    sentry_init(transport_options(server, RetryPolicy()));
+    for (int i = 0; i < 20; i++) {
+        sentry_capture_event(sentry_value_new_event());
+    }
+    sentry_uuid_t fatal = sentry_capture_event(
+        sentry_value_new_message_event(SENTRY_LEVEL_FATAL, nullptr, "fatal"));
+    char fatal_id[40];
+    sentry_uuid_as_string(&fatal, fatal_id);
+
+    // the fatal event was sent before capturing it returned
+    REQUIRE(server.wait_for_requests(21, std::chrono::seconds(10)));
+    sentry_shutdown();
+
+    std::vector<TestRequest> requests = server.requests();
+    size_t fatal_index = requests.size();
+    for (size_t i = 0; i < requests.size(); i++) {
+        if (requests[i].body.find(fatal_id) != std::string::npos) {
+            fatal_index = i;
+        }
+    }
+    REQUIRE(fatal_index < 5);
+
+    sentry::Outbox outbox;
+    REQUIRE(outbox.open(database.join("sentry-pending")));
+    REQUIRE(outbox.pending() == 0);
+    outbox.close();
+    database.remove_all();
+}
+#endif
@@ -0,0 +1,279 @@
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include "testserver.hpp"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static const char *status_text(int status) {
+    switch (status) {
+        case 200:
+            return "OK";
+        case 429:
+            return "Too Many Requests";
+        case 500:
+            return "Internal Server Error";
+        case 503:
+            return "Service Unavailable";
+        default:
+            return "Unknown";
+    }
+}
+
+TestServer::TestServer()
+    : m_listen_fd(-1), m_port(0), m_running(false), m_bytes_received(0) {
+}
+
+TestServer::~TestServer() {
+    stop();
+}
+
+bool TestServer::start() {
+    m_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listen_fd < 0) {
+        return false;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t addr_len = sizeof(addr);
+    if (bind(m_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(m_listen_fd, 16) != 0 ||
+        getsockname(m_listen_fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        close(m_listen_fd);
+        m_listen_fd = -1;
+        return false;
+    }
+
+    m_port = ntohs(addr.sin_port);
+    m_running = true;
+    m_thread = std::thread([this]() { serve(); });
+    return true;
+}
+
+void TestServer::stop() {
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+    m_thread.join();
+    for (std::thread &connection : m_connections) {
+        connection.join();
+    }
+    m_connections.clear();
+    close(m_listen_fd);
+    m_listen_fd = -1;
+}
+
+std::string TestServer::dsn() const {
+    std::stringstream ss;
+    ss << "http://publickey@127.0.0.1:" << m_port << "/42";
+    return ss.str();
+}
+
+void TestServer::push_response(TestResponse response) {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    m_script.push_back(response);
+}
+
+void TestServer::set_default_response(TestResponse response) {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    m_default_response = response;
+}
+
+std::vector<TestRequest> TestServer::requests() const {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    return m_requests;
+}
+
+size_t TestServer::request_count() const {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    return m_requests.size();
+}
+
+size_t TestServer::bytes_received() const {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    return m_bytes_received;
+}
+
+bool TestServer::wait_for_requests(size_t count,
+                                   std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_lock);
+    return m_request_received.wait_for(
+        lock, timeout, [this, count]() { return m_requests.size() >= count; });
+}
+
+TestResponse TestServer::next_response() {
+    std::lock_guard<std::mutex> _lock(m_lock);
+    if (m_script.empty()) {
+        return m_default_response;
+    }
+    TestResponse response = m_script.front();
+    m_script.pop_front();
+    return response;
+}
+
+// waits for data on `fd` while the server is running.
+static bool wait_readable(int fd, const std::atomic<bool> &running) {
+    while (running) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        int rv = poll(&pfd, 1, 50);
+        if (rv > 0) {
+            return true;
+        } else if (rv < 0) {
+            return false;
+        }
+    }
+    return false;
+}
+
+void TestServer::serve() {
+    while (wait_readable(m_listen_fd, m_running)) {
+        int fd = accept(m_listen_fd, nullptr, nullptr);
+        if (fd >= 0) {
+            m_connections.push_back(std::thread([this, fd]() {
+                handle_connection(fd);
+                close(fd);
+            }));
+        }
+    }
+}
+
+bool TestServer::read_request(int fd,
+                              std::string &buf,
+                              TestRequest *request_out,
+                              TestResponse *response_out) {
+    char chunk[4096];
+    size_t chunk_size = sizeof(chunk);
+    std::chrono::milliseconds read_delay(0);
+    auto receive = [&]() {
+        if (read_delay.count()) {
+            std::this_thread::sleep_for(read_delay);
+        }
+        if (!wait_readable(fd, m_running)) {
+            return false;
+        }
+        ssize_t len = recv(fd, chunk, chunk_size, 0);
+        if (len <= 0) {
+            return false;
+        }
+        buf.append(chunk, (size_t)len);
+        return true;
+    };
+
+    size_t header_end;
+    while ((header_end = buf.find("\r\n\r\n")) == std::string::npos) {
+        if (!receive()) {
+            return false;
+        }
+    }
+
+    TestRequest &request = *request_out;
+    std::istringstream iss(buf.substr(0, header_end));
+    std::string line;
+    std::getline(iss, line);
+    std::istringstream request_line(line);
+    request_line >> request.method >> request.path;
+
+    size_t content_length = 0;
+    request.headers.clear();
+    while (std::getline(iss, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.resize(line.size() - 1);
+        }
+        std::string lower = line;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (lower.compare(0, 15, "content-length:") == 0) {
+            content_length = strtoul(line.c_str() + 15, nullptr, 10);
+        }
+        request.headers.push_back(line);
+    }
+
+    // the response is only picked once a request arrived so that the script
+    // does not advance for connections the client gives up on.  Slow reads
+    // take a few bytes of the body at a time off the socket, which makes the
+    // client block on a full send buffer.
+    TestResponse &response = *response_out;
+    response = next_response();
+    if (response.read_delay.count()) {
+        read_delay = response.read_delay;
+        chunk_size = 256;
+    }
+
+    size_t request_size = header_end + 4 + content_length;
+    while (buf.size() < request_size) {
+        if (!receive()) {
+            return false;
+        }
+    }
+
+    request.body = buf.substr(header_end + 4, content_length);
+    request.wire_size = request_size;
+    request.received_at = std::chrono::steady_clock::now();
+    // anything after this request belongs to the next one on the connection
+    buf.erase(0, request_size);
+    return true;
+}
+
+void TestServer::handle_connection(int fd) {
+    std::string buf;
+    while (m_running) {
+        TestRequest request;
+        TestResponse response;
+        if (!read_request(fd, buf, &request, &response)) {
+            return;
+        }
+
+        if (response.latency.count()) {
+            std::this_thread::sleep_for(response.latency);
+        }
+
+        request.status = response.reset ? 0 : response.status;
+        if (response.reset) {
+            // closing with a zero linger timeout sends a RST
+            struct linger lin;
+            lin.l_onoff = 1;
+            lin.l_linger = 0;
+            setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+        } else {
+            std::stringstream ss;
+            ss << "HTTP/1.1 " << response.status << " "
+               << status_text(response.status) << "\r\n";
+            if (response.retry_after >= 0) {
+                ss << "Retry-After: " << response.retry_after << "\r\n";
+            }
+            ss << "Content-Length: 0\r\n\r\n";
+            std::string out = ss.str();
+            send(fd, out.c_str(), out.size(), MSG_NOSIGNAL);
+        }
+
+        // the request only counts once it was answered so that tests can
+        // rely on the transport having seen the response
+        {
+            std::lock_guard<std::mutex> _lock(m_lock);
+            m_requests.push_back(request);
+            m_bytes_received += request.wire_size;
+        }
+        m_request_received.notify_all();
+
+        if (response.reset) {
+            return;
+        }
+    }
+}
+#endif
@@ -0,0 +1,95 @@
+#ifndef SENTRY_TESTS_TESTSERVER_HPP_INCLUDED
+#define SENTRY_TESTS_TESTSERVER_HPP_INCLUDED
+#ifndef _WIN32
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct TestRequest {
+    std::string method;
+    std::string path;
+    std::vector<std::string> headers;
+    std::string body;
+    // the status the request was answered with, 0 if it was reset
+    int status;
+    // number of bytes the request took on the wire, including headers
+    size_t wire_size;
+    std::chrono::steady_clock::time_point received_at;
+};
+
+struct TestResponse {
+    TestResponse(int status = 200)
+        : status(status),
+          retry_after(-1),
+          latency(0),
+          read_delay(0),
+          reset(false) {
+    }
+
+    int status;
+    // sends a `Retry-After` header if not negative
+    int retry_after;
+    // waits this long before answering
+    std::chrono::milliseconds latency;
+    // reads the request in small chunks with this delay in between
+    std::chrono::milliseconds read_delay;
+    // resets the connection instead of answering
+    bool reset;
+};
+
+// a minimal HTTP/1.1 server on the loopback interface that stands in for
+// sentry.  Responses are handed out from a script, once the script runs out
+// the default response is used.  Connections are kept alive and every
+// connection is served by its own thread.
+class TestServer {
+   public:
+    TestServer();
+    ~TestServer();
+
+    bool start();
+    void stop();
+    int port() const {
+        return m_port;
+    }
+
+    // returns a DSN that points at this server.
+    std::string dsn() const;
+
+    void push_response(TestResponse response);
+    void set_default_response(TestResponse response);
+
+    std::vector<TestRequest> requests() const;
+    size_t request_count() const;
+    size_t bytes_received() const;
+    bool wait_for_requests(size_t count, std::chrono::milliseconds timeout);
+
+   private:
+    void serve();
+    void handle_connection(int fd);
+    bool read_request(int fd,
+                      std::string &buf,
+                      TestRequest *request_out,
+                      TestResponse *response_out);
+    TestResponse next_response();
+
+    int m_listen_fd;
+    int m_port;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+    std::vector<std::thread> m_connections;
+    mutable std::mutex m_lock;
+    std::condition_variable m_request_received;
+    std::deque<TestResponse> m_script;
+    TestResponse m_default_response;
+    std::vector<TestRequest> m_requests;
+    size_t m_bytes_received;
+};
+
+#endif
+#endif
@@ -0,0 +1,201 @@
+#ifndef _WIN32
+#include <blackbox.hpp>
+#include <path.hpp>
+#include <scope.hpp>
+#include <sentry.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vendor/catch.hpp>
+#include <vendor/mpack.h>
+
+using namespace sentry;
+
+static Scope scope_with_tag(const std::string &value) {
+    Scope scope;
+    scope.tags.set_by_key("seq", Value::new_string(value.c_str()));
+    return scope;
+}
+
+static std::string encode_scope(const Scope &scope) {
+    Value event = Value::new_object();
+    scope.apply_to_event(event, SENTRY_SCOPE_NONE);
+    size_t size;
+    char *buf = event.to_msgpack_string(&size);
+    std::string rv(buf, size);
+    free(buf);
+    return rv;
+}
+
+static std::string read_seq_tag(const std::string &encoded) {
+    mpack_tree_t tree;
+    mpack_tree_init_data(&tree, encoded.data(), encoded.size());
+    mpack_tree_parse(&tree);
+    mpack_node_t tag = mpack_node_map_cstr(
+        mpack_node_map_cstr(mpack_tree_root(&tree), "tags"), "seq");
+    std::string rv(mpack_node_str(tag), mpack_node_strlen(tag));
+    if (mpack_tree_destroy(&tree) != mpack_ok) {
+        return "";
+    }
+    return rv;
+}
+
+static size_t count_values(const std::string &encoded) {
+    mpack_reader_t reader;
+    mpack_reader_init_data(&reader, encoded.data(), encoded.size());
+    size_t count = 0;
+    while (mpack_reader_remaining(&reader, nullptr) > 0) {
+        mpack_discard(&reader);
+        count++;
+    }
+    return mpack_reader_destroy(&reader) == mpack_ok ? count : 0;
+}
+
+static Value breadcrumb(size_t i) {
+    char message[32];
+    snprintf(message, sizeof(message), "crumb-%04d", (int)i);
+    Value crumb = Value::new_object();
+    crumb.set_by_key("message", Value::new_string(message));
+    return crumb;
+}
+
+TEST_CASE("black box keeps the latest scope and breadcrumbs", "[blackbox]") {
+    // applying the scope reads the release and environment from the options
+    sentry_init(sentry_options_new());
+    Path path("sentry-test-blackbox");
+
+    {
+        BlackBox blackbox;
+        REQUIRE(blackbox.open(path, 1024, 4096));
+
+        std::string scope;
+        std::string breadcrumbs;
+        REQUIRE(blackbox.read(&scope, &breadcrumbs));
+        REQUIRE(scope.empty());
+        REQUIRE(breadcrumbs.empty());
+
+        REQUIRE(blackbox.write_scope(scope_with_tag("first")));
+        REQUIRE(blackbox.write_scope(scope_with_tag("second")));
+        // a scope that does not fit keeps the previous one
+        REQUIRE(!blackbox.write_scope(scope_with_tag(std::string(2048, 'x'))));
+
+        for (size_t i = 0; i < 250; i++) {
+            REQUIRE(blackbox.add_breadcrumb(breadcrumb(i)));
+        }
+
+        // the file is read while it is still mapped, like after a crash
+        REQUIRE(BlackBox::read_file(path, &scope, &breadcrumbs));
+        REQUIRE(scope == encode_scope(scope_with_tag("second")));
+        REQUIRE(read_seq_tag(scope) == "second");
+
+        // the two segments hold at most 100 crumbs each, the oldest of which
+        // were dropped on rotation.
+        REQUIRE(count_values(breadcrumbs) == 150);
+        REQUIRE(breadcrumbs.find("crumb-0099") == std::string::npos);
+        REQUIRE(breadcrumbs.find("crumb-0100") <
+                breadcrumbs.find("crumb-0249"));
+    }
+
+    REQUIRE(path.remove());
+    sentry_shutdown();
+}
+
+static std::string read_file(const Path &path) {
+    std::string rv;
+    FILE *f = path.open("rb");
+    if (!f) {
+        return rv;
+    }
+    char buf[4096];
+    while (size_t read = fread(buf, 1, sizeof(buf), f)) {
+        rv.append(buf, read);
+    }
+    fclose(f);
+    return rv;
+}
+
+TEST_CASE("black box writes the attachment files", "[blackbox]") {
+    sentry_init(sentry_options_new());
+    Path path("sentry-test-blackbox");
+    Path event_path("sentry-test-blackbox-event");
+    Path breadcrumbs_path("sentry-test-blackbox-breadcrumbs");
+
+    {
+        BlackBox blackbox;
+        REQUIRE(!blackbox.write_files(event_path, breadcrumbs_path));
+        REQUIRE(blackbox.open(path, 1024, 4096));
+        REQUIRE(blackbox.write_scope(scope_with_tag("crashed")));
+        for (size_t i = 0; i < 120; i++) {
+            REQUIRE(blackbox.add_breadcrumb(breadcrumb(i)));
+        }
+
+        // stale contents are replaced
+        FILE *f = breadcrumbs_path.open("wb");
+        REQUIRE(f);
+        fputs(std::string(8192, 'x').c_str(), f);
+        fclose(f);
+
+        REQUIRE(blackbox.write_files(event_path, breadcrumbs_path));
+        std::string scope;
+        std::string breadcrumbs;
+        REQUIRE(blackbox.read(&scope, &breadcrumbs));
+        REQUIRE(read_file(event_path) == scope);
+        REQUIRE(read_seq_tag(read_file(event_path)) == "crashed");
+        REQUIRE(read_file(breadcrumbs_path) == breadcrumbs);
+        REQUIRE(count_values(read_file(breadcrumbs_path)) == 120);
+        REQUIRE(!Path("sentry-test-blackbox.scope").is_file());
+        REQUIRE(!Path("sentry-test-blackbox.breadcrumbs").is_file());
+    }
+
+    REQUIRE(path.remove());
+    REQUIRE(event_path.remove());
+    REQUIRE(breadcrumbs_path.remove());
+    sentry_shutdown();
+}
+
+TEST_CASE("black box readers never see partial writes", "[blackbox]") {
+    sentry_init(sentry_options_new());
+    Path path("sentry-test-blackbox");
+
+    {
+        BlackBox blackbox;
+        REQUIRE(blackbox.open(path, 4096, 4096));
+        REQUIRE(blackbox.write_scope(scope_with_tag("0")));
+
+        std::atomic<bool> done(false);
+        std::thread writer([&blackbox, &done]() {
+            for (size_t i = 1; i < 2000; i++) {
+                // the length changes with every write
+                blackbox.write_scope(
+                    scope_with_tag(std::string(i % 64, 'a') + "-" +
+                                   std::to_string(i)));
+                blackbox.add_breadcrumb(breadcrumb(i));
+            }
+            done = true;
+        });
+
+        size_t reads = 0;
+        size_t torn = 0;
+        while (!done) {
+            std::string scope;
+            std::string breadcrumbs;
+            if (!blackbox.read(&scope, &breadcrumbs)) {
+                continue;
+            }
+            reads++;
+            std::string tag = read_seq_tag(scope);
+            if (tag.empty() || scope != encode_scope(scope_with_tag(tag)) ||
+                (!breadcrumbs.empty() && count_values(breadcrumbs) == 0)) {
+                torn++;
+            }
+        }
+        writer.join();
+
+        REQUIRE(reads > 0);
+        REQUIRE(torn == 0);
+    }
+
+    REQUIRE(path.remove());
+    sentry_shutdown();
+}
+#endif
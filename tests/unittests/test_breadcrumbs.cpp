@@ -0,0 +1,206 @@
+#include <breadcrumbs.hpp>
+#include <sentry.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vendor/catch.hpp>
+
+using namespace sentry;
+
+TEST_CASE("compact breadcrumbs become values when collected",
+          "[breadcrumbs]") {
+    record_breadcrumb("http", "request", SENTRY_LEVEL_WARNING, "GET /");
+    record_breadcrumb(nullptr, nullptr, SCOPE_LEVEL_UNSET, nullptr);
+
+    Value crumb = Value::new_breadcrumb("default", "with data");
+    Value data = Value::new_object();
+    data.set_by_key("status", Value::new_int32(404));
+    data.set_by_key("tags", Value::new_list());
+    crumb.set_by_key("data", data);
+    crumb.set_by_key("category", Value::new_string("ui"));
+    record_breadcrumb(crumb);
+
+    Value crumbs = collect_breadcrumbs(Value(), 3);
+    REQUIRE(crumbs.length() == 3);
+
+    Value first = crumbs.get_by_index(0);
+    REQUIRE(first.get_by_key("type").as_cstr() == std::string("http"));
+    REQUIRE(first.get_by_key("category").as_cstr() == std::string("request"));
+    REQUIRE(first.get_by_key("level").as_cstr() == std::string("warning"));
+    REQUIRE(first.get_by_key("message").as_cstr() == std::string("GET /"));
+    std::string timestamp = first.get_by_key("timestamp").as_cstr();
+    REQUIRE(timestamp.size() == strlen("2020-01-01T00:00:00.000Z"));
+    REQUIRE(timestamp[10] == 'T');
+    REQUIRE(timestamp[timestamp.size() - 1] == 'Z');
+
+    Value empty = crumbs.get_by_index(1);
+    REQUIRE(empty.length() == 1);
+    REQUIRE(!empty.get_by_key("timestamp").is_null());
+
+    REQUIRE(crumbs.get_by_index(2) == crumb);
+
+    // the breadcrumbs of pushed scopes come last
+    Value extra = Value::new_list();
+    extra.append(Value::new_breadcrumb(nullptr, "pushed"));
+    crumbs = collect_breadcrumbs(extra, 2);
+    REQUIRE(crumbs.length() == 2);
+    REQUIRE(crumbs.get_by_index(0) == crumb);
+    REQUIRE(crumbs.get_by_index(1).get_by_key("message").as_cstr() ==
+            std::string("pushed"));
+}
+
+TEST_CASE("oversized breadcrumbs are cut down", "[breadcrumbs]") {
+    std::string message(SENTRY_BREADCRUMBS_BYTES_MAX, 'm');
+    Value crumb = Value::new_breadcrumb(nullptr, message.c_str());
+    crumb.set_by_key("data", Value::new_string(message.c_str()));
+    record_breadcrumb(crumb);
+
+    Value collected = collect_breadcrumbs(Value(), 1).get_by_index(0);
+    REQUIRE(collected.get_by_key("data").is_null());
+    REQUIRE(collected.get_by_key("message").length() > 0);
+    REQUIRE(collected.get_by_key("message").length() <
+            SENTRY_BREADCRUMB_SIZE_MAX);
+
+    // a small breadcrumb keeps its data
+    crumb = Value::new_breadcrumb(nullptr, "small");
+    crumb.set_by_key("data", Value::new_string("x"));
+    record_breadcrumb(crumb);
+    collected = collect_breadcrumbs(Value(), 1).get_by_index(0);
+    REQUIRE(collected == crumb);
+}
+
+TEST_CASE("breadcrumbs are limited by the byte budget", "[breadcrumbs]") {
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_breadcrumb_budget(options, 4096, 256);
+    sentry_init(options);
+
+    // a new thread gets a ring of the configured size
+    size_t truncated_len = 0;
+    std::thread writer([&truncated_len]() {
+        std::string message(1000, 'a');
+        record_breadcrumb("log", nullptr, SENTRY_LEVEL_INFO, message.c_str());
+        Value crumb = collect_breadcrumbs(Value(), 1).get_by_index(0);
+        truncated_len = crumb.get_by_key("message").length();
+
+        for (int i = 0; i < 100; i++) {
+            record_breadcrumb("log", nullptr, SENTRY_LEVEL_INFO,
+                              std::string(100, 'b').c_str());
+        }
+    });
+    writer.join();
+    REQUIRE(truncated_len > 0);
+    REQUIRE(truncated_len < 256);
+
+    // about 4096 / 140 records fit, no matter how many are asked for
+    Value crumbs = collect_breadcrumbs(Value(), SENTRY_BREADCRUMBS_MAX);
+    REQUIRE(crumbs.length() > 10);
+    REQUIRE(crumbs.length() < 40);
+
+    // an explicit budget keeps only the newest records
+    REQUIRE(collect_breadcrumbs(Value(), SENTRY_BREADCRUMBS_MAX, 0).length() ==
+            0);
+    Value newest = collect_breadcrumbs(Value(), SENTRY_BREADCRUMBS_MAX, 300);
+    REQUIRE(newest.length() == 2);
+    REQUIRE(newest.get_by_index(1) == crumbs.get_by_index(crumbs.length() - 1));
+
+    sentry_shutdown();
+}
+
+TEST_CASE("breadcrumbs of pushed scopes are within the limits",
+          "[breadcrumbs]") {
+    sentry_options_t *options = sentry_options_new();
+    sentry_options_set_breadcrumb_budget(options, 4096, 256);
+    sentry_init(options);
+
+    std::string message(1000, 'a');
+    Value crumb = Value::new_breadcrumb(nullptr, message.c_str());
+    crumb.set_by_key("data", Value::new_string(message.c_str()));
+    Value record = layer_breadcrumb(crumb);
+    REQUIRE(record.length() <= 256);
+    Value small = layer_breadcrumb(Value::new_breadcrumb(nullptr, "small"));
+
+    Value extra = Value::new_list();
+    extra.append(record);
+    extra.append(small);
+    Value crumbs = collect_breadcrumbs(extra, 2);
+    REQUIRE(crumbs.length() == 2);
+    Value bounded = crumbs.get_by_index(0);
+    REQUIRE(bounded.get_by_key("data").is_null());
+    REQUIRE(bounded.get_by_key("message").length() > 0);
+    REQUIRE(bounded.get_by_key("message").length() < 256);
+    REQUIRE(crumbs.get_by_index(1).get_by_key("message").as_cstr() ==
+            std::string("small"));
+
+    // they share the budget with the recorded breadcrumbs, newest first
+    record_breadcrumb("log", nullptr, SENTRY_LEVEL_INFO, "recorded");
+    crumbs = collect_breadcrumbs(extra, SENTRY_BREADCRUMBS_MAX, 128);
+    REQUIRE(crumbs.length() == 2);
+    REQUIRE(crumbs.get_by_index(0).get_by_key("message").as_cstr() ==
+            std::string("small"));
+    REQUIRE(crumbs.get_by_index(1).get_by_key("message").as_cstr() ==
+            std::string("recorded"));
+    REQUIRE(collect_breadcrumbs(extra, SENTRY_BREADCRUMBS_MAX, 0).length() ==
+            0);
+
+    sentry_shutdown();
+}
+
+TEST_CASE("breadcrumbs of pushed scopes are ordered with recorded ones",
+          "[breadcrumbs]") {
+    record_breadcrumb("log", nullptr, SENTRY_LEVEL_INFO, "before");
+    Value extra = Value::new_list();
+    extra.append(layer_breadcrumb(Value::new_breadcrumb(nullptr, "pushed")));
+    record_breadcrumb("log", nullptr, SENTRY_LEVEL_INFO, "after");
+
+    Value crumbs = collect_breadcrumbs(extra, 3);
+    REQUIRE(crumbs.length() == 3);
+    REQUIRE(crumbs.get_by_index(0).get_by_key("message").as_cstr() ==
+            std::string("before"));
+    REQUIRE(crumbs.get_by_index(1).get_by_key("message").as_cstr() ==
+            std::string("pushed"));
+    REQUIRE(crumbs.get_by_index(2).get_by_key("message").as_cstr() ==
+            std::string("after"));
+}
+
+TEST_CASE("breadcrumbs are collected while they are recorded",
+          "[breadcrumbs]") {
+    std::atomic<bool> done(false);
+    std::thread writer([&done]() {
+        for (int i = 0; i < 20000; i++) {
+            // messages of changing length wrap the ring at odd offsets
+            std::string message =
+                std::to_string(i) + ":" + std::string(i % 300, 'x');
+            record_breadcrumb("log", nullptr, SENTRY_LEVEL_INFO,
+                              message.c_str());
+        }
+        done = true;
+    });
+
+    // the last pass runs after the writer is done, so even a writer that
+    // finishes right away leaves something to collect.
+    size_t collected = 0;
+    size_t broken = 0;
+    bool last_pass = false;
+    while (!last_pass) {
+        last_pass = done;
+        Value crumbs = collect_breadcrumbs(Value(), SENTRY_BREADCRUMBS_MAX);
+        for (size_t i = 0; i < crumbs.length(); i++) {
+            Value crumb = crumbs.get_by_index(i);
+            std::string message = crumb.get_by_key("message").as_cstr();
+            size_t colon = message.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            int n = atoi(message.c_str());
+            collected++;
+            if (message.size() - colon - 1 != (size_t)(n % 300) ||
+                crumb.get_by_key("type").as_cstr() != std::string("log")) {
+                broken++;
+            }
+        }
+    }
+    writer.join();
+
+    REQUIRE(collected > 0);
+    REQUIRE(broken == 0);
+}
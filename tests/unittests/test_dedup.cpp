@@ -0,0 +1,105 @@
+#include <dedup.hpp>
+#include <vendor/catch.hpp>
+
+using namespace sentry;
+using std::chrono::milliseconds;
+
+static Value make_event(const char *type, uint64_t addr) {
+    Value frame = Value::new_object();
+    frame.set_by_key("instruction_addr", Value::new_addr(addr));
+    Value frames = Value::new_list();
+    frames.append(frame);
+    Value stacktrace = Value::new_object();
+    stacktrace.set_by_key("frames", frames);
+    Value exception = Value::new_object();
+    exception.set_by_key("type", Value::new_string(type));
+    exception.set_by_key("stacktrace", stacktrace);
+    Value values = Value::new_list();
+    values.append(exception);
+    Value exceptions = Value::new_object();
+    exceptions.set_by_key("values", values);
+    Value event = Value::new_event();
+    event.set_by_key("exception", exceptions);
+    return event;
+}
+
+TEST_CASE("event signatures", "[dedup]") {
+    Value no_fingerprint;
+    uint64_t sig = Deduplicator::signature(make_event("SIGSEGV", 0x1000),
+                                           no_fingerprint);
+    REQUIRE(sig != 0);
+    // event ids and timestamps do not matter
+    REQUIRE(Deduplicator::signature(make_event("SIGSEGV", 0x1000),
+                                    no_fingerprint) == sig);
+    REQUIRE(Deduplicator::signature(make_event("SIGABRT", 0x1000),
+                                    no_fingerprint) != sig);
+    REQUIRE(Deduplicator::signature(make_event("SIGSEGV", 0x1004),
+                                    no_fingerprint) != sig);
+
+    Value fingerprint = Value::new_list();
+    fingerprint.append(Value::new_string("custom"));
+    REQUIRE(Deduplicator::signature(make_event("SIGSEGV", 0x1000),
+                                    fingerprint) != sig);
+
+    REQUIRE(Deduplicator::signature(Value::new_event(), no_fingerprint) == 0);
+}
+
+TEST_CASE("duplicates are suppressed and aggregated", "[dedup]") {
+    Deduplicator dedup(16, milliseconds(1000));
+    Deduplicator::Clock::time_point now = Deduplicator::Clock::now();
+    Value no_fingerprint;
+
+    uint64_t sig = 0;
+    REQUIRE(dedup.check(make_event("SIGSEGV", 0x1000), no_fingerprint, now,
+                        &sig));
+    REQUIRE(sig != 0);
+    std::shared_ptr<Scope> scope(new Scope());
+    dedup.attach_scope(sig, scope);
+    REQUIRE(dedup.check(make_event("SIGABRT", 0x1000), no_fingerprint, now));
+    for (int i = 0; i < 5; i++) {
+        REQUIRE(!dedup.check(make_event("SIGSEGV", 0x1000), no_fingerprint,
+                             now + milliseconds(i * 100)));
+    }
+    // events without a signature are never suppressed
+    REQUIRE(dedup.check(Value::new_event(), no_fingerprint, now));
+    REQUIRE(dedup.check(Value::new_event(), no_fingerprint, now));
+
+    REQUIRE(dedup.take_aggregates(now + milliseconds(999)).empty());
+
+    std::vector<Deduplicator::Aggregate> aggregates =
+        dedup.take_aggregates(now + milliseconds(1000));
+    REQUIRE(aggregates.size() == 1);
+    REQUIRE(aggregates[0].event.navigate("extra.duplicate_count").as_double() == 5);
+    REQUIRE(aggregates[0].event.navigate("exception.values.0.type").as_cstr() ==
+            std::string("SIGSEGV"));
+    REQUIRE(aggregates[0].event.get_by_key("event_id").is_null());
+    REQUIRE(aggregates[0].scope == scope);
+    REQUIRE(dedup.size() == 0);
+
+    // a new window starts after the old one expired
+    REQUIRE(dedup.check(make_event("SIGSEGV", 0x1000), no_fingerprint,
+                        now + milliseconds(1500)));
+    REQUIRE(!dedup.check(make_event("SIGSEGV", 0x1000), no_fingerprint,
+                         now + milliseconds(1600)));
+    REQUIRE(dedup.take_aggregates(now, true).size() == 1);
+}
+
+TEST_CASE("dedup entries are bounded", "[dedup]") {
+    Deduplicator dedup(4, milliseconds(1000));
+    Deduplicator::Clock::time_point now = Deduplicator::Clock::now();
+    Value no_fingerprint;
+
+    REQUIRE(dedup.check(make_event("first", 0x1000), no_fingerprint, now));
+    REQUIRE(!dedup.check(make_event("first", 0x1000), no_fingerprint, now));
+    for (uint64_t i = 0; i < 4; i++) {
+        REQUIRE(dedup.check(make_event("other", i), no_fingerprint, now));
+    }
+    REQUIRE(dedup.size() == 4);
+
+    // evicting the least recently seen entry hands out its aggregate
+    std::vector<Deduplicator::Aggregate> aggregates = dedup.take_aggregates(now);
+    REQUIRE(aggregates.size() == 1);
+    REQUIRE(aggregates[0].event.navigate("exception.values.0.type").as_cstr() ==
+            std::string("first"));
+    REQUIRE(dedup.check(make_event("first", 0x1000), no_fingerprint, now));
+}
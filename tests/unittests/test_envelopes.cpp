@@ -0,0 +1,215 @@
+#include <outbox.hpp>
+#include <sentry.h>
+#include <cstring>
+#include <string>
+#include <transports/envelopes.hpp>
+#include <vendor/catch.hpp>
+#include "../testutils.hpp"
+
+using namespace sentry::transports;
+
+static std::string read_body(RequestBody &body, size_t chunk_size) {
+    std::string rv;
+    std::vector<char> buf(chunk_size);
+    while (size_t len = body.read(&buf[0], chunk_size)) {
+        rv.append(&buf[0], len);
+    }
+    return rv;
+}
+
+TEST_CASE("request body segments", "[envelopes]") {
+    std::string payload = "0123456789";
+    RequestBody body;
+    body.append("--head--");
+    body.append_ref(payload);
+    body.append("--tail--");
+    REQUIRE(body.size() == 26);
+
+    REQUIRE(read_body(body, 3) == "--head--0123456789--tail--");
+    REQUIRE(body.read(nullptr, 0) == 0);
+
+    REQUIRE(body.seek(12));
+    REQUIRE(read_body(body, 100) == "456789--tail--");
+    REQUIRE(!body.seek(27));
+}
+
+TEST_CASE("multipart requests reference item payloads", "[envelopes]") {
+    WITH_MOCK_TRANSPORT(nullptr) {
+        Envelope envelope(sentry::Value::new_event());
+        std::string minidump(100000, 'x');
+        envelope.add_item(
+            EnvelopeItem(minidump.c_str(), minidump.size(), "minidump"));
+
+        std::vector<std::string> urls;
+        std::vector<std::string> bodies;
+        envelope.for_each_request([&](PreparedHttpRequest &&request) {
+            urls.push_back(request.url);
+            bodies.push_back(read_body(request.body, 4096));
+            REQUIRE(bodies.back().size() == request.body.size());
+            return true;
+        });
+
+        REQUIRE(bodies.size() == 2);
+        REQUIRE(urls[0].find("/store/") != std::string::npos);
+        REQUIRE(urls[1].find("/minidump/") != std::string::npos);
+        REQUIRE(bodies[1].find(minidump) != std::string::npos);
+        REQUIRE(bodies[1].find("filename=\"minidump.dmp\"") !=
+                std::string::npos);
+    }
+}
+
+TEST_CASE("file items are read lazily and truncated", "[envelopes]") {
+    sentry::Path path("sentry-test-attachment.log");
+    FILE *f = path.open("wb");
+    REQUIRE(f);
+    fputs("0123456789abcdefghij", f);
+    fclose(f);
+
+    EnvelopeItem full(path);
+    EnvelopeItem truncated(path, "attachment", 5);
+    REQUIRE(full.is_file());
+    REQUIRE(full.length() == 20);
+    REQUIRE(truncated.length() == 5);
+
+    // changes after the item was created are only seen when reading
+    f = path.open("wb");
+    fputs("ABCDEFGHIJKLMNOPQRST", f);
+    fclose(f);
+
+    RequestBody body;
+    truncated.append_payload_to(body);
+    REQUIRE(read_body(body, 2) == "PQRST");
+
+    sentry::MemoryIoWriter writer;
+    full.serialize_into(writer);
+    writer.flush();
+    std::string serialized(writer.buf(), writer.len());
+    REQUIRE(serialized.find("\"length\":20") != std::string::npos);
+    REQUIRE(serialized.find("\nABCDEFGHIJKLMNOPQRST\n") != std::string::npos);
+
+    path.remove();
+    body.seek(0);
+    REQUIRE(read_body(body, 100) == std::string(5, '\0'));
+}
+
+TEST_CASE("requests round trip through the outbox", "[envelopes]") {
+    sentry::Path directory("sentry-test-outbox");
+    directory.remove_all();
+
+    WITH_MOCK_TRANSPORT(nullptr) {
+        sentry::Outbox outbox;
+        REQUIRE(outbox.open(directory));
+
+        Envelope envelope(sentry::Value::new_event());
+        envelope.for_each_request([&](PreparedHttpRequest &&request) {
+            RequestBody record = request.into_record();
+            REQUIRE(outbox.append(record));
+            return true;
+        });
+
+        sentry::OutboxRecord record;
+        REQUIRE(outbox.front(&record));
+        PreparedHttpRequest request;
+        REQUIRE(request.read_record(record.path, record.offset, record.len));
+        REQUIRE(request.url.find("/store/") != std::string::npos);
+        REQUIRE(request.headers.size() == 3);
+        REQUIRE(request.headers[1] == "content-type:application/json");
+        std::string body = read_body(request.body, 7);
+        REQUIRE(body.size() == request.body.size());
+        REQUIRE(body.find("\"event_id\"") != std::string::npos);
+    }
+
+    directory.remove_all();
+}
+
+TEST_CASE("envelopes are read back without copying", "[envelopes]") {
+    WITH_MOCK_TRANSPORT(nullptr) {
+        sentry::Value event = sentry::Value::new_event();
+        event.set_by_key("message", sentry::Value::new_string("hello"));
+        Envelope envelope(event);
+        std::string minidump("MDMP\nwith\nnewlines");
+        envelope.add_item(
+            EnvelopeItem(minidump.c_str(), minidump.size(), "minidump"));
+
+        size_t len;
+        char *buf = envelope.serialize(&len);
+
+        EnvelopeReader reader(buf, len);
+        sentry::Value headers;
+        REQUIRE(reader.read_headers(&headers));
+        REQUIRE(headers.get_by_key("event_id") ==
+                event.get_by_key("event_id"));
+
+        EnvelopeItemView item;
+        REQUIRE(reader.next(&item));
+        REQUIRE(item.type() == std::string("event"));
+        REQUIRE(item.payload > buf);
+        REQUIRE(item.payload < buf + len);
+        sentry::Value parsed;
+        REQUIRE(item.parse_payload(&parsed));
+        REQUIRE(parsed.get_by_key("message").as_cstr() ==
+                std::string("hello"));
+
+        REQUIRE(reader.next(&item));
+        REQUIRE(item.type() == std::string("minidump"));
+        REQUIRE(std::string(item.payload, item.payload_len) == minidump);
+        REQUIRE(!reader.next(&item));
+        REQUIRE(!reader.failed());
+
+        // the public API copies the envelope and serializes it unchanged
+        sentry_envelope_t *copy = sentry_envelope_deserialize(buf, len);
+        REQUIRE(copy);
+        sentry::Value copied_event(sentry_envelope_get_event(copy));
+        REQUIRE(copied_event.get_by_key("message").as_cstr() ==
+                std::string("hello"));
+        size_t copy_len;
+        char *copy_buf = sentry_envelope_serialize(copy, &copy_len);
+        REQUIRE(std::string(copy_buf, copy_len) == std::string(buf, len));
+        free(copy_buf);
+        sentry_envelope_free(copy);
+
+        free(buf);
+    }
+}
+
+TEST_CASE("malformed envelopes are rejected", "[envelopes]") {
+    const char *truncated =
+        "{\"event_id\":\"4c035723-8638-4c3a-923f-2ab9d08b4018\"}\n"
+        "{\"type\":\"attachment\",\"length\":10}\nshort";
+    EnvelopeReader reader(truncated, strlen(truncated));
+    EnvelopeItemView item;
+    REQUIRE(!reader.next(&item));
+    REQUIRE(reader.failed());
+    REQUIRE(!sentry_envelope_deserialize(truncated, strlen(truncated)));
+
+    const char *bad_header = "{}\nnot json\n";
+    REQUIRE(!sentry_envelope_deserialize(bad_header, strlen(bad_header)));
+
+    // items without a length extend to the end of the line
+    const char *implicit = "{}\n{\"type\":\"attachment\"}\nabc\n\n";
+    EnvelopeReader implicit_reader(implicit, strlen(implicit));
+    REQUIRE(implicit_reader.next(&item));
+    REQUIRE(std::string(item.payload, item.payload_len) == "abc");
+    REQUIRE(!implicit_reader.next(&item));
+    REQUIRE(!implicit_reader.failed());
+}
+
+TEST_CASE("envelopes are read from mapped files", "[envelopes]") {
+    sentry::Path path("sentry-test-envelope");
+    FILE *f = path.open("wb");
+    REQUIRE(f);
+    fputs("{}\n{\"type\":\"attachment\",\"length\":3}\nabc\n", f);
+    fclose(f);
+
+    {
+        EnvelopeReader reader;
+        REQUIRE(reader.open_file(path));
+        EnvelopeItemView item;
+        REQUIRE(reader.next(&item));
+        REQUIRE(std::string(item.payload, item.payload_len) == "abc");
+        REQUIRE(!reader.next(&item));
+        REQUIRE(!reader.failed());
+    }
+
+    path.remove();
+}
@@ -0,0 +1,202 @@
+#include <path.hpp>
+#include <sentry.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <transports/envelopes.hpp>
+#include <transports/file_sink_transport.hpp>
+#include <vector>
+#include <vendor/catch.hpp>
+
+using namespace sentry;
+using namespace sentry::transports;
+
+static std::string read_file(const Path &path) {
+    std::string rv;
+    FILE *f = path.open("rb");
+    REQUIRE(f);
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        rv.append(buf, n);
+    }
+    fclose(f);
+    return rv;
+}
+
+static std::vector<Path> files_ending_in(const Path &directory,
+                                         const char *suffix) {
+    std::vector<Path> rv;
+    PathIterator iter = directory.iter_directory();
+    while (iter.next()) {
+        if (iter.path()->ends_with(suffix)) {
+            rv.push_back(*iter.path());
+        }
+    }
+    return rv;
+}
+
+static Value new_event() {
+    Value event = Value::new_event();
+    event.set_by_key("message", Value::new_string("file sink test"));
+    return event;
+}
+
+struct IndexEntry {
+    size_t offset;
+    size_t len;
+    std::string event_id;
+};
+
+static std::vector<IndexEntry> read_index(const Path &path) {
+    std::vector<IndexEntry> rv;
+    std::istringstream lines(read_file(path));
+    IndexEntry entry;
+    while (lines >> entry.offset >> entry.len >> entry.event_id) {
+        rv.push_back(entry);
+    }
+    return rv;
+}
+
+static std::vector<std::string> send_events(FileSinkTransport &transport,
+                                            size_t count) {
+    std::vector<std::string> rv;
+    for (size_t i = 0; i < count; i++) {
+        Envelope envelope(new_event());
+        sentry_uuid_t event_id = envelope.event_id();
+        char event_id_str[40];
+        sentry_uuid_as_string(&event_id, event_id_str);
+        rv.push_back(event_id_str);
+        transport.send_envelope(envelope);
+    }
+    return rv;
+}
+
+TEST_CASE("file sink rotates files by size", "[file_sink]") {
+    Path directory("sentry-test-file-sink");
+    directory.remove_all();
+
+    FileSinkPolicy policy;
+    policy.max_file_size = 1024;
+    policy.sync = SENTRY_FILE_SINK_SYNC_BATCH;
+    {
+        FileSinkTransport transport(directory, policy);
+        transport.start();
+        send_events(transport, 20);
+        transport.shutdown();
+    }
+
+    REQUIRE(files_ending_in(directory, ".part").empty());
+    std::vector<Path> data_files = files_ending_in(directory, ".envelopes");
+    std::vector<Path> indexes = files_ending_in(directory, ".index");
+    REQUIRE(data_files.size() > 1);
+    REQUIRE(data_files.size() == indexes.size());
+
+    size_t data_size = 0;
+    for (const Path &path : data_files) {
+        size_t size;
+        REQUIRE(path.get_size(&size));
+        data_size += size;
+    }
+    size_t entries = 0;
+    size_t indexed_size = 0;
+    for (const Path &path : indexes) {
+        for (const IndexEntry &entry : read_index(path)) {
+            indexed_size += entry.len;
+            entries++;
+        }
+    }
+    REQUIRE(entries == 20);
+    REQUIRE(indexed_size == data_size);
+    directory.remove_all();
+}
+
+TEST_CASE("file sink index points at the envelopes", "[file_sink]") {
+    Path directory("sentry-test-file-sink");
+    directory.remove_all();
+
+    FileSinkPolicy policy;
+    policy.sync = SENTRY_FILE_SINK_SYNC_ENVELOPE;
+    std::vector<std::string> event_ids;
+    {
+        FileSinkTransport transport(directory, policy);
+        transport.start();
+        event_ids = send_events(transport, 10);
+    }
+
+    std::vector<Path> data_files = files_ending_in(directory, ".envelopes");
+    std::vector<Path> indexes = files_ending_in(directory, ".index");
+    REQUIRE(data_files.size() == 1);
+    REQUIRE(indexes.size() == 1);
+
+    std::string data = read_file(data_files[0]);
+    std::vector<IndexEntry> entries = read_index(indexes[0]);
+    REQUIRE(entries.size() == event_ids.size());
+    size_t offset = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        REQUIRE(entries[i].offset == offset);
+        REQUIRE(entries[i].event_id == event_ids[i]);
+        EnvelopeReader reader(data.data() + entries[i].offset, entries[i].len);
+        Value headers;
+        REQUIRE(reader.read_headers(&headers));
+        REQUIRE(headers.get_by_key("event_id").as_cstr() == event_ids[i]);
+        offset += entries[i].len;
+    }
+    REQUIRE(offset == data.size());
+    directory.remove_all();
+}
+
+TEST_CASE("file sink finishes files of an earlier run", "[file_sink]") {
+    Path directory("sentry-test-file-sink");
+    directory.remove_all();
+    REQUIRE(directory.create_directories());
+    FILE *f = directory.join("0-00000000.envelopes.part").open("wb");
+    REQUIRE(f);
+    fclose(f);
+
+    {
+        FileSinkTransport transport(directory);
+        transport.start();
+    }
+
+    REQUIRE(files_ending_in(directory, ".part").empty());
+    REQUIRE(directory.join("0-00000000.envelopes").is_file());
+    directory.remove_all();
+}
+
+TEST_CASE("file sink leaves files of live writers alone", "[file_sink]") {
+    Path directory("sentry-test-file-sink");
+    directory.remove_all();
+    REQUIRE(directory.create_directories());
+
+    // a writer that crashed left its lock behind
+    FILE *f = directory.join("00000001.lock").open("wb");
+    REQUIRE(f);
+    fclose(f);
+    f = directory.join("00000001-0-00000000.envelopes.part").open("wb");
+    REQUIRE(f);
+    fclose(f);
+
+    FileSinkTransport live(directory);
+    live.start();
+    REQUIRE(directory.join("00000001-0-00000000.envelopes").is_file());
+    REQUIRE(!directory.join("00000001.lock").is_file());
+
+    send_events(live, 1);
+    for (int i = 0; i < 500 && files_ending_in(directory, ".part").empty();
+         i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    REQUIRE(files_ending_in(directory, ".envelopes.part").size() == 1);
+
+    {
+        FileSinkTransport other(directory);
+        other.start();
+    }
+    REQUIRE(files_ending_in(directory, ".envelopes.part").size() == 1);
+
+    live.shutdown();
+    REQUIRE(files_ending_in(directory, ".part").empty());
+    REQUIRE(files_ending_in(directory, ".lock").empty());
+    directory.remove_all();
+}
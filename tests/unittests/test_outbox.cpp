@@ -0,0 +1,211 @@
+#include <outbox.hpp>
+#include <string>
+#include <vector>
+#include <vendor/catch.hpp>
+
+using namespace sentry;
+
+static std::string read_record(const OutboxRecord &record) {
+    std::string rv(record.len, '\0');
+    FILE *f = record.path.open("rb");
+    REQUIRE(f);
+    fseek(f, (long)record.offset, SEEK_SET);
+    REQUIRE(fread(&rv[0], 1, record.len, f) == record.len);
+    fclose(f);
+    return rv;
+}
+
+static size_t count_files(const Path &directory) {
+    size_t rv = 0;
+    PathIterator iter = directory.iter_directory();
+    while (iter.next()) {
+        rv++;
+    }
+    return rv;
+}
+
+TEST_CASE("outbox replays unacknowledged records", "[outbox]") {
+    Path directory("sentry-test-outbox");
+    directory.remove_all();
+
+    {
+        Outbox outbox;
+        REQUIRE(outbox.open(directory));
+        uint64_t first, second;
+        REQUIRE(outbox.append("first", 5, &first));
+        REQUIRE(outbox.append("second", 6, &second));
+        REQUIRE(outbox.append("third", 5, nullptr, 42));
+        REQUIRE(outbox.pending() == 3);
+        REQUIRE(outbox.ack(first));
+        REQUIRE(!outbox.ack(first));
+    }
+
+    Outbox outbox;
+    REQUIRE(outbox.open(directory));
+    REQUIRE(outbox.pending() == 2);
+
+    OutboxRecord record;
+    REQUIRE(outbox.front(&record));
+    REQUIRE(read_record(record) == "second");
+    REQUIRE(record.tag == 0);
+    REQUIRE(outbox.ack(record.seq));
+    REQUIRE(outbox.front(&record));
+    REQUIRE(read_record(record) == "third");
+    REQUIRE(record.tag == 42);
+
+    // new records keep their order after the replayed ones
+    uint64_t seq;
+    REQUIRE(outbox.append("fourth", 6, &seq));
+    REQUIRE(seq > record.seq);
+
+    outbox.close();
+    directory.remove_all();
+}
+
+TEST_CASE("outbox leaves out held records", "[outbox]") {
+    Path directory("sentry-test-outbox-held");
+    directory.remove_all();
+
+    Outbox outbox;
+    REQUIRE(outbox.open(directory));
+    uint64_t first, second, third;
+    REQUIRE(outbox.append("first", 5, &first));
+    REQUIRE(outbox.append("second", 6, &second));
+    REQUIRE(outbox.append("third", 5, &third));
+
+    outbox.hold(second);
+    std::vector<OutboxRecord> ready;
+    outbox.ready(&ready);
+    REQUIRE(ready.size() == 2);
+    REQUIRE(read_record(ready[0]) == "first");
+    REQUIRE(read_record(ready[1]) == "third");
+    REQUIRE(outbox.pending() == 3);
+
+    // acknowledged records do not come back when they are released
+    REQUIRE(outbox.ack(first));
+    outbox.hold(first);
+    outbox.release(first);
+    outbox.release(second);
+    ready.clear();
+    outbox.ready(&ready);
+    REQUIRE(ready.size() == 2);
+    REQUIRE(ready[0].seq == second);
+    REQUIRE(ready[1].seq == third);
+
+    outbox.close();
+    directory.remove_all();
+}
+
+TEST_CASE("outbox ignores torn records", "[outbox]") {
+    Path directory("sentry-test-outbox");
+    directory.remove_all();
+
+    Path segment;
+    {
+        Outbox outbox;
+        REQUIRE(outbox.open(directory));
+        REQUIRE(outbox.append("complete", 8));
+        REQUIRE(outbox.append("truncated", 9));
+        OutboxRecord record;
+        REQUIRE(outbox.front(&record));
+        segment = record.path;
+    }
+
+    // simulate a crash in the middle of writing the last record
+    size_t size;
+    REQUIRE(segment.get_size(&size));
+    std::string contents(size, '\0');
+    FILE *f = segment.open("rb");
+    REQUIRE(fread(&contents[0], 1, size, f) == size);
+    fclose(f);
+    f = segment.open("wb");
+    fwrite(contents.c_str(), 1, size - 3, f);
+    fclose(f);
+
+    Outbox outbox;
+    REQUIRE(outbox.open(directory));
+    REQUIRE(outbox.pending() == 1);
+    REQUIRE(outbox.append("replacement", 11));
+
+    OutboxRecord record;
+    REQUIRE(outbox.front(&record));
+    REQUIRE(read_record(record) == "complete");
+    REQUIRE(outbox.ack(record.seq));
+    REQUIRE(outbox.front(&record));
+    REQUIRE(read_record(record) == "replacement");
+
+    outbox.close();
+    directory.remove_all();
+}
+
+TEST_CASE("outbox recycles and drops segments", "[outbox]") {
+    Path directory("sentry-test-outbox");
+    directory.remove_all();
+
+    std::string payload(100, 'x');
+    Outbox outbox;
+    REQUIRE(outbox.open(directory, 300, 4));
+
+    // every segment fits two records
+    for (int i = 0; i < 6; i++) {
+        REQUIRE(outbox.append(payload.c_str(), payload.size()));
+    }
+    REQUIRE(count_files(directory) == 3);
+
+    OutboxRecord record;
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(outbox.front(&record));
+        REQUIRE(outbox.ack(record.seq));
+    }
+    // the tombstones went into a new segment.  The first segment is kept
+    // as a spare, the second one is removed.
+    REQUIRE(count_files(directory) == 3);
+    REQUIRE(directory.join("recycled").is_file());
+
+    for (int i = 0; i < 10; i++) {
+        REQUIRE(outbox.append(payload.c_str(), payload.size()));
+    }
+    REQUIRE(outbox.dropped() > 0);
+    REQUIRE(count_files(directory) <= 4);
+    REQUIRE(outbox.pending() == 12 - outbox.dropped());
+
+    outbox.close();
+    Outbox reopened;
+    REQUIRE(reopened.open(directory, 300, 4));
+    REQUIRE(reopened.pending() == 12 - outbox.dropped());
+
+    reopened.close();
+    directory.remove_all();
+}
+
+TEST_CASE("outbox keeps pinned segments", "[outbox]") {
+    Path directory("sentry-test-outbox");
+    directory.remove_all();
+
+    std::string payload(100, 'x');
+    Outbox outbox;
+    REQUIRE(outbox.open(directory, 300, 2));
+    REQUIRE(outbox.append("first", 5));
+    REQUIRE(outbox.append(payload.c_str(), payload.size()));
+
+    OutboxRecord record;
+    REQUIRE(outbox.front(&record));
+    REQUIRE(outbox.pin(record));
+
+    // the first segment is dropped while it is still being read
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(outbox.append(payload.c_str(), payload.size()));
+    }
+    REQUIRE(outbox.dropped() == 2);
+    OutboxRecord dropped;
+    REQUIRE(!outbox.get(record.seq, &dropped));
+    REQUIRE(!outbox.pin(record));
+    REQUIRE(record.path.is_file());
+    REQUIRE(read_record(record) == "first");
+
+    outbox.unpin(record);
+    REQUIRE(!record.path.is_file());
+
+    outbox.close();
+    directory.remove_all();
+}
@@ -0,0 +1,107 @@
+#include <transports/retry.hpp>
+#include <vendor/catch.hpp>
+
+using namespace sentry::transports;
+using std::chrono::milliseconds;
+
+static RetryPolicy test_policy() {
+    RetryPolicy policy;
+    policy.initial_backoff = milliseconds(100);
+    policy.max_backoff = milliseconds(1000);
+    policy.max_attempts = 4;
+    policy.breaker_threshold = 2;
+    policy.breaker_cooldown = milliseconds(500);
+    return policy;
+}
+
+TEST_CASE("retry backoff grows with jitter", "[retry]") {
+    RetryScheduler scheduler(test_policy());
+    for (int i = 0; i < 100; i++) {
+        milliseconds first = scheduler.backoff(1);
+        REQUIRE(first >= milliseconds(50));
+        REQUIRE(first <= milliseconds(100));
+        milliseconds third = scheduler.backoff(3);
+        REQUIRE(third >= milliseconds(200));
+        REQUIRE(third <= milliseconds(400));
+        milliseconds capped = scheduler.backoff(20);
+        REQUIRE(capped >= milliseconds(500));
+        REQUIRE(capped <= milliseconds(1000));
+    }
+}
+
+TEST_CASE("retries are handed out in due order", "[retry]") {
+    RetryScheduler scheduler(test_policy());
+    RetryScheduler::Clock::time_point now = RetryScheduler::Clock::now();
+
+    scheduler.defer(1, now + milliseconds(300));
+    scheduler.defer(2, now + milliseconds(100));
+    scheduler.defer(3, now + milliseconds(200));
+    // rescheduling replaces the earlier entry
+    scheduler.defer(3, now + milliseconds(400));
+    REQUIRE(scheduler.is_scheduled(2));
+
+    RetryScheduler::Clock::time_point due;
+    REQUIRE(scheduler.next_due(&due));
+    REQUIRE(due == now + milliseconds(100));
+
+    uint64_t id;
+    REQUIRE(!scheduler.pop_due(now, &id));
+    REQUIRE(scheduler.pop_due(now + milliseconds(250), &id));
+    REQUIRE(id == 2);
+    REQUIRE(!scheduler.is_scheduled(2));
+    REQUIRE(!scheduler.pop_due(now + milliseconds(250), &id));
+    REQUIRE(scheduler.pop_due(now + milliseconds(1000), &id));
+    REQUIRE(id == 1);
+    REQUIRE(scheduler.pop_due(now + milliseconds(1000), &id));
+    REQUIRE(id == 3);
+    REQUIRE(!scheduler.next_due(&due));
+}
+
+TEST_CASE("retries give up after max attempts", "[retry]") {
+    RetryScheduler scheduler(test_policy());
+    RetryScheduler::Clock::time_point now = RetryScheduler::Clock::now();
+    REQUIRE(scheduler.schedule_retry(7, now));
+    REQUIRE(scheduler.schedule_retry(7, now));
+    REQUIRE(scheduler.schedule_retry(7, now));
+    REQUIRE(!scheduler.schedule_retry(7, now));
+    REQUIRE(!scheduler.is_scheduled(7));
+}
+
+TEST_CASE("circuit breaker opens and probes", "[retry]") {
+    RetryScheduler scheduler(test_policy());
+    RetryScheduler::Clock::time_point now = RetryScheduler::Clock::now();
+    std::string endpoint = endpoint_for_url("https://example.com:443/api/42/");
+    REQUIRE(endpoint == "https://example.com:443");
+
+    REQUIRE(scheduler.allow_request(endpoint, now));
+    scheduler.record_failure(endpoint, now);
+    REQUIRE(scheduler.allow_request(endpoint, now));
+    scheduler.record_failure(endpoint, now);
+
+    RetryScheduler::Clock::time_point retry_at;
+    REQUIRE(!scheduler.allow_request(endpoint, now, &retry_at));
+    REQUIRE(retry_at == now + milliseconds(500));
+    REQUIRE(scheduler.allow_request("https://other.example.com", now));
+
+    // after the cooldown a single probe goes through
+    now += milliseconds(500);
+    REQUIRE(scheduler.allow_request(endpoint, now));
+    // requests behind the probe are never due right away
+    REQUIRE(!scheduler.allow_request(endpoint, now, &retry_at));
+    REQUIRE(retry_at > now);
+    scheduler.record_failure(endpoint, now);
+    REQUIRE(!scheduler.allow_request(endpoint, now));
+
+    // a probe that was rate limited lets the next request probe again
+    now += milliseconds(500);
+    REQUIRE(scheduler.allow_request(endpoint, now));
+    scheduler.release_probe(endpoint);
+    REQUIRE(scheduler.allow_request(endpoint, now));
+    scheduler.record_failure(endpoint, now);
+
+    now += milliseconds(500);
+    REQUIRE(scheduler.allow_request(endpoint, now));
+    scheduler.record_success(endpoint);
+    REQUIRE(scheduler.allow_request(endpoint, now));
+    REQUIRE(scheduler.allow_request(endpoint, now));
+}
@@ -0,0 +1,122 @@
+#include <path.hpp>
+#include <scope.hpp>
+#include <scope_flusher.hpp>
+#include <sentry.h>
+#include <string>
+#include <thread>
+#include <vendor/catch.hpp>
+
+using namespace sentry;
+
+static std::string read_file(const Path &path) {
+    std::string rv;
+    FILE *f = path.open("rb");
+    if (!f) {
+        return rv;
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        rv.append(buf, n);
+    }
+    fclose(f);
+    return rv;
+}
+
+static std::shared_ptr<const Scope> scope_with_tag(const std::string &value) {
+    std::shared_ptr<Scope> scope(new Scope());
+    scope->tags.set_by_key("state", Value::new_string(value.c_str()));
+    return scope;
+}
+
+TEST_CASE("scope flusher coalesces bursts", "[scope_flusher]") {
+    // applying the scope reads the release and environment from the options
+    sentry_init(sentry_options_new());
+    Path dir("sentry-test-scope-flusher");
+    dir.remove_all();
+    REQUIRE(dir.create_directories());
+    Path path = dir.join("scope");
+    Path temp_path = dir.join("scope.tmp");
+
+    {
+        ScopeFlusher flusher;
+        flusher.start(path, temp_path, std::chrono::milliseconds(200));
+        for (int i = 0; i < 1000; i++) {
+            flusher.mark_dirty(scope_with_tag("burst-" + std::to_string(i)));
+        }
+
+        // the first change is written right away, the rest waits for the
+        // interval and is written once.
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+        REQUIRE(flusher.writes() <= 2);
+        std::string contents = read_file(path);
+        REQUIRE(contents.find("burst-999") != std::string::npos);
+        REQUIRE(!temp_path.is_file());
+
+        flusher.mark_dirty(scope_with_tag("final"));
+        REQUIRE(flusher.flush());
+        REQUIRE(read_file(path).find("final") != std::string::npos);
+        flusher.shutdown();
+    }
+
+    dir.remove_all();
+    sentry_shutdown();
+}
+
+TEST_CASE("scope flusher without an interval writes right away",
+          "[scope_flusher]") {
+    // applying the scope reads the release and environment from the options
+    sentry_init(sentry_options_new());
+    Path dir("sentry-test-scope-flusher");
+    dir.remove_all();
+    REQUIRE(dir.create_directories());
+    Path path = dir.join("scope");
+    Path temp_path = dir.join("scope.tmp");
+
+    {
+        ScopeFlusher flusher;
+        flusher.start(path, temp_path, std::chrono::milliseconds(0));
+        flusher.mark_dirty(scope_with_tag("first"));
+        REQUIRE(flusher.writes() == 1);
+        flusher.mark_dirty(scope_with_tag("second"));
+        REQUIRE(flusher.writes() == 2);
+        REQUIRE(read_file(path).find("second") != std::string::npos);
+        flusher.shutdown();
+    }
+
+    dir.remove_all();
+    sentry_shutdown();
+}
+
+TEST_CASE("scope flusher writes pending changes on shutdown",
+          "[scope_flusher]") {
+    // applying the scope reads the release and environment from the options
+    sentry_init(sentry_options_new());
+    Path dir("sentry-test-scope-flusher");
+    dir.remove_all();
+    REQUIRE(dir.create_directories());
+    Path path = dir.join("scope");
+    Path temp_path = dir.join("scope.tmp");
+
+    {
+        ScopeFlusher flusher;
+        flusher.set_breadcrumbs_path(dir.join("breadcrumbs"));
+        flusher.start(path, temp_path, std::chrono::seconds(60));
+        flusher.mark_dirty(scope_with_tag("first"));
+
+        std::shared_ptr<Scope> scope(new Scope());
+        scope->tags.set_by_key("state", Value::new_string("second"));
+        Value crumb = Value::new_object();
+        crumb.set_by_key("message", Value::new_string("a breadcrumb"));
+        scope->breadcrumbs.append(crumb);
+        flusher.mark_dirty(scope);
+
+        flusher.shutdown();
+        REQUIRE(read_file(path).find("second") != std::string::npos);
+        REQUIRE(read_file(dir.join("breadcrumbs")).find("a breadcrumb") !=
+                std::string::npos);
+    }
+
+    dir.remove_all();
+    sentry_shutdown();
+}
@@ -0,0 +1,133 @@
+#if !defined(_WIN32) && !defined(__ANDROID__)
+#include <sentry.h>
+#include <shmring.hpp>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vendor/catch.hpp>
+
+using namespace sentry;
+
+static const char *RING_NAME = "/sentry-test-ring";
+
+TEST_CASE("shared ring round trips records", "[shmring]") {
+    SharedRing::unlink(RING_NAME);
+    SharedRing ring;
+    REQUIRE(ring.open(RING_NAME, 256));
+    REQUIRE(ring.capacity() == 256);
+
+    std::string out;
+    REQUIRE(!ring.pop(&out));
+
+    // records wrap around the end of the buffer many times
+    for (int i = 0; i < 100; i++) {
+        std::string record(i % 50, (char)('a' + i % 26));
+        REQUIRE(ring.push(record.data(), record.size()));
+        REQUIRE(ring.pop(&out));
+        REQUIRE(out == record);
+    }
+
+    // a second mapping sees the same ring and its capacity
+    SharedRing other;
+    REQUIRE(other.open(RING_NAME, 4096));
+    REQUIRE(other.capacity() == 256);
+    REQUIRE(other.push("hello", 5));
+    REQUIRE(ring.pop(&out));
+    REQUIRE(out == "hello");
+
+    ring.close();
+    other.close();
+    SharedRing::unlink(RING_NAME);
+}
+
+TEST_CASE("shared ring drops when full", "[shmring]") {
+    SharedRing::unlink(RING_NAME);
+    SharedRing ring;
+    REQUIRE(ring.open(RING_NAME, 64));
+
+    // every record takes 8 bytes of state plus 24 bytes of payload
+    std::string record(20, 'x');
+    REQUIRE(ring.push(record.data(), record.size()));
+    REQUIRE(ring.push(record.data(), record.size()));
+    REQUIRE(!ring.push(record.data(), record.size()));
+    REQUIRE(ring.dropped() == 1);
+    std::string big(100, 'x');
+    REQUIRE(!ring.push(big.data(), big.size()));
+    REQUIRE(ring.dropped() == 2);
+
+    std::string out;
+    REQUIRE(ring.pop(&out));
+    REQUIRE(ring.push(record.data(), record.size()));
+    REQUIRE(ring.pop(&out));
+    REQUIRE(ring.pop(&out));
+    REQUIRE(!ring.pop(&out));
+
+    ring.close();
+    SharedRing::unlink(RING_NAME);
+}
+
+TEST_CASE("shared ring takes records from many processes", "[shmring]") {
+    SharedRing::unlink(RING_NAME);
+    SharedRing ring;
+    REQUIRE(ring.open(RING_NAME, 1024 * 1024));
+
+    const int producers = 4;
+    const int per_producer = 500;
+    std::vector<pid_t> children;
+    for (int p = 0; p < producers; p++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            SharedRing child;
+            if (!child.open(RING_NAME)) {
+                _exit(1);
+            }
+            for (int i = 0; i < per_producer; i++) {
+                std::string record =
+                    std::to_string(p) + ":" + std::to_string(i);
+                child.push(record.data(), record.size());
+            }
+            _exit(0);
+        }
+        REQUIRE(pid > 0);
+        children.push_back(pid);
+    }
+
+    std::set<std::string> seen;
+    std::vector<int> last(producers, -1);
+    std::string out;
+    size_t done = 0;
+    for (;;) {
+        if (ring.pop(&out)) {
+            int p = std::stoi(out.substr(0, out.find(':')));
+            int i = std::stoi(out.substr(out.find(':') + 1));
+            // records of one producer stay in order
+            REQUIRE(i > last[p]);
+            last[p] = i;
+            seen.insert(out);
+            continue;
+        }
+        if (done == children.size()) {
+            break;
+        }
+        int status;
+        if (waitpid(-1, &status, WNOHANG) > 0) {
+            REQUIRE(WEXITSTATUS(status) == 0);
+            done++;
+        }
+    }
+
+    REQUIRE(seen.size() == producers * per_producer);
+    REQUIRE(ring.dropped() == 0);
+    ring.close();
+    SharedRing::unlink(RING_NAME);
+}
+
+TEST_CASE("draining a shared ring needs a name", "[shmring]") {
+    sentry_init(sentry_options_new());
+    REQUIRE(sentry_drain_shared_ring(nullptr) == 0);
+    sentry_shutdown();
+}
+#endif
@@ -0,0 +1,45 @@
+#include <stats.hpp>
+#include <thread>
+#include <vector>
+#include <vendor/catch.hpp>
+
+using namespace sentry;
+
+TEST_CASE("stats are aggregated across threads", "[stats]") {
+    uint64_t before = stat_total(STAT_HTTP_3XX);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.push_back(std::thread([]() {
+            for (int j = 0; j < 1000; j++) {
+                stat_record_http_status(302);
+            }
+        }));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // the numbers of exited threads are kept
+    REQUIRE(stat_total(STAT_HTTP_3XX) == before + 4000);
+}
+
+TEST_CASE("stat timers use power of two buckets", "[stats]") {
+    Value before = collect_stats().navigate("timers.request");
+    stat_record(STAT_TIMER_REQUEST, 0);
+    stat_record(STAT_TIMER_REQUEST, 3);
+    stat_record(STAT_TIMER_REQUEST, 1000);
+    stat_record(STAT_TIMER_REQUEST, (uint64_t)1 << 40);
+    Value after = collect_stats().navigate("timers.request");
+
+    REQUIRE(after.get_by_key("count").as_double() ==
+            before.get_by_key("count").as_double() + 4);
+    REQUIRE(after.get_by_key("buckets").length() == SENTRY_STATS_BUCKETS);
+
+    size_t expected[] = {0, 2, 10, SENTRY_STATS_BUCKETS - 1};
+    for (size_t bucket : expected) {
+        std::string path = "buckets." + std::to_string(bucket);
+        REQUIRE(after.navigate(path.c_str()).as_double() >=
+                before.navigate(path.c_str()).as_double() + 1);
+    }
+}
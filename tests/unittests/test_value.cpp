@@ -1,3 +1,4 @@
+#include <cstring>
 #include <string>
 #include <value.hpp>
 #include <vendor/catch.hpp>
@@ -129,3 +130,111 @@ TEST_CASE("value freezing", "[value]") {
     sentry::Value string_val = sentry::Value::new_string("hello");
     REQUIRE(string_val.is_frozen() == true);
 }
+
+TEST_CASE("value json caching", "[value]") {
+    sentry::Value sdk = sentry::Value::new_object();
+    sentry::Value packages = sentry::Value::new_list();
+    packages.append(sentry::Value::new_string("a\"b"));
+    sdk.set_by_key("packages", packages);
+    sdk.set_by_key("name", sentry::Value::new_string("sdk"));
+    std::string expected = sdk.to_json();
+    sdk.freeze_json();
+    REQUIRE(sdk.is_frozen());
+    REQUIRE(sdk.to_json() == expected);
+
+    sentry::Value event = sentry::Value::new_object();
+    event.set_by_key("sdk", sdk);
+    event.set_by_key("level", sentry::Value::new_string("info"));
+    REQUIRE(event.to_json() ==
+            "{\"level\":\"info\",\"sdk\":" + expected + "}");
+
+    // items beyond the depth limit are left out just like without the cache
+    sentry::Value deep = sdk;
+    sentry::Value uncached = sdk.clone();
+    for (int i = 0; i < 62; i++) {
+        sentry::Value outer = sentry::Value::new_list();
+        outer.append(deep);
+        deep = outer;
+        outer = sentry::Value::new_list();
+        outer.append(uncached);
+        uncached = outer;
+    }
+    std::string deep_json = deep.to_json();
+    REQUIRE(deep_json == uncached.to_json());
+    REQUIRE(deep_json.find("sdk") != std::string::npos);
+    REQUIRE(deep_json.find("a\\\"b") == std::string::npos);
+}
+
+TEST_CASE("value object cloning", "[value]") {
+    sentry::Value obj = sentry::Value::new_object();
+    obj.set_by_key("key1", sentry::Value::new_string("value1"));
+    obj.set_by_key("key2", sentry::Value::new_int32(42));
+
+    sentry::Value obj_clone = obj.clone();
+    REQUIRE(obj_clone.type() == SENTRY_VALUE_TYPE_OBJECT);
+    REQUIRE(obj_clone == obj);
+
+    obj_clone.set_by_key("key3", sentry::Value::new_bool(true));
+    REQUIRE(obj_clone.length() == 3);
+    REQUIRE(obj.length() == 2);
+}
+
+TEST_CASE("value json parsing", "[value]") {
+    const char *json =
+        " {\"a\": [1, -2, 3.5, 2.5e-1, 1e10], \"b\": {\"c\": null},"
+        " \"d\": true, \"e\": false, \"f\": \"x\\\"\\n\\u00e4\\ud83d\\ude00\"} ";
+    sentry::Value value;
+    REQUIRE(sentry::Value::from_json(json, strlen(json), &value));
+    REQUIRE(value.navigate("a.0").type() == SENTRY_VALUE_TYPE_INT32);
+    REQUIRE(value.navigate("a.1").as_int32() == -2);
+    REQUIRE(value.navigate("a.2").as_double() == 3.5);
+    REQUIRE(value.navigate("a.3").type() == SENTRY_VALUE_TYPE_DOUBLE);
+    REQUIRE(value.navigate("a.3").as_double() == 0.25);
+    REQUIRE(value.navigate("a.4").as_double() == 1e10);
+    REQUIRE(value.navigate("b").type() == SENTRY_VALUE_TYPE_OBJECT);
+    REQUIRE(value.navigate("b.c").is_null());
+    REQUIRE(value.get_by_key("d").as_bool());
+    REQUIRE(!value.get_by_key("e").as_bool());
+    REQUIRE(value.get_by_key("f").as_cstr() ==
+            std::string("x\"\n\xc3\xa4\xf0\x9f\x98\x80"));
+
+    // round trips through the writer
+    char *serialized = value.to_json();
+    sentry::Value reparsed;
+    REQUIRE(sentry::Value::from_json(serialized, strlen(serialized),
+                                     &reparsed));
+    REQUIRE(reparsed == value);
+    free(serialized);
+
+    const char *invalid[] = {"", "{", "[1,]", "{\"a\" 1}", "\"abc", "nul",
+                             "1 2", "{\"a\":1}}", "[\"\\x\"]"};
+    for (const char *s : invalid) {
+        REQUIRE(!sentry::Value::from_json(s, strlen(s), &value));
+    }
+
+    // documents do not need to be null terminated
+    REQUIRE(sentry::Value::from_json("[42]xyz", 4, &value));
+    REQUIRE(value.navigate("0").as_int32() == 42);
+}
+
+TEST_CASE("value msgpack parsing", "[value]") {
+    const char *json =
+        "{\"a\": [1, -2, 3.5, 3000000000], \"b\": {\"c\": null}, \"d\": true,"
+        " \"e\": \"text\", \"f\": []}";
+    sentry::Value value;
+    REQUIRE(sentry::Value::from_json(json, strlen(json), &value));
+
+    size_t size;
+    char *buf = value.to_msgpack_string(&size);
+    sentry::Value decoded;
+    REQUIRE(sentry::Value::from_msgpack(buf, size, &decoded));
+    REQUIRE(decoded == value);
+
+    // truncated documents and trailing bytes are rejected
+    REQUIRE(!sentry::Value::from_msgpack(buf, size - 1, &decoded));
+    std::string trailing(buf, size);
+    trailing.push_back('\xc0');
+    REQUIRE(!sentry::Value::from_msgpack(trailing.data(), trailing.size(),
+                                         &decoded));
+    free(buf);
+}
@@ -0,0 +1,62 @@
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vendor/catch.hpp>
+#include <worker.hpp>
+
+using namespace sentry;
+
+TEST_CASE("worker runs tasks by priority", "[worker]") {
+    BackgroundWorker worker;
+    worker.start();
+
+    std::atomic<bool> started(false);
+    std::atomic<bool> blocked(true);
+    worker.submit_task([&started, &blocked]() {
+        started = true;
+        while (blocked) {
+            std::this_thread::yield();
+        }
+    });
+    while (!started) {
+        std::this_thread::yield();
+    }
+
+    std::mutex lock;
+    std::string order;
+    auto append = [&lock, &order](char c) {
+        return [&lock, &order, c]() {
+            std::lock_guard<std::mutex> _lock(lock);
+            order.push_back(c);
+        };
+    };
+    worker.submit_task(append('d'));
+    worker.submit_task(append('e'), false, TASK_PRIORITY_ERROR);
+    worker.submit_task(append('D'));
+    worker.submit_task(append('f'), false, TASK_PRIORITY_FATAL);
+    REQUIRE(worker.queue_depth() == 4);
+
+    blocked = false;
+    worker.shutdown();
+    REQUIRE(order == "fedD");
+}
+
+TEST_CASE("worker always accepts fatal tasks", "[worker]") {
+    BackgroundWorker worker(1);
+    REQUIRE(worker.submit_task([]() {}));
+    REQUIRE(!worker.submit_task([]() {}));
+    REQUIRE(!worker.submit_task([]() {}, false, TASK_PRIORITY_ERROR));
+    REQUIRE(worker.submit_task([]() {}, false, TASK_PRIORITY_FATAL));
+    REQUIRE(worker.queue_depth() == 2);
+    worker.start();
+    worker.shutdown();
+}
+
+TEST_CASE("task priority follows the event level", "[worker]") {
+    Value event = Value::new_event();
+    REQUIRE(task_priority_for_event(event) == TASK_PRIORITY_DEFAULT);
+    event.set_by_key("level", Value::new_level(SENTRY_LEVEL_ERROR));
+    REQUIRE(task_priority_for_event(event) == TASK_PRIORITY_ERROR);
+    event.set_by_key("level", Value::new_level(SENTRY_LEVEL_FATAL));
+    REQUIRE(task_priority_for_event(event) == TASK_PRIORITY_FATAL);
+}